@@ -0,0 +1,2519 @@
+/*
+** EasyIOT - (Host) HTTP Load Generator
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+
+/*
+** Runs IOTHTTP on the loopback interface, over the socket shim, and drives
+** it from a number of client threads, each with one request in flight.  The
+** routes stand in for those of a device: a page, a form post, a multipart
+** upload, a UPnP device schema, the REST api dumping forty properties, an
+** hour of a property's history, a file served whole or in part and a large
+** settings form decoded as it streams in.
+** Requests per second, latency percentiles and the peak heap the server
+** used are reported at the end.
+**
+**   pio run -e host && .pio/build/host/program [options]
+**
+**   -c clients     concurrent clients (4)
+**   -n requests    requests in all (20000)
+**   -d seconds     run for a time instead of a count
+**   -j dumps       time the api's JSON writer alone, against String building
+**   -k 0|1         keep connections alive (1)
+**   -l lookups     time path lookups through the registry, against a walk
+**   -m weights     of page, form, upload, schema, api, history, file, range and settings requests (4,2,1,1,0,0,0,0,0)
+**   -p port        loopback port (8180)
+**   -q parses      time the request parser alone, against the String parsing it replaced
+**   -r rate,burst  per address request limit, off unless given
+**   -s slow        more clients, each sending half its request and the rest a little later
+**   -t             run the server in its own task rather than a loop
+**   -u kilobytes   time uploads of a file part this size, against the byte loop they replaced
+**   -v level       server log level (1)
+**   -w messages    time property writes over WebSockets, round trip each
+**   -x             check what each route answers, rather than time them
+**
+** The host-single build serves one connection at a time and holds up to
+** sixteen waiting, as the listen backlog did before the server had slots.
+** Running both with eight clients and a slow one or two shows what a slow
+** browser costs the others.  Connections past the host build's slots and
+** its waiting list are refused, and counted as such.
+**
+**   .pio/build/host/program -c 8 -s 2 && .pio/build/host-single/program -c 8 -s 2
+*/
+#include "IOTHttp.h"
+#include "IOTRegistry.h"
+#include <libb64/cencode.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <malloc.h>
+#include <unistd.h>
+#include <poll.h>
+#include <utime.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define LOAD_BUFLEN 16384 // largest response read, the schema and page fit easily
+#define LOAD_UPLOAD 4096  // bytes in the uploaded file part
+#define LOAD_SLOW_PAUSE 20 // ms a slow client waits between the halves of its request
+
+enum LoadKind
+{
+    LOAD_PAGE,
+    LOAD_FORM,
+    LOAD_UPLOAD_FILE,
+    LOAD_SCHEMA,
+    LOAD_API,
+    LOAD_HISTORY,
+    LOAD_FILE,
+    LOAD_RANGE,
+    LOAD_SETTINGS,
+    LOAD_KINDS
+};
+
+static const char *_kindNames[LOAD_KINDS] = {"page", "form", "upload", "schema", "api", "history", "file", "range", "settings"};
+
+/*
+** Heap Tracking
+**
+** Only what the server allocates counts, the client threads opt out so
+** their sample buffers are not mistaken for the server's use.
+*/
+static std::atomic<long> _heapUsed(0);
+static std::atomic<long> _heapPeak(0);
+static std::atomic<unsigned long> _heapAllocs(0);
+static thread_local bool _heapIgnore = false;
+
+// The replacements pair malloc with free, which GCC takes for a mismatch
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size ? size : 1);
+
+    if (!p)
+        throw std::bad_alloc();
+
+    if (!_heapIgnore)
+    {
+        long used = _heapUsed += malloc_usable_size(p);
+        long peak = _heapPeak;
+
+        while (used > peak && !_heapPeak.compare_exchange_weak(peak, used))
+            ;
+        _heapAllocs++;
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (!p)
+        return;
+    if (!_heapIgnore)
+        _heapUsed -= malloc_usable_size(p);
+    free(p);
+}
+
+void operator delete(void *p, size_t size) noexcept
+{
+    (void)size;
+    operator delete(p);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t size) noexcept { (void)size, operator delete(p); }
+
+/*
+** Device Routes
+*/
+static const char _schemaTemplate[] =
+    "<?xml version=\"1.0\"?>"
+    "<root xmlns=\"urn:schemas-upnp-org:device-1-0\">"
+    "<URLBase>http://%s:%u/</URLBase>"
+    "<device>"
+    "<friendlyName>%s</friendlyName>"
+    "<deviceType>urn:Belkin:device:controllee:1</deviceType>"
+    "<manufacturer>EasyIOT</manufacturer>"
+    "<manufacturerURL>https://github.com/monty68/EasyIOT</manufacturerURL>"
+    "<modelName>EasyIOT:host</modelName>"
+    "<modelNumber>0.0.0.1:host</modelNumber>"
+    "<modelURL>https://github.com/monty68/EasyIOT</modelURL>"
+    "<serialNumber>%lu</serialNumber>"
+    "<UDN>uuid:47843fea-e025-40bd-a38c-%012lx</UDN>"
+    "<serviceList><service>"
+    "<serviceType>urn:Belkin:service:basicevent:1</serviceType>"
+    "<serviceId>urn:Belkin:serviceId:basicevent1</serviceId>"
+    "<controlURL>/upnp/control/basicevent1</controlURL>"
+    "<eventSubURL>/upnp/event/basicevent1</eventSubURL>"
+    "<SCPDURL>/eventservice.xml</SCPDURL>"
+    "</service></serviceList>"
+    "<deviceList></deviceList>"
+    "<presentationURL>http://%s:%u/index.html</presentationURL>"
+    "</device>"
+    "<specVersion><major>1</major><minor>0</minor></specVersion>"
+    "</root>\r\n"
+    "\r\n";
+
+static size_t _uploaded;
+static uint32_t _uploadCheck;
+
+static void _uploadSum(uint32_t &check, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+        check = check * 31 + data[i];
+}
+
+/*
+** Settings Form, a page of settings posted urlencoded and too large to
+** hold, decoded through onBody() as the blocks arrive.  Each field is
+** summed as key=value, the value put back together from its pieces.
+*/
+#define LOAD_SETTINGS_FIELDS 128
+#define LOAD_SETTINGS_VALUE 240
+
+static int _settingsFields;
+static uint32_t _settingsCheck;
+static bool _settingsPiece; // the last value handed on was not the whole
+
+static void _settingsField(const char *key, const char *value, size_t len, bool final)
+{
+    if (!_settingsPiece)
+    {
+        _uploadSum(_settingsCheck, (const uint8_t *)key, strlen(key));
+        _uploadSum(_settingsCheck, (const uint8_t *)"=", 1);
+    }
+    _uploadSum(_settingsCheck, (const uint8_t *)value, len);
+    _settingsPiece = !final;
+    if (final)
+        _settingsFields++;
+}
+
+static HTTPFormDecoder _settingsDecoder(_settingsField);
+
+// The encoded form and the sum the route should arrive at
+static std::string _settingsForm(uint32_t &check)
+{
+    static const char text[] = "abcdefghijklmnopqrstuvwxyz0123456789 &=+%\xc2\xb0";
+    unsigned int seed = 65521;
+    std::string form;
+    char hex[4];
+
+    check = 0;
+    for (int f = 0; f < LOAD_SETTINGS_FIELDS; f++)
+    {
+        std::string key = "setting" + std::to_string(f);
+        std::string value;
+
+        for (int v = 0; v < LOAD_SETTINGS_VALUE; v++)
+            value += text[rand_r(&seed) % (sizeof(text) - 1)];
+
+        form += (f) ? "&" : "";
+        form += key + "=";
+        for (char c : value)
+        {
+            if (isalnum((uint8_t)c))
+                form += c;
+            else if (c == ' ')
+                form += '+';
+            else
+            {
+                snprintf(hex, sizeof(hex), "%%%02X", (uint8_t)c);
+                form += hex;
+            }
+        }
+
+        key += "=";
+        _uploadSum(check, (const uint8_t *)key.data(), key.size());
+        _uploadSum(check, (const uint8_t *)value.data(), value.size());
+    }
+    return form;
+}
+
+/*
+** Api Tree, four functions of ten properties, written as IOTMaster writes
+** its own
+*/
+#define LOAD_FUNCTIONS 4
+#define LOAD_PROPERTIES 10
+
+static const char *_functionTags[LOAD_FUNCTIONS] = {"iot", "light", "sensor", "relay"};
+static float _readings[LOAD_FUNCTIONS][LOAD_PROPERTIES];
+
+static const char *_apiFunction(uint8_t function, uint8_t &properties, const char *&label)
+{
+    if (function >= LOAD_FUNCTIONS)
+        return nullptr;
+
+    properties = LOAD_PROPERTIES;
+    label = "Host \"Function\"";
+    return _functionTags[function];
+}
+
+static int _apiProperty(uint8_t function, uint8_t index, const char *value, HTTPJson *json)
+{
+    if (function >= LOAD_FUNCTIONS || index >= LOAD_PROPERTIES)
+        return 404;
+
+    float &reading = _readings[function][index];
+
+    if (value)
+        reading = atof(value);
+    if (!json)
+        return 200;
+
+    json->object()
+        .number("index", index)
+        .string("label", "Ambient Temperature")
+        .string("type", "number")
+        .number("class", 8)
+        .boolean("readonly", false)
+        .string("prefix", "Temperature")
+        .string("suffix", "\xc2\xb0" "C")
+        .number("time", (long)1700000000 + index);
+    json->quote("value");
+    json->printf("%.2f", reading + function * 10 + index / 10.0f);
+    json->unquote();
+    json->end();
+    return 200;
+}
+
+// The same property built as a String, as a handler would without the writer
+static void _apiString(String &text, uint8_t function, uint8_t index)
+{
+    char value[24];
+
+    snprintf(value, sizeof(value), "%.2f", _readings[function][index] + function * 10 + index / 10.0f);
+    text += "{\"index\":";
+    text += (int)index;
+    text += ",\"label\":\"Ambient Temperature\",\"type\":\"number\",\"class\":8,\"readonly\":false,"
+            "\"prefix\":\"Temperature\",\"suffix\":\"\xc2\xb0" "C\",\"time\":";
+    text += (long)1700000000 + index;
+    text += ",\"value\":\"";
+    text += value;
+    text += "\"}";
+}
+
+// As IOTMaster answers a socket, publishing each write as a change
+static IOTHTTP *_server;
+static char _authPassword[16] = "secret";
+
+static bool _socketProperty(const char *tag, uint8_t index, const char *value, String &result)
+{
+    char text[24];
+
+    for (uint8_t function = 0; function < LOAD_FUNCTIONS; function++)
+    {
+        if (strcmp(tag, _functionTags[function]) != 0 || index >= LOAD_PROPERTIES)
+            continue;
+
+        float &reading = _readings[function][index];
+
+        if (value)
+            reading = atof(value);
+        snprintf(text, sizeof(text), "%.2f", reading);
+        result = text;
+        if (value)
+            _server->webEvent(tag, index, text, time(nullptr));
+        return true;
+    }
+    return false;
+}
+
+/*
+** History, six hours of a reading every half a minute, of which the raw
+** ring keeps the last few and the buckets the rest
+*/
+#define LOAD_HISTORY_START 1700000000UL
+#define LOAD_HISTORY_STEP 30
+#define LOAD_HISTORY_SAMPLES 720
+
+static IOTHistory *_history;
+
+static IOTHistory *_historyLookup(const char *path)
+{
+    return (strcmp(path, "sensor/0") == 0) ? _history : nullptr;
+}
+
+static void _historyFill(void)
+{
+    _history = new IOTHistory(2);
+    for (uint32_t n = 0; n < LOAD_HISTORY_SAMPLES; n++)
+        _history->add(LOAD_HISTORY_START + n * LOAD_HISTORY_STEP, 20.0 + (n % 40) / 4.0);
+}
+
+/*
+** Files, random bytes written to a directory of their own before the
+** handler indexes it, and removed at exit
+*/
+#define LOAD_FILE_BYTES 100000
+
+static char _fileRoot[] = "/tmp/loadgen-XXXXXX";
+static std::string _fileData;
+
+static void _fileClean(void)
+{
+    std::string path = std::string(_fileRoot) + "/blob.bin";
+
+    unlink(path.c_str());
+    rmdir(_fileRoot);
+}
+
+static FS *_fileFill(void)
+{
+    unsigned int seed = 8191;
+    std::string path;
+    FILE *f;
+
+    if (!mkdtemp(_fileRoot))
+        return nullptr;
+    atexit(_fileClean);
+
+    _fileData.resize(LOAD_FILE_BYTES);
+    for (char &c : _fileData)
+        c = (char)rand_r(&seed);
+
+    path = std::string(_fileRoot) + "/blob.bin";
+    if (!(f = fopen(path.c_str(), "wb")))
+        return nullptr;
+    fwrite(_fileData.data(), 1, _fileData.size(), f);
+    fclose(f);
+    return new FS(_fileRoot);
+}
+
+static void _addRoutes(IOTHTTP &server)
+{
+    server.on("/page", HTTP_GET, [](IOTHTTP &s) {
+        String page("<!DOCTYPE html><html><head><title>EasyIOT</title></head><body><h1>Hello ");
+
+        page += s.arg("name");
+        page += "</h1><table>";
+        for (int row = 0; row < 16; row++)
+        {
+            page += "<tr><td>Property ";
+            page += row;
+            page += "</td><td>";
+            page += (long)millis();
+            page += "</td></tr>";
+        }
+        page += "</table></body></html>";
+        s.send(200, MIME_TYPE_HTML, page);
+    });
+
+    server.on("/form", HTTP_POST, [](IOTHTTP &s) {
+        char reply[64];
+
+        snprintf(reply, sizeof(reply), "%d fields, value %s", s.args(), s.arg("value").c_str());
+        s.send(200, MIME_TYPE_TEXT, reply);
+    });
+
+    server.on(
+        "/upload", HTTP_POST,
+        [](IOTHTTP &s) {
+            char reply[32];
+
+            snprintf(reply, sizeof(reply), "%u bytes", (unsigned)_uploaded);
+            s.send(200, MIME_TYPE_TEXT, reply);
+        },
+        [](IOTHTTP &s) {
+            HTTPUpload &upload = s.upload();
+
+            if (upload.status == UPLOAD_FILE_START)
+                _uploaded = 0, _uploadCheck = 0;
+            else if (upload.status == UPLOAD_FILE_WRITE)
+            {
+                _uploaded += upload.currentSize;
+                _uploadSum(_uploadCheck, upload.buf, upload.currentSize);
+            }
+        });
+
+    server.onBody(
+        "/settings", HTTP_POST,
+        [](IOTHTTP &s) {
+            char reply[48];
+
+            snprintf(reply, sizeof(reply), "%d fields, check %08x", _settingsFields, (unsigned)_settingsCheck);
+            s.send(200, MIME_TYPE_TEXT, reply);
+        },
+        [](IOTHTTP &s) {
+            HTTPUpload &upload = s.upload();
+
+            if (upload.status == UPLOAD_FILE_START)
+            {
+                _settingsDecoder.reset();
+                _settingsFields = 0;
+                _settingsCheck = 0;
+                _settingsPiece = false;
+            }
+            else if (upload.status == UPLOAD_FILE_WRITE)
+                _settingsDecoder.feed(upload.buf, upload.currentSize);
+            else if (upload.status == UPLOAD_FILE_END)
+                _settingsDecoder.end();
+        });
+
+    server.on("/private", HTTP_GET, [](IOTHTTP &s) {
+        if (!s.webCredentials("admin", _authPassword))
+            return s.webAuthenticate();
+        s.send(200, MIME_TYPE_TEXT, "private");
+    });
+
+    // Built the same way UPNPDevice sends its description
+    server.on("/schema.xml", HTTP_GET, [](IOTHTTP &s) {
+        char buffer[1460];
+
+        snprintf(buffer, sizeof(buffer), _schemaTemplate, "127.0.0.1", s.webPort(), "Host Switch",
+                 123456789UL, 0x123456789abcUL, "127.0.0.1", s.webPort());
+        s.send(200, MIME_TYPE_XML, buffer);
+    });
+
+    server.onApi("/api", _apiFunction, _apiProperty);
+    server.onEvents("/events");
+    server.onSocket("/ws", _socketProperty);
+    server.onHistory("/history", _historyLookup);
+    _historyFill();
+
+    FS *fs = _fileFill();
+
+    if (fs)
+        server.onFile("/files", *fs, "/", "max-age=60");
+    _server = &server;
+}
+
+/*
+** Client Requests
+*/
+static std::string _requests[LOAD_KINDS];
+
+static void _buildRequests(bool keepAlive)
+{
+    const char *connection = (keepAlive) ? "keep-alive" : "close";
+    std::string form("name=bench&value=42&text=hello+world&flag=on");
+    std::string part(LOAD_UPLOAD, 'x');
+    std::string body;
+    char head[256];
+
+    snprintf(head, sizeof(head), "GET /page?name=bench HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n", connection);
+    _requests[LOAD_PAGE] = head;
+
+    snprintf(head, sizeof(head),
+             "POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %u\r\n\r\n",
+             connection, (unsigned)form.size());
+    _requests[LOAD_FORM] = head + form;
+
+    body = "--LoadBoundary\r\n"
+           "Content-Disposition: form-data; name=\"file\"; filename=\"load.bin\"\r\n"
+           "Content-Type: application/octet-stream\r\n\r\n" +
+           part + "\r\n--LoadBoundary--\r\n";
+    snprintf(head, sizeof(head),
+             "POST /upload HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n"
+             "Content-Type: multipart/form-data; boundary=LoadBoundary\r\nContent-Length: %u\r\n\r\n",
+             connection, (unsigned)body.size());
+    _requests[LOAD_UPLOAD_FILE] = head + body;
+
+    snprintf(head, sizeof(head), "GET /schema.xml HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n", connection);
+    _requests[LOAD_SCHEMA] = head;
+
+    snprintf(head, sizeof(head), "GET /api HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n", connection);
+    _requests[LOAD_API] = head;
+
+    snprintf(head, sizeof(head), "GET /history/sensor/0?res=1m HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n", connection);
+    _requests[LOAD_HISTORY] = head;
+
+    snprintf(head, sizeof(head), "GET /files/blob.bin HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n\r\n", connection);
+    _requests[LOAD_FILE] = head;
+
+    snprintf(head, sizeof(head), "GET /files/blob.bin HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\nRange: bytes=40000-\r\n\r\n", connection);
+    _requests[LOAD_RANGE] = head;
+
+    uint32_t check;
+
+    body = _settingsForm(check);
+    snprintf(head, sizeof(head),
+             "POST /settings HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: %s\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %u\r\n\r\n",
+             connection, (unsigned)body.size());
+    _requests[LOAD_SETTINGS] = head + body;
+}
+
+static int _connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    int on = 1;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return fd;
+}
+
+static bool _sendAll(int fd, const std::string &request)
+{
+    size_t sent = 0;
+
+    while (sent < request.size())
+    {
+        ssize_t len = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+
+        if (len <= 0)
+            return false;
+        sent += len;
+    }
+    return true;
+}
+
+// Move what is unread to the front and read more behind it
+static bool _fill(int fd, char *buf, size_t &pos, size_t &len)
+{
+    memmove(buf, buf + pos, len - pos);
+    len -= pos;
+    pos = 0;
+
+    if (len == LOAD_BUFLEN - 1)
+        return false;
+
+    ssize_t got = recv(fd, buf + len, LOAD_BUFLEN - 1 - len, 0);
+
+    if (got <= 0)
+        return false;
+    len += got;
+    return true;
+}
+
+/*
+** Read one response, returning its status or zero if the connection failed.
+** The body is framed by Content-Length or chunks, or runs to the close.
+*/
+static int _readResponse(int fd, char *buf, bool &closed)
+{
+    size_t len = 0, head = 0;
+
+    closed = false;
+    while (!head)
+    {
+        ssize_t got = recv(fd, buf + len, LOAD_BUFLEN - 1 - len, 0);
+
+        if (got <= 0)
+            return 0;
+        len += got;
+        buf[len] = '\0';
+
+        char *end = strstr(buf, "\r\n\r\n");
+
+        if (end)
+            head = end + 4 - buf;
+        else if (len == LOAD_BUFLEN - 1)
+            return 0;
+    }
+
+    // Look at the headers alone while the body is cut off
+    char saved = buf[head];
+    buf[head] = '\0';
+
+    int code = atoi(buf + 9);
+    char *field = strcasestr(buf, "\r\nContent-Length:");
+    size_t want = (field) ? strtoul(field + 17, nullptr, 10) : (size_t)-1;
+    bool chunked = strcasestr(buf, "\r\nTransfer-Encoding: chunked") != nullptr;
+
+    closed = strcasestr(buf, "\r\nConnection: close") != nullptr;
+    buf[head] = saved;
+
+    size_t body = len - head;
+
+    if (field || !chunked)
+    {
+        if (!field)
+            closed = true;
+
+        while (body < want)
+        {
+            ssize_t got = recv(fd, buf, LOAD_BUFLEN, 0);
+
+            if (got <= 0)
+                return (want == (size_t)-1) ? code : 0;
+            body += got;
+        }
+        return code;
+    }
+
+    // Chunks are no larger than the server's response buffer, so each fits
+    size_t pos = head;
+
+    for (;;)
+    {
+        char *crlf;
+
+        while (!(crlf = (char *)memmem(buf + pos, len - pos, "\r\n", 2)))
+        {
+            if (!_fill(fd, buf, pos, len))
+                return 0;
+        }
+
+        size_t size = strtoul(buf + pos, nullptr, 16);
+        size_t skip = (crlf + 2 - (buf + pos)) + size + 2;
+
+        while (len - pos < skip)
+        {
+            if (!_fill(fd, buf, pos, len))
+                return 0;
+        }
+
+        pos += skip;
+        if (!size)
+            return code;
+    }
+}
+
+/*
+** Load Run
+*/
+struct LoadOptions
+{
+    int clients = 4;
+    long requests = 20000;
+    double seconds = 0;
+    bool keepAlive = true;
+    int weights[LOAD_KINDS] = {4, 2, 1, 1, 0, 0, 0, 0, 0};
+    uint16_t port = 8180;
+    int rate = 0;
+    int burst = HTTP_RATE_BURST;
+    bool tasked = false;
+    long dumps = 0;
+    long lookups = 0;
+    long messages = 0;
+    long parses = 0;
+    long upload = 0;
+    int slow = 0;
+    bool check = false;
+};
+
+struct LoadResult
+{
+    std::vector<uint32_t> latency; // microseconds
+    unsigned long count[LOAD_KINDS] = {0};
+    unsigned long errors = 0;
+    unsigned long connects = 0;
+    unsigned long refused = 0;
+};
+
+static std::atomic<long> _issued(0);
+static std::atomic<bool> _stop(false);
+static std::atomic<bool> _served(false); // the loop outlives the clients, whose last requests need answers
+
+static void _client(const LoadOptions &options, int id, LoadResult &result)
+{
+    _heapIgnore = true;
+
+    char *buf = new char[LOAD_BUFLEN];
+    unsigned int seed = 7919 * (id + 1);
+    int total = 0;
+    int fd = -1;
+
+    result.latency.reserve((options.requests > 0 && !options.seconds) ? options.requests / options.clients + 1 : 1 << 20);
+
+    for (int k = 0; k < LOAD_KINDS; k++)
+        total += options.weights[k];
+
+    while (!_stop)
+    {
+        if (!options.seconds && _issued++ >= options.requests)
+            break;
+
+        int pick = rand_r(&seed) % total;
+        int kind = 0;
+
+        while (pick >= options.weights[kind])
+            pick -= options.weights[kind++];
+
+        if (fd < 0)
+        {
+            if ((fd = _connect(options.port)) < 0)
+            {
+                result.errors++;
+                usleep(1000);
+                continue;
+            }
+            result.connects++;
+        }
+
+        unsigned long start = micros();
+        bool closed = false;
+        int code = (_sendAll(fd, _requests[kind])) ? _readResponse(fd, buf, closed) : 0;
+
+        result.latency.push_back(micros() - start);
+        result.count[kind]++;
+
+        if (code == 429 || code == 503)
+            result.refused++;
+        else if (code < 200 || code > 299)
+            result.errors++;
+
+        if (!code || closed || !options.keepAlive)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0)
+        close(fd);
+    delete[] buf;
+}
+
+// Until the others are done, as a browser on a poor link sends a request
+static void _slowClient(const LoadOptions &options, LoadResult &result)
+{
+    std::string &request = _requests[LOAD_PAGE];
+    size_t half = request.size() / 2;
+    char *buf = new char[LOAD_BUFLEN];
+
+    _heapIgnore = true;
+    while (!_stop)
+    {
+        int fd = _connect(options.port);
+        unsigned long start = micros();
+        bool closed;
+        int code = 0;
+
+        if (fd >= 0 && _sendAll(fd, request.substr(0, half)))
+        {
+            usleep(LOAD_SLOW_PAUSE * 1000);
+            if (_sendAll(fd, request.substr(half)))
+                code = _readResponse(fd, buf, closed);
+        }
+        if (fd >= 0)
+            close(fd);
+
+        result.latency.push_back(micros() - start);
+        if (code < 200 || code > 299)
+            result.errors++;
+    }
+    delete[] buf;
+}
+
+static bool _parseOptions(int argc, char **argv, LoadOptions &options)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:n:d:j:k:l:m:p:q:r:s:tu:v:w:x")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            options.clients = std::max(1, atoi(optarg));
+            break;
+        case 'n':
+            options.requests = atol(optarg);
+            break;
+        case 'd':
+            options.seconds = atof(optarg);
+            break;
+        case 'j':
+            options.dumps = atol(optarg);
+            break;
+        case 'k':
+            options.keepAlive = atoi(optarg) != 0;
+            break;
+        case 'l':
+            options.lookups = atol(optarg);
+            break;
+        case 'm':
+        {
+            char *at = optarg;
+            int k = 0;
+
+            // The first four are needed, those after keep their defaults
+            while (k < LOAD_KINDS && *at)
+            {
+                options.weights[k++] = strtol(at, &at, 10);
+                if (*at == ',')
+                    at++;
+                else if (*at)
+                    return false;
+            }
+            if (k < 4)
+                return false;
+            break;
+        }
+        case 'p':
+            options.port = atoi(optarg);
+            break;
+        case 'q':
+            options.parses = atol(optarg);
+            break;
+        case 'r':
+            if (sscanf(optarg, "%d,%d", &options.rate, &options.burst) < 1)
+                return false;
+            break;
+        case 's':
+            options.slow = std::max(0, atoi(optarg));
+            break;
+        case 't':
+            options.tasked = true;
+            break;
+        case 'u':
+            options.upload = atol(optarg);
+            break;
+        case 'v':
+            host_log_level = (esp_log_level_t)atoi(optarg);
+            break;
+        case 'w':
+            options.messages = atol(optarg);
+            break;
+        case 'x':
+            options.check = true;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    int total = 0;
+
+    for (int k = 0; k < LOAD_KINDS; k++)
+        total += std::max(0, options.weights[k]);
+    return total > 0;
+}
+
+/*
+** Serializer Benchmark
+**
+** Writes the api tree the way HTTPApi walks it into a sink that only
+** counts, then builds the same document as one String, the cost the writer
+** replaces.  The heap column counts allocations made per document.
+*/
+class LoadSink : public Print
+{
+  public:
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        bytes += size;
+        check = check * 31 + buf[size - 1];
+        return size;
+    }
+    using Print::write;
+
+    unsigned long long bytes = 0;
+    uint32_t check = 0;
+};
+
+static void _apiWrite(HTTPJson &json)
+{
+    json.array();
+    for (uint8_t f = 0; f < LOAD_FUNCTIONS; f++)
+    {
+        json.object().string("tag", _functionTags[f]).string("label", "Host \"Function\"").array("properties");
+        for (uint8_t p = 0; p < LOAD_PROPERTIES; p++)
+            _apiProperty(f, p, nullptr, &json);
+        json.end().end();
+    }
+    json.end();
+}
+
+static size_t _apiBuild(void)
+{
+    String text("[");
+
+    for (uint8_t f = 0; f < LOAD_FUNCTIONS; f++)
+    {
+        if (f)
+            text += ',';
+        text += "{\"tag\":\"";
+        text += _functionTags[f];
+        text += "\",\"label\":\"Host \\\"Function\\\"\",\"properties\":[";
+        for (uint8_t p = 0; p < LOAD_PROPERTIES; p++)
+        {
+            if (p)
+                text += ',';
+            _apiString(text, f, p);
+        }
+        text += "]}";
+    }
+    text += "]";
+    return text.length();
+}
+
+static void _benchJson(long dumps)
+{
+    LoadSink sink;
+    size_t built = 0;
+
+    _heapAllocs = 0;
+    unsigned long start = micros();
+
+    for (long d = 0; d < dumps; d++)
+    {
+        HTTPJson json(sink);
+
+        _apiWrite(json);
+    }
+
+    double written = (micros() - start) / 1e6;
+    unsigned long writeAllocs = _heapAllocs;
+
+    _heapAllocs = 0;
+    start = micros();
+    for (long d = 0; d < dumps; d++)
+        built += _apiBuild();
+
+    double building = (micros() - start) / 1e6;
+    unsigned long buildAllocs = _heapAllocs;
+    double size = (double)sink.bytes / dumps;
+
+    printf("document   %.0f bytes, %d functions of %d properties\n", size, LOAD_FUNCTIONS, LOAD_PROPERTIES);
+    printf("writer     %ld in %.2fs, %.0f docs/s, %.1f MB/s, %.1f allocations each\n", dumps, written,
+           dumps / written, sink.bytes / written / 1e6, (double)writeAllocs / dumps);
+    printf("string     %ld in %.2fs, %.0f docs/s, %.1f MB/s, %.1f allocations each%s\n", dumps, building,
+           dumps / building, built / building / 1e6, (double)buildAllocs / dumps,
+           (built == sink.bytes) ? "" : ", length differs");
+}
+
+/*
+** Registry Benchmark
+**
+** Resolves property paths over a tree of stand-in functions, through
+** IOTRegistry::resolve() as IOTFunction::Resolve() does, and by walking
+** the tags and labels in turn as Function() did.  Half the paths name a
+** property by its label and half by its index.
+*/
+#define LOAD_REG_FUNCTIONS 24
+#define LOAD_REG_PROPERTIES 10
+#define LOAD_REG_PATHS 256
+
+typedef struct
+{
+    char tag[16];
+    char labels[LOAD_REG_PROPERTIES][16];
+} LoadFunction;
+
+static LoadFunction _regTree[LOAD_REG_FUNCTIONS];
+
+// The registry holds pointers it never follows, the tree's entries stand in
+static IOTFunction *_regFunction(int f) { return (IOTFunction *)&_regTree[f]; }
+static IOTProperty *_regProperty(int f, int p) { return (IOTProperty *)&_regTree[f].labels[p]; }
+
+static void *_regWalk(const char *path)
+{
+    for (int f = 0; f < LOAD_REG_FUNCTIONS; f++)
+    {
+        size_t len = strlen(_regTree[f].tag);
+
+        if (strncmp(path, _regTree[f].tag, len) != 0 || path[len] != '/')
+            continue;
+
+        for (int p = 0; p < LOAD_REG_PROPERTIES; p++)
+        {
+            if (strcmp(&path[len + 1], _regTree[f].labels[p]) == 0)
+                return _regProperty(f, p);
+        }
+
+        char *end;
+        unsigned long p = strtoul(&path[len + 1], &end, 10);
+
+        if (isdigit((unsigned char)path[len + 1]) && !*end && p < LOAD_REG_PROPERTIES)
+            return _regProperty(f, p);
+    }
+    return nullptr;
+}
+
+// As IOTFunction::Resolve(), the index taken from a stand-in function
+static void *_regResolve(IOTRegistry &registry, const char *path)
+{
+    IOTFunction *func;
+    IOTProperty *prop;
+    uint8_t p;
+
+    if ((prop = registry.resolve(path, func, p)) != nullptr)
+        return prop;
+    if (func == nullptr || p >= LOAD_REG_PROPERTIES)
+        return nullptr;
+    return _regProperty((LoadFunction *)func - _regTree, p);
+}
+
+static void _benchRegistry(long lookups)
+{
+    static const char *names[] = {"Time", "Zone", "Level", "State", "Mode"};
+    static char paths[LOAD_REG_PATHS][40];
+    IOTRegistry registry;
+
+    for (int f = 0; f < LOAD_REG_FUNCTIONS; f++)
+    {
+        if (f < 4)
+            snprintf(_regTree[f].tag, sizeof(_regTree[f].tag), "%s", _functionTags[f]);
+        else
+            snprintf(_regTree[f].tag, sizeof(_regTree[f].tag), "PIN/%d", f);
+        registry.add(_regFunction(f), _regTree[f].tag);
+
+        for (int p = 0; p < LOAD_REG_PROPERTIES; p++)
+        {
+            snprintf(_regTree[f].labels[p], sizeof(_regTree[f].labels[p]), "%s %d", names[p % 5], p);
+            registry.add(_regFunction(f), _regProperty(f, p), _regTree[f].tag, _regTree[f].labels[p]);
+        }
+    }
+
+    for (int n = 0; n < LOAD_REG_PATHS; n++)
+    {
+        int f = (n * 7) % LOAD_REG_FUNCTIONS;
+        int p = (n * 3) % LOAD_REG_PROPERTIES;
+
+        if (n % 2)
+            snprintf(paths[n], sizeof(paths[n]), "%s/%d", _regTree[f].tag, p);
+        else
+            snprintf(paths[n], sizeof(paths[n]), "%s/%s", _regTree[f].tag, _regTree[f].labels[p]);
+    }
+
+    long differ = 0;
+
+    for (int n = 0; n < LOAD_REG_PATHS; n++)
+        differ += _regResolve(registry, paths[n]) != _regWalk(paths[n]) || _regWalk(paths[n]) == nullptr;
+
+    uintptr_t check = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (long n = 0; n < lookups; n++)
+        check += (uintptr_t)_regResolve(registry, paths[n % LOAD_REG_PATHS]);
+
+    double hashed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (long n = 0; n < lookups; n++)
+        check -= (uintptr_t)_regWalk(paths[n % LOAD_REG_PATHS]);
+
+    double walked = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("tree       %d functions of %d properties, %u keys held\n", LOAD_REG_FUNCTIONS, LOAD_REG_PROPERTIES,
+           (unsigned)registry.count());
+    printf("registry   %ld in %.4fs, %.0f ns each\n", lookups, hashed, hashed * 1e9 / lookups);
+    printf("walk       %ld in %.4fs, %.0f ns each%s\n", lookups, walked, walked * 1e9 / lookups,
+           (differ || check) ? ", results differ" : "");
+}
+
+/*
+** Parser Benchmark
+**
+** Takes the same requests through HTTPParser, reading a socket as the
+** server does, and through the String parsing it replaced, kept here as
+** it was: a line at a time with readStringUntil(), split by indexOf() and
+** substring(), the wanted headers copied out.  The String side reads from
+** memory, so the system calls the parser makes count only against it, and
+** the host's String keeps short text in place where the device allocates,
+** so the allocations shown for it are fewer than a device makes.
+*/
+static const char *_parseRequests[] = {
+    "GET /page?name=bench&value=42 HTTP/1.1\r\nHost: 192.168.1.40\r\nConnection: keep-alive\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+    "Accept-Encoding: gzip, deflate\r\nAccept-Language: en-GB,en;q=0.9\r\n\r\n",
+    "POST /upnp/control/basicevent1 HTTP/1.1\r\nHost: 192.168.1.40:80\r\nContent-Type: text/xml; charset=\"utf-8\"\r\n"
+    "SOAPACTION: \"urn:Belkin:service:basicevent:1#SetBinaryState\"\r\nContent-Length: 0\r\n\r\n",
+    "GET /api/light/0 HTTP/1.1\r\nHost: 127.0.0.1\r\nIf-None-Match: \"1a2b3c\"\r\n\r\n",
+};
+
+#define LOAD_PARSE_KINDS (sizeof(_parseRequests) / sizeof(_parseRequests[0]))
+
+static const char *_parseWanted[] = {"Host", "Content-Type", "Content-Length", "If-None-Match"};
+
+class LoadStream : public Stream
+{
+  public:
+    LoadStream(const char *text) : _text(text), _pos(0), _len(strlen(text)) {}
+    LoadStream(const char *data, size_t len) : _text(data), _pos(0), _len(len) {}
+
+    int available(void) override { return _len - _pos; }
+    int read(void) override { return (_pos < _len) ? (uint8_t)_text[_pos++] : -1; }
+    int peek(void) override { return (_pos < _len) ? (uint8_t)_text[_pos] : -1; }
+    size_t write(uint8_t c) override { return (void)c, 0; }
+    using Print::write;
+
+  private:
+    const char *_text;
+    size_t _pos;
+    size_t _len;
+};
+
+// As IOTHTTP::_parseRequest() read the request line and headers
+static size_t _parseString(const char *request)
+{
+    LoadStream stream(request);
+    String wanted[sizeof(_parseWanted) / sizeof(_parseWanted[0])];
+    String req = stream.readStringUntil('\n');
+
+    if (req[req.length() - 1] == '\r')
+        req.trim();
+
+    int addr_start = req.indexOf(' ');
+    int addr_end = req.indexOf(' ', addr_start + 1);
+
+    if (addr_start == -1 || addr_end == -1)
+        return 0;
+
+    String methodStr = req.substring(0, addr_start);
+    String url = req.substring(addr_start + 1, addr_end);
+    String versionEnd = req.substring(addr_end + 8);
+    String searchStr = "";
+    int hasSearch = url.indexOf('?');
+    size_t found = atoi(versionEnd.c_str());
+
+    if (hasSearch != -1)
+    {
+        searchStr = url.substring(hasSearch + 1);
+        url = url.substring(0, hasSearch);
+    }
+
+    while (1)
+    {
+        String line = stream.readStringUntil('\n');
+
+        if (line[line.length() - 1] == '\r')
+            line.trim();
+        if (line == "")
+            break;
+
+        int headerDiv = line.indexOf(':');
+
+        if (headerDiv == -1)
+            break;
+
+        String headerName = line.substring(0, headerDiv);
+        String headerValue = line.substring(headerDiv + 1);
+
+        headerValue.trim();
+        for (size_t k = 0; k < sizeof(_parseWanted) / sizeof(_parseWanted[0]); k++)
+        {
+            if (headerName.equalsIgnoreCase(_parseWanted[k]))
+                wanted[k] = headerValue, found++;
+        }
+    }
+    return found + url.length() + searchStr.length() + methodStr.length();
+}
+
+static size_t _parseSlices(HTTPParser &parser, WiFiClient &client, int writer, const char *request)
+{
+    HTTPParseStatus status = HP_PARTIAL;
+    size_t found = 0;
+
+    send(writer, request, strlen(request), 0);
+    parser.clear();
+    while (status == HP_PARTIAL && parser.fill(client))
+        status = parser.parse();
+    if (status != HP_COMPLETE)
+        return 0;
+
+    found = atoi(parser.str(parser.version()) + 7);
+    for (uint8_t h = 0; h < parser.headers(); h++)
+    {
+        for (const char *name : _parseWanted)
+            found += parser.equalsIgnoreCase(parser.header(h).name, name);
+    }
+    return found + parser.uri().len + parser.query().len + parser.method().len;
+}
+
+static void _benchParser(long parses)
+{
+    HTTPParser *parser = new HTTPParser();
+    int pair[2];
+    size_t sliced = 0, strung = 0;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+        return;
+
+    WiFiClient client(pair[1]);
+
+    _heapAllocs = 0;
+    unsigned long start = micros();
+
+    for (long n = 0; n < parses; n++)
+        sliced += _parseSlices(*parser, client, pair[0], _parseRequests[n % LOAD_PARSE_KINDS]);
+
+    double parsed = (micros() - start) / 1e6;
+    unsigned long parseAllocs = _heapAllocs;
+
+    _heapAllocs = 0;
+    start = micros();
+    for (long n = 0; n < parses; n++)
+        strung += _parseString(_parseRequests[n % LOAD_PARSE_KINDS]);
+
+    double split = (micros() - start) / 1e6;
+    unsigned long stringAllocs = _heapAllocs;
+
+    printf("requests   %u shapes, %u to %u bytes\n", (unsigned)LOAD_PARSE_KINDS, (unsigned)strlen(_parseRequests[2]),
+           (unsigned)strlen(_parseRequests[0]));
+    printf("parser     %ld in %.2fs, %.0f req/s, %.1f allocations each\n", parses, parsed, parses / parsed,
+           (double)parseAllocs / parses);
+    printf("string     %ld in %.2fs, %.0f req/s, %.1f allocations each%s\n", parses, split, parses / split,
+           (double)stringAllocs / parses, (sliced == strung) ? "" : ", results differ");
+
+    close(pair[0]);
+    delete parser;
+}
+
+/*
+** Upload Benchmark
+**
+** Posts a file part of the size given to /upload over a kept connection,
+** then reads the same part through the byte at a time loop of the old
+** _parseForm(), kept here as it was, from memory rather than a socket.  The
+** file is random bytes with line ends and dashes through it, so both meet
+** near misses of the boundary.
+*/
+#define LOAD_UPLOAD_BYTES (64L << 20) // uploaded in all, in as many posts as it takes
+
+static void _uploadFile(std::string &file, size_t size)
+{
+    unsigned int seed = 4099;
+
+    file.resize(size);
+    for (size_t i = 0; i < size; i++)
+        file[i] = (char)rand_r(&seed);
+    for (size_t i = 64; i + 4 < size; i += 61)
+        memcpy(&file[i], (i % 3) ? "\r\n-" : "\r\n--", (i % 3) ? 3 : 4);
+}
+
+// The file part of IOTHTTP::_parseForm(), from its first byte to the boundary
+static size_t _uploadBytewise(LoadStream &client, const String &boundary, uint8_t *buf, uint32_t &check)
+{
+    size_t currentSize = 0, totalSize = 0;
+    auto _uploadWriteByte = [&](uint8_t b) {
+        if (currentSize == HTTP_UPLOAD_BUFLEN)
+        {
+            _uploadSum(check, buf, currentSize);
+            totalSize += currentSize;
+            currentSize = 0;
+        }
+        buf[currentSize++] = b;
+    };
+    auto _uploadReadByte = [&](void) { return (uint8_t)client.read(); };
+    uint8_t argByte = _uploadReadByte();
+
+readfile:
+    while (argByte != 0x0D)
+    {
+        if (!client.available())
+            return 0;
+        _uploadWriteByte(argByte);
+        argByte = _uploadReadByte();
+    }
+
+    argByte = _uploadReadByte();
+    if (argByte == 0x0A)
+    {
+        argByte = _uploadReadByte();
+        if ((char)argByte != '-')
+        {
+            _uploadWriteByte(0x0D);
+            _uploadWriteByte(0x0A);
+            goto readfile;
+        }
+        else
+        {
+            argByte = _uploadReadByte();
+            if ((char)argByte != '-')
+            {
+                _uploadWriteByte(0x0D);
+                _uploadWriteByte(0x0A);
+                _uploadWriteByte((uint8_t)('-'));
+                goto readfile;
+            }
+        }
+
+        uint8_t endBuf[boundary.length()];
+        client.readBytes(endBuf, boundary.length());
+
+        if (memcmp(endBuf, boundary.c_str(), boundary.length()) == 0)
+        {
+            _uploadSum(check, buf, currentSize);
+            return totalSize + currentSize;
+        }
+
+        _uploadWriteByte(0x0D);
+        _uploadWriteByte(0x0A);
+        _uploadWriteByte((uint8_t)('-'));
+        _uploadWriteByte((uint8_t)('-'));
+        for (uint32_t i = 0; i < boundary.length(); i++)
+            _uploadWriteByte(endBuf[i]);
+        argByte = _uploadReadByte();
+        goto readfile;
+    }
+
+    _uploadWriteByte(0x0D);
+    goto readfile;
+}
+
+static int _benchUpload(const LoadOptions &options)
+{
+    size_t size = options.upload * 1024;
+    long posts = std::max(4L, LOAD_UPLOAD_BYTES / (long)size);
+    std::string file, body, request;
+    uint32_t check = 0;
+    char head[256];
+    char *buf = new char[LOAD_BUFLEN];
+    int fd = _connect(options.port);
+    long failed = 0;
+
+    _uploadFile(file, size);
+    _uploadSum(check, (const uint8_t *)file.data(), file.size());
+
+    body = "--LoadBoundary\r\n"
+           "Content-Disposition: form-data; name=\"file\"; filename=\"load.bin\"\r\n"
+           "Content-Type: application/octet-stream\r\n\r\n" +
+           file + "\r\n--LoadBoundary--\r\n";
+    snprintf(head, sizeof(head),
+             "POST /upload HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n"
+             "Content-Type: multipart/form-data; boundary=LoadBoundary\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)body.size());
+    request = head + body;
+
+    unsigned long start = micros();
+
+    for (long n = 0; n < posts; n++)
+    {
+        bool closed = false;
+
+        if (fd < 0 || !_sendAll(fd, request) || _readResponse(fd, buf, closed) != 200)
+        {
+            failed = posts - n;
+            break;
+        }
+        failed += _uploaded != size || _uploadCheck != check;
+
+        // After the most requests a connection may carry
+        if (closed)
+        {
+            close(fd);
+            fd = _connect(options.port);
+        }
+    }
+
+    double served = (micros() - start) / 1e6;
+    uint8_t *part = new uint8_t[HTTP_UPLOAD_BUFLEN];
+    size_t at = body.find("\r\n\r\n") + 4;
+    long differ = 0;
+
+    start = micros();
+    for (long n = 0; n < posts; n++)
+    {
+        LoadStream client(body.data() + at, body.size() - at);
+        uint32_t sum = 0;
+
+        differ += _uploadBytewise(client, "LoadBoundary", part, sum) != size || sum != check;
+    }
+
+    double bytewise = (micros() - start) / 1e6;
+    double megabytes = (double)size * posts / 1e6;
+
+    printf("upload     %ld KB part, %ld posts\n", options.upload, posts);
+    printf("server     %.1f MB in %.2fs, %.1f MB/s, %ld wrong\n", megabytes, served, megabytes / served, failed);
+    printf("bytewise   %.1f MB in %.2fs, %.1f MB/s, %ld wrong\n", megabytes, bytewise, megabytes / bytewise, differ);
+
+    if (fd >= 0)
+        close(fd);
+    delete[] part;
+    delete[] buf;
+    return (failed || differ) ? 1 : 0;
+}
+
+static double _percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, (size_t)(p * sorted.size()))] / 1000.0;
+}
+
+/*
+** WebSocket Benchmark
+**
+** Each client opens a socket and writes properties in turn, timing the
+** round trip from its frame to the answer.  One more client watches a
+** property the others write, counting the changes it is told of; a watcher
+** that falls behind is sent the latest value rather than every one.
+*/
+static std::string _socketUpgrade(const char *headers = "")
+{
+    return std::string("GET /ws HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                       "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n") +
+           headers + "\r\n";
+}
+
+static int _socketOpen(uint16_t port, char *buf, const char *headers = "")
+{
+    int fd = _connect(port);
+    size_t len = 0;
+
+    if (fd < 0 || !_sendAll(fd, _socketUpgrade(headers)))
+        return -1;
+
+    // The server says nothing more until asked, so the headers end the read
+    while (len < LOAD_BUFLEN - 1)
+    {
+        ssize_t got = recv(fd, buf + len, LOAD_BUFLEN - 1 - len, 0);
+
+        if (got <= 0)
+            break;
+        len += got;
+        buf[len] = '\0';
+        if (strstr(buf, "\r\n\r\n"))
+            return (strncmp(buf, "HTTP/1.1 101", 12) == 0) ? fd : (close(fd), -1);
+    }
+    close(fd);
+    return -1;
+}
+
+static bool _socketSend(int fd, const char *text, uint32_t seed)
+{
+    uint8_t frame[6 + 125];
+    size_t len = strlen(text);
+    uint8_t key[4] = {(uint8_t)seed, (uint8_t)(seed >> 8), (uint8_t)(seed >> 16), (uint8_t)(seed >> 24)};
+
+    if (len > 125)
+        return false;
+
+    frame[0] = 0x80 | WS_OP_TEXT;
+    frame[1] = 0x80 | len;
+    memcpy(&frame[2], key, 4);
+    for (size_t i = 0; i < len; i++)
+        frame[6 + i] = text[i] ^ key[i & 3];
+    return _sendAll(fd, std::string((const char *)frame, 6 + len));
+}
+
+// One text frame's payload, terminated, false if the socket fails
+static bool _socketRead(int fd, char *text, size_t max)
+{
+    uint8_t head[4];
+    size_t len;
+
+    if (recv(fd, head, 2, MSG_WAITALL) != 2)
+        return false;
+    len = head[1] & 0x7F;
+    if (len == 126)
+    {
+        if (recv(fd, &head[2], 2, MSG_WAITALL) != 2)
+            return false;
+        len = (head[2] << 8) | head[3];
+    }
+    if (len >= max || (len && recv(fd, text, len, MSG_WAITALL) != (ssize_t)len))
+        return false;
+    text[len] = '\0';
+    return (head[0] & 0x0F) == WS_OP_TEXT;
+}
+
+static int _benchSocket(LoadOptions options)
+{
+    // The watcher takes one of the server's sockets
+    options.clients = std::min(options.clients, HTTP_SOCKET_CLIENTS - 1);
+
+    std::vector<LoadResult> results(options.clients);
+    std::vector<std::thread> clients;
+    std::atomic<long> watched(0);
+    std::atomic<bool> watching(false);
+    char *buf = new char[LOAD_BUFLEN];
+    int watcher = _socketOpen(options.port, buf);
+
+    // The watcher ends with a close, which its read loop sees as a failure
+    std::thread watch([&] {
+        char text[128];
+
+        if (watcher < 0 || !_socketSend(watcher, "w light 0", 1) || !_socketRead(watcher, text, sizeof(text)))
+            return;
+        watching = true;
+        while (_socketRead(watcher, text, sizeof(text)))
+            watched++;
+    });
+
+    while (watcher >= 0 && !watching)
+        usleep(100);
+
+    unsigned long start = micros();
+
+    for (int c = 0; c < options.clients; c++)
+    {
+        clients.emplace_back([&options, &results, c] {
+            LoadResult &result = results[c];
+            char *buf = new char[LOAD_BUFLEN];
+            char text[128];
+            int fd = _socketOpen(options.port, buf);
+
+            _heapIgnore = true;
+            result.connects = (fd >= 0);
+            for (long n = c; fd >= 0 && n < options.messages; n += options.clients)
+            {
+                unsigned long sent = micros();
+
+                snprintf(text, sizeof(text), "s light %d %ld", (int)(n % LOAD_PROPERTIES), n);
+                if (!_socketSend(fd, text, sent) || !_socketRead(fd, text, sizeof(text)) || text[0] != 'v')
+                {
+                    result.errors++;
+                    break;
+                }
+                result.latency.push_back(micros() - sent);
+            }
+            if (fd >= 0)
+                close(fd);
+            else
+                result.errors++;
+            delete[] buf;
+        });
+    }
+    for (auto &client : clients)
+        client.join();
+
+    double elapsed = (micros() - start) / 1e6;
+
+    usleep(100000);
+    shutdown(watcher, SHUT_RDWR);
+    watch.join();
+    if (watcher >= 0)
+        close(watcher);
+    delete[] buf;
+
+    LoadResult total;
+
+    for (auto &result : results)
+    {
+        total.latency.insert(total.latency.end(), result.latency.begin(), result.latency.end());
+        total.errors += result.errors;
+        total.connects += result.connects;
+    }
+    std::sort(total.latency.begin(), total.latency.end());
+
+    printf("sockets    %d writing, 1 watching\n", options.clients);
+    printf("messages   %lu in %.2fs, %.0f msg/s, %lu errors\n", (unsigned long)total.latency.size(), elapsed,
+           total.latency.size() / elapsed, total.errors + (watcher < 0));
+    printf("watched    %ld changes of %ld written\n", (long)watched, (options.messages + LOAD_PROPERTIES - 1) / LOAD_PROPERTIES);
+    printf("latency    p50 %.3fms, p90 %.3fms, p99 %.3fms, max %.3fms\n", _percentile(total.latency, 0.50),
+           _percentile(total.latency, 0.90), _percentile(total.latency, 0.99), _percentile(total.latency, 1.0));
+    return (total.errors || watcher < 0) ? 1 : 0;
+}
+
+/*
+** Route Checks
+**
+** Each check asks one connection for one response, read to its end, and
+** compares what came back with what the route should answer.  A line is
+** printed for every check and the status is the count that failed.
+*/
+struct LoadReply
+{
+    int code = 0;
+    std::string head;
+    std::string body; // with any chunking undone
+};
+
+static int _checked;
+static int _failed;
+
+/*
+** Whether raw holds the whole response, filling reply when it does.  The
+** server waits for the client to close once it has answered, so the end is
+** found from the framing and the connection only ends a body without any.
+*/
+static bool _reply(const std::string &raw, bool closed, LoadReply &reply)
+{
+    size_t head = raw.find("\r\n\r\n");
+
+    reply = LoadReply();
+    if (head == std::string::npos)
+        return false;
+    reply.code = atoi(raw.c_str() + 9);
+    reply.head = raw.substr(0, head + 2);
+    if (reply.code == 204 || reply.code == 304)
+        return true;
+
+    const char *length = strcasestr(reply.head.c_str(), "\r\nContent-Length:");
+
+    if (!strcasestr(reply.head.c_str(), "\r\nTransfer-Encoding: chunked"))
+    {
+        size_t size = (length) ? strtoul(length + 17, nullptr, 10) : raw.size() - head - 4;
+
+        if (raw.size() < head + 4 + size || (!length && !closed))
+            return false;
+        reply.body = raw.substr(head + 4, size);
+        return true;
+    }
+
+    for (size_t at = head + 4; at < raw.size();)
+    {
+        size_t size = strtoul(raw.c_str() + at, nullptr, 16);
+        size_t data = raw.find("\r\n", at);
+
+        if (data == std::string::npos || data + 2 + size + 2 > raw.size())
+            return false;
+        if (!size)
+            return true;
+        reply.body.append(raw, data + 2, size);
+        at = data + 2 + size + 2;
+    }
+    return false;
+}
+
+// One request on a connection that may be kept for more
+static bool _ask(int fd, const std::string &request, LoadReply &reply)
+{
+    std::string raw;
+    char buf[4096];
+    ssize_t got = 0;
+
+    reply = LoadReply();
+    if (fd < 0 || !_sendAll(fd, request))
+        return false;
+    while (!_reply(raw, false, reply) && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        raw.append(buf, got);
+    return got > 0 || _reply(raw, true, reply);
+}
+
+static bool _fetch(uint16_t port, const std::string &request, LoadReply &reply)
+{
+    timeval wait = {5, 0};
+    int fd = _connect(port);
+
+    // A server stuck elsewhere fails the check rather than hanging it
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+
+    bool ok = _ask(fd, request, reply);
+
+    if (fd >= 0)
+        close(fd);
+    return ok;
+}
+
+static std::string _get(const char *path, const char *headers = "")
+{
+    return std::string("GET ") + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n" + headers + "\r\n";
+}
+
+static void _expect(const char *name, bool ok, const char *detail = "")
+{
+    _checked++;
+    if (!ok)
+        _failed++;
+    printf("check      %-28s %s%s%s\n", name, (ok) ? "ok" : "FAILED", (*detail) ? ", " : "", detail);
+}
+
+// The samples of a history document, each time and its values
+static bool _historySamples(const std::string &body, std::vector<std::vector<double>> &samples)
+{
+    size_t at = body.find("\"samples\":[");
+
+    if (at == std::string::npos)
+        return false;
+
+    const char *p = body.c_str() + at + 11;
+
+    while (*p == '[' || *p == ',')
+    {
+        std::vector<double> sample;
+
+        if (*p == ',')
+            p++;
+        if (*p++ != '[')
+            return false;
+        while (*p != ']')
+        {
+            char *end;
+
+            sample.push_back(strtod(p, &end));
+            if (end == p)
+                return false;
+            p = (*end == ',') ? end + 1 : end;
+        }
+        p++;
+        samples.push_back(sample);
+    }
+    return *p == ']';
+}
+
+static void _checkHistory(uint16_t port)
+{
+    std::vector<std::vector<double>> samples;
+    LoadReply reply;
+    char detail[96];
+    bool ok;
+
+    ok = _fetch(port, _get("/history/sensor/0"), reply) && reply.code == 200 && _historySamples(reply.body, samples);
+    for (size_t n = 1; ok && n < samples.size(); n++)
+        ok = samples[n].size() == 2 && samples[n][0] > samples[n - 1][0];
+    ok = ok && !samples.empty() &&
+         samples.back()[0] == LOAD_HISTORY_START + (LOAD_HISTORY_SAMPLES - 1) * LOAD_HISTORY_STEP;
+    snprintf(detail, sizeof(detail), "%u samples, the last one added last", (unsigned)samples.size());
+    _expect("history raw", ok, detail);
+
+    // Closed buckets a minute apart, and the one still filling
+    samples.clear();
+    ok = _fetch(port, _get("/history/sensor/0?res=1m"), reply) && reply.code == 200 &&
+         _historySamples(reply.body, samples) && !samples.empty() && samples.size() <= IOT_HISTORY_MINUTES + 1;
+    for (size_t n = 0; ok && n < samples.size(); n++)
+        ok = samples[n].size() == 4 && samples[n][1] <= samples[n][3] && samples[n][3] <= samples[n][2] &&
+             (!n || samples[n][0] == samples[n - 1][0] + 60);
+    snprintf(detail, sizeof(detail), "%u buckets, min <= avg <= max", (unsigned)samples.size());
+    _expect("history 1m", ok, detail);
+
+    uint32_t from = LOAD_HISTORY_START + 5 * 3600, to = from + 600;
+
+    samples.clear();
+    snprintf(detail, sizeof(detail), "/history/sensor/0?res=1m&from=%lu&to=%lu", (unsigned long)from, (unsigned long)to);
+    ok = _fetch(port, _get(detail), reply) && reply.code == 200 && _historySamples(reply.body, samples) &&
+         !samples.empty();
+    for (size_t n = 0; ok && n < samples.size(); n++)
+        ok = samples[n][0] >= from && samples[n][0] <= to;
+    snprintf(detail, sizeof(detail), "%u buckets within ten minutes", (unsigned)samples.size());
+    _expect("history from and to", ok, detail);
+
+    _expect("history bad resolution", _fetch(port, _get("/history/sensor/0?res=5m"), reply) && reply.code == 400);
+    _expect("history none kept", _fetch(port, _get("/history/sensor/1"), reply) && reply.code == 404);
+}
+
+static std::string _range(const char *spec, const char *also = "")
+{
+    return std::string("Range: bytes=") + spec + "\r\n" + also;
+}
+
+// A header's value from the head of a reply, empty when it is not there
+static std::string _header(const LoadReply &reply, const char *name)
+{
+    std::string key = std::string("\r\n") + name + ":";
+    const char *at = strcasestr(reply.head.c_str(), key.c_str());
+
+    if (!at)
+        return "";
+    at += key.size();
+    while (*at == ' ')
+        at++;
+    return std::string(at, strcspn(at, "\r"));
+}
+
+// Each part of a multipart/byteranges body checked against the file
+static int _rangeParts(const LoadReply &reply)
+{
+    std::string type = _header(reply, "Content-Type");
+    size_t b = type.find("boundary=");
+    int parts = 0;
+
+    if (b == std::string::npos)
+        return -1;
+
+    std::string delimiter = "\r\n--" + type.substr(b + 9);
+    size_t at = reply.body.find(delimiter);
+
+    while (at != std::string::npos && reply.body.compare(at + delimiter.size(), 2, "--") != 0)
+    {
+        size_t head = reply.body.find("\r\n\r\n", at);
+        size_t range = reply.body.find("Content-Range: bytes ", at);
+        unsigned long first, last, size;
+
+        if (head == std::string::npos || range > head ||
+            sscanf(reply.body.c_str() + range + 21, "%lu-%lu/%lu", &first, &last, &size) != 3 ||
+            size != _fileData.size() || reply.body.compare(head + 4, last - first + 1, _fileData, first, last - first + 1) != 0)
+            return -1;
+
+        parts++;
+        at = reply.body.find(delimiter, head + 4 + last - first + 1);
+        if (at != head + 4 + last - first + 1)
+            return -1;
+    }
+    return (at == std::string::npos) ? -1 : parts;
+}
+
+// A transfer cut off at random offsets and taken up again from each
+static void _checkRanges(uint16_t port)
+{
+    const std::string &file = _fileData;
+    const char *path = "/files/blob.bin";
+    unsigned int seed = 131;
+    LoadReply reply;
+    char spec[96];
+    char detail[96];
+    bool ok;
+
+    ok = _fetch(port, _get(path), reply) && reply.code == 200 && reply.body == file &&
+         _header(reply, "Accept-Ranges") == "bytes";
+    snprintf(detail, sizeof(detail), "%u bytes", (unsigned)reply.body.size());
+    _expect("file whole", ok, detail);
+
+    int resumed = 0;
+
+    for (int n = 0; n < 64; n++)
+    {
+        size_t cut = 1 + rand_r(&seed) % (file.size() - 1);
+        std::string got;
+
+        snprintf(spec, sizeof(spec), "0-%u", (unsigned)cut - 1);
+        if (!_fetch(port, _get(path, _range(spec).c_str()), reply) || reply.code != 206)
+            break;
+        got = reply.body;
+
+        snprintf(spec, sizeof(spec), "%u-", (unsigned)cut);
+        if (!_fetch(port, _get(path, _range(spec).c_str()), reply) || reply.code != 206)
+            break;
+        snprintf(spec, sizeof(spec), "bytes %u-%u/%u", (unsigned)cut, (unsigned)file.size() - 1, (unsigned)file.size());
+        if (_header(reply, "Content-Range") != spec || got + reply.body != file)
+            break;
+        resumed++;
+    }
+    snprintf(detail, sizeof(detail), "%d of 64 random cuts taken up again", resumed);
+    _expect("range resume", resumed == 64, detail);
+
+    ok = _fetch(port, _get(path, _range("-500").c_str()), reply) && reply.code == 206 &&
+         reply.body == file.substr(file.size() - 500);
+    _expect("range suffix", ok);
+
+    int parts = 0;
+
+    for (int n = 0; n < 16; n++)
+    {
+        size_t first = rand_r(&seed) % (file.size() / 3);
+
+        snprintf(spec, sizeof(spec), "%u-%u, %u-%u,-%u", (unsigned)first, (unsigned)first + 99,
+                 (unsigned)first * 2 + 200, (unsigned)first * 2 + 299 + n, 10 + n);
+        if (!_fetch(port, _get(path, _range(spec).c_str()), reply) || reply.code != 206 || _rangeParts(reply) != 3)
+            break;
+        parts++;
+    }
+    snprintf(detail, sizeof(detail), "%d of 16 with three parts", parts);
+    _expect("range multipart", parts == 16, detail);
+
+    snprintf(spec, sizeof(spec), "%u-", (unsigned)file.size());
+    snprintf(detail, sizeof(detail), "bytes */%u", (unsigned)file.size());
+    ok = _fetch(port, _get(path, _range(spec).c_str()), reply) && reply.code == 416 &&
+         _header(reply, "Content-Range") == detail;
+    _expect("range past the end", ok, "416");
+
+    ok = _fetch(port, _get(path, _range("abc").c_str()), reply) && reply.code == 200 && reply.body == file;
+    _expect("range not understood", ok, "whole file");
+
+    ok = _fetch(port, _get(path, _range("0-9", "If-Range: \"stale\"\r\n").c_str()), reply) && reply.code == 200 &&
+         reply.body == file;
+    _expect("range if-range stale", ok, "whole file");
+}
+
+/*
+** The file's ETag, a 304 for a browser holding it and a new tag once the
+** file is written again at the same size and the index refreshed.  The
+** write is dated a minute on, as the filesystem keeps times to the second.
+*/
+static void _checkFileTag(uint16_t port)
+{
+    const char *path = "/files/blob.bin";
+    std::string disk = std::string(_fileRoot) + "/blob.bin";
+    std::string tag, header;
+    unsigned int seed = 524287;
+    LoadReply reply;
+    utimbuf times;
+    FILE *f;
+    bool ok;
+
+    ok = _fetch(port, _get(path), reply) && reply.code == 200 && !(tag = _header(reply, "ETag")).empty();
+    _expect("file etag", ok, tag.c_str());
+
+    // Answered from the index, the file just checked isn't opened again
+    unsigned long opened = FS::opened;
+
+    header = "If-None-Match: " + tag + "\r\n";
+    ok = _fetch(port, _get(path, header.c_str()), reply) && reply.code == 304 && reply.body.empty() &&
+         FS::opened == opened;
+    _expect("file not modified", ok, "304, no file opened");
+
+    header = "If-Range: " + tag + "\r\n";
+    ok = _fetch(port, _get(path, _range("0-9", header.c_str()).c_str()), reply) && reply.code == 206 &&
+         reply.body == _fileData.substr(0, 10);
+    _expect("range if-range current", ok, "206");
+    header = "If-None-Match: " + tag + "\r\n";
+
+    for (char &c : _fileData)
+        c = (char)rand_r(&seed);
+    if ((f = fopen(disk.c_str(), "wb")))
+    {
+        fwrite(_fileData.data(), 1, _fileData.size(), f);
+        fclose(f);
+    }
+    times.actime = times.modtime = time(nullptr) + 60;
+    utime(disk.c_str(), &times);
+    _server->webRefresh();
+
+    ok = _fetch(port, _get(path, header.c_str()), reply) && reply.code == 200 && reply.body == _fileData &&
+         _header(reply, "ETag") != tag;
+    _expect("file rewritten", ok, "same size, new tag and bytes");
+}
+
+/*
+** A body held whole or a multipart form that trickles in holds up no one
+** else, and one too large is refused with the answer reaching a client
+** still sending, the connection ending in a FIN rather than a reset
+*/
+static void _checkBodies(uint16_t port)
+{
+    std::string form = "name=slow&value=" + std::string(40, '7');
+    std::string block(16384, 'x');
+    timeval wait = {3, 0};
+    char head[192];
+    char detail[64];
+    char buf[4096];
+    std::string raw;
+    LoadReply reply;
+    ssize_t got = 0;
+    bool page, ok;
+
+    snprintf(head, sizeof(head),
+             "POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)form.size());
+
+    int fd = _connect(port);
+
+    ok = fd >= 0 && _sendAll(fd, head + form.substr(0, 20));
+    usleep(20000);
+
+    // With a single slot the page could only wait its turn
+    unsigned long start = micros();
+
+    page = HTTP_MAX_CLIENTS < 2 || (_fetch(port, _get("/page?name=meanwhile"), reply) && reply.code == 200);
+
+    unsigned long waited = micros() - start;
+
+    ok = ok && _sendAll(fd, form.substr(20));
+    while (ok && !_reply(raw, false, reply) && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        raw.append(buf, got);
+    ok = ok && page && waited < 100000 && reply.code == 200 && reply.body == "2 fields, value " + form.substr(16);
+    snprintf(detail, sizeof(detail), "a page answered in %.1fms meanwhile", waited / 1000.0);
+    _expect("body trickled in", ok, detail);
+    if (fd >= 0)
+        close(fd);
+
+    // A multipart form split inside a field and inside a file
+    form = "--LoadBoundary\r\nContent-Disposition: form-data; name=\"name\"\r\n\r\nslow\r\n"
+           "--LoadBoundary\r\nContent-Disposition: form-data; name=\"value\"\r\n\r\n" +
+           std::string(40, '7') + "\r\n--LoadBoundary\r\n"
+           "Content-Disposition: form-data; name=\"file\"; filename=\"slow.bin\"\r\n\r\n" +
+           std::string(3000, 'x') + "\r\n--LoadBoundary--\r\n";
+    snprintf(head, sizeof(head),
+             "POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n"
+             "Content-Type: multipart/form-data; boundary=LoadBoundary\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)form.size());
+    raw.clear();
+    reply = LoadReply();
+    fd = _connect(port);
+    ok = fd >= 0 && _sendAll(fd, head + form.substr(0, 150));
+    usleep(20000);
+    start = micros();
+    page = HTTP_MAX_CLIENTS < 2 || (_fetch(port, _get("/page?name=meanwhile"), reply) && reply.code == 200);
+    waited = micros() - start;
+    ok = ok && _sendAll(fd, form.substr(150, 1470));
+    usleep(20000);
+    ok = ok && _sendAll(fd, form.substr(1620));
+    while (ok && !_reply(raw, false, reply) && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        raw.append(buf, got);
+    ok = ok && page && waited < 100000 && reply.code == 200 && reply.body == "2 fields, value " + std::string(40, '7');
+    snprintf(detail, sizeof(detail), "a page answered in %.1fms meanwhile", waited / 1000.0);
+    _expect("form trickled in", ok, detail);
+    if (fd >= 0)
+        close(fd);
+
+    snprintf(head, sizeof(head),
+             "POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+             "Content-Type: text/plain\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)block.size() * 16);
+    raw.clear();
+    fd = _connect(port);
+    ok = fd >= 0 && _sendAll(fd, head);
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    for (int n = 0; ok && n < 16 && _sendAll(fd, block); n++)
+        ;
+    while (ok && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        raw.append(buf, got);
+    ok = ok && got == 0 && _reply(raw, true, reply) && reply.code == 413;
+    _expect("body too large", ok, "413 behind a body still sent, then a FIN");
+    if (fd >= 0)
+        close(fd);
+}
+
+/*
+** Bodies whose length the server can't trust, a chunked request and one with
+** Content-Length behind more headers than are kept.  Each carries a request
+** in its body, which must not be answered as one: a single reply, then a FIN.
+*/
+static bool _framingRefused(uint16_t port, const std::string &request, int code)
+{
+    timeval wait = {3, 0};
+    char buf[4096];
+    std::string raw;
+    LoadReply reply;
+    ssize_t got = 0;
+    int fd = _connect(port);
+    bool ok = fd >= 0 && _sendAll(fd, request);
+
+    if (fd >= 0)
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    while (ok && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        raw.append(buf, got);
+    if (fd >= 0)
+        close(fd);
+    return ok && got == 0 && _reply(raw, true, reply) && reply.code == code && raw.find("HTTP/1.1", 1) == std::string::npos;
+}
+
+static void _checkFraming(uint16_t port)
+{
+    static const char smuggled[] = "GET /page?name=smuggled HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+    char size[16];
+    std::string request;
+
+    snprintf(size, sizeof(size), "%x\r\n", (unsigned)strlen(smuggled));
+    request = std::string("POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: text/plain\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\n") +
+              size + smuggled + "\r\n0\r\n\r\n";
+    _expect("chunked request", _framingRefused(port, request, 501), "501, the chunks not taken as a request");
+
+    request = "POST /form HTTP/1.1\r\nHost: 127.0.0.1\r\nContent-Type: text/plain\r\n";
+    for (int h = 0; h < HTTP_MAX_HEADERS; h++)
+        request += "X-Pad-" + std::to_string(h) + ": y\r\n";
+    request += "Content-Length: " + std::to_string(strlen(smuggled)) + "\r\n\r\n" + smuggled;
+    _expect("headers overflowed", _framingRefused(port, request, 431), "431, the body not taken as a request");
+}
+
+/*
+** Basic auth against webCredentials(), a new password turning away the
+** old on a connection that proved it.  Logging in 255 times more brings
+** the epoch round to where it was, with HTTP_AUTH_CACHE the connection
+** must still not be trusted.
+*/
+static std::string _authGet(const char *password)
+{
+    std::string plain = std::string("admin:") + password;
+    char encoded[64];
+
+    base64_encode_chars(plain.c_str(), plain.size(), encoded);
+    return "GET /private HTTP/1.1\r\nHost: 127.0.0.1\r\nAuthorization: Basic " + std::string(encoded) + "\r\n\r\n";
+}
+
+static void _checkAuth(uint16_t port)
+{
+    LoadReply reply;
+    int fd;
+    bool ok;
+
+    ok = _fetch(port, _get("/private"), reply) && reply.code == 401 && !_header(reply, "WWW-Authenticate").empty();
+    _expect("auth none", ok, "401");
+
+    // Before the kept connection, which would hold a single slot
+    ok = _fetch(port, _authGet("secreT"), reply) && reply.code == 401;
+    fd = _connect(port);
+    ok = ok && _ask(fd, _authGet("secret"), reply) && reply.code == 200;
+    _expect("auth password", ok, "401 for one letter off, then 200");
+
+    ok = _ask(fd, _authGet("secret"), reply) && reply.code == 200;
+    strcpy(_authPassword, "changed");
+    ok = ok && _ask(fd, _authGet("secret"), reply) && reply.code == 401 && _ask(fd, _authGet("changed"), reply) && reply.code == 200;
+    _expect("auth changed", ok, "the old password refused on the same connection");
+
+    ok = _ask(fd, _authGet("changed"), reply) && reply.code == 200;
+    for (int n = 0; n < 255; n++)
+        _server->webLogin("admin", (n & 1) ? "changed" : "other");
+    strcpy(_authPassword, "other");
+    ok = ok && _ask(fd, _authGet("changed"), reply) && reply.code == 401;
+    _expect("auth epoch wrapped", ok, "255 logins later, still refused");
+    if (fd >= 0)
+        close(fd);
+    strcpy(_authPassword, "secret");
+}
+
+/*
+** Property endpoints once the server has credentials, a socket upgrade
+** and an api write asking for them like any page, an api read not.
+*/
+static void _checkGuarded(uint16_t port)
+{
+    char buf[LOAD_BUFLEN];
+    char authorization[64] = "Authorization: Basic ";
+    LoadReply reply;
+    int fd;
+    bool ok;
+
+    _server->webLogin("admin", "secret");
+    base64_encode_chars("admin:secret", 12, authorization + strlen(authorization));
+    strcat(authorization, "\r\n");
+
+    ok = _fetch(port, _socketUpgrade(), reply) && reply.code == 401;
+    fd = ok ? _socketOpen(port, buf, authorization) : -1;
+    ok = ok && fd >= 0;
+    _expect("guarded socket", ok, "401 without credentials, 101 with");
+    if (fd >= 0)
+        close(fd);
+
+    std::string put = "PUT /api/light/1 HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\nContent-Type: text/plain\r\nContent-Length: 4\r\n";
+
+    _readings[1][1] = 0;
+    ok = _fetch(port, put + "\r\n12.5", reply) && reply.code == 401 && _readings[1][1] == 0;
+    ok = ok && _fetch(port, _get("/api/light/1"), reply) && reply.code == 200;
+    ok = ok && _fetch(port, put + authorization + "\r\n12.5", reply) && reply.code == 200 && _readings[1][1] == 12.5f;
+    _expect("guarded api", ok, "a write refused without credentials, a read not");
+    _readings[1][1] = 0;
+
+    _server->webLogin(NULL, NULL);
+}
+
+// The large form decoded whole, whatever the blocks it arrives in
+static void _checkSettings(uint16_t port)
+{
+    std::string form;
+    uint32_t check;
+    char reply[48];
+    char head[192];
+    LoadReply got;
+
+    form = _settingsForm(check);
+    snprintf(head, sizeof(head),
+             "POST /settings HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)form.size());
+    snprintf(reply, sizeof(reply), "%d fields, check %08x", LOAD_SETTINGS_FIELDS, (unsigned)check);
+
+    bool ok = _fetch(port, head + form, got) && got.code == 200 && got.body == reply;
+
+    snprintf(head, sizeof(head), "%u bytes, %s", (unsigned)form.size(), got.body.c_str());
+    _expect("settings streamed", ok, head);
+
+    // Half now and half later, the server answering others in between
+    snprintf(head, sizeof(head),
+             "POST /settings HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n"
+             "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %u\r\n\r\n",
+             (unsigned)form.size());
+
+    int fd = _connect(port);
+
+    ok = fd >= 0 && _sendAll(fd, head + form.substr(0, form.size() / 2));
+    usleep(20000);
+
+    unsigned long start = micros();
+    bool page = HTTP_MAX_CLIENTS < 2 || (_fetch(port, _get("/page?name=meanwhile"), got) && got.code == 200);
+    unsigned long waited = micros() - start;
+
+    ok = ok && page && waited < 100000 && _sendAll(fd, form.substr(form.size() / 2)) && _ask(fd, "", got);
+    ok = ok && got.code == 200 && got.body == reply;
+    snprintf(head, sizeof(head), "a page answered in %.1fms meanwhile", waited / 1000.0);
+    _expect("settings trickled", ok, head);
+    if (fd >= 0)
+        close(fd);
+}
+
+/*
+** Server-Sent Events, published straight to the server as a property write
+** would be.  A listener is taken before its headers go, so once they are
+** read whatever is published next is its own.
+*/
+struct LoadEvent
+{
+    uint32_t id;
+    int value;
+};
+
+static void _eventsPublish(int from, int count)
+{
+    char text[16];
+
+    for (int n = 0; n < count; n++)
+    {
+        snprintf(text, sizeof(text), "%d", from + n);
+        _server->webEvent(_functionTags[2], 0, text, time(nullptr));
+    }
+}
+
+static int _eventsOpen(uint16_t port, const char *headers, std::string &pending)
+{
+    int fd = _connect(port);
+    timeval wait = {2, 0};
+    char buf[512];
+    ssize_t got = 0;
+
+    pending.clear();
+    if (fd < 0)
+        return -1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &wait, sizeof(wait));
+    if (!_sendAll(fd, std::string("GET /events HTTP/1.1\r\nHost: 127.0.0.1\r\n") + headers + "\r\n"))
+    {
+        close(fd);
+        return -1;
+    }
+
+    while (pending.find("\r\n\r\n") == std::string::npos && (got = recv(fd, buf, sizeof(buf), 0)) > 0)
+        pending.append(buf, got);
+    if (got <= 0 || pending.compare(0, 12, "HTTP/1.1 200") != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    pending.erase(0, pending.find("\r\n\r\n") + 4);
+    return fd;
+}
+
+// Update events until count are held, skipping retry, ping and the like
+static bool _eventsRead(int fd, std::string &pending, size_t count, std::vector<LoadEvent> &events)
+{
+    char buf[512];
+    ssize_t got;
+
+    events.clear();
+    while (events.size() < count)
+    {
+        size_t end = pending.find("\n\n");
+
+        if (end == std::string::npos)
+        {
+            if ((got = recv(fd, buf, sizeof(buf), 0)) <= 0)
+                return false;
+            pending.append(buf, got);
+            continue;
+        }
+
+        std::string block = pending.substr(0, end + 1);
+        size_t value = block.find("\"v\":\"");
+
+        pending.erase(0, end + 2);
+        if (block.compare(0, 4, "id: ") != 0 || block.find("\nevent: update\n") == std::string::npos ||
+            value == std::string::npos)
+            continue;
+        events.push_back({(uint32_t)strtoul(block.c_str() + 4, nullptr, 10), atoi(block.c_str() + value + 5)});
+    }
+    return true;
+}
+
+// Values from first on, one after another and with IDs that follow
+static bool _eventsFollow(const std::vector<LoadEvent> &events, int first)
+{
+    for (size_t e = 0; e < events.size(); e++)
+    {
+        if (events[e].value != first + (int)e || (e && events[e].id != events[e - 1].id + 1))
+            return false;
+    }
+    return !events.empty();
+}
+
+static void _checkEvents(uint16_t port)
+{
+    std::vector<LoadEvent> events;
+    std::string pending;
+    char headers[48];
+    uint32_t seen = 0;
+    bool ok;
+
+    // Nothing published before a listener without Last-Event-ID is replayed
+    _eventsPublish(0, 2);
+    int fd = _eventsOpen(port, "", pending);
+
+    _eventsPublish(2, 5);
+    ok = fd >= 0 && _eventsRead(fd, pending, 5, events) && _eventsFollow(events, 2);
+    _expect("events live", ok, "5 published after subscribing, none before");
+    if (ok)
+        seen = events[1].id;
+    if (fd >= 0)
+        close(fd);
+
+    // Away for three, back from the second seen with the rest still held
+    _eventsPublish(7, 3);
+    snprintf(headers, sizeof(headers), "Last-Event-ID: %lu\r\n", (unsigned long)seen);
+    fd = _eventsOpen(port, headers, pending);
+    ok = fd >= 0 && seen && _eventsRead(fd, pending, 6, events) && _eventsFollow(events, 4);
+    _expect("events resume", ok, "6 missed taken up from Last-Event-ID");
+    if (fd >= 0)
+        close(fd);
+
+    // Away long enough for the ring to lap, back from the next published
+    _eventsPublish(10, HTTP_EVENT_BACKLOG + 4);
+    fd = _eventsOpen(port, headers, pending);
+    _eventsPublish(10 + HTTP_EVENT_BACKLOG + 4, 2);
+    ok = fd >= 0 && seen && _eventsRead(fd, pending, 2, events) && _eventsFollow(events, 10 + HTTP_EVENT_BACKLOG + 4);
+    _expect("events lapped", ok, "Last-Event-ID no longer held, none replayed");
+    if (fd >= 0)
+        close(fd);
+}
+
+static int _checkRoutes(uint16_t port)
+{
+    _checkHistory(port);
+    _checkRanges(port);
+    _checkFileTag(port);
+    _checkBodies(port);
+    _checkFraming(port);
+    _checkAuth(port);
+    _checkGuarded(port);
+    _checkSettings(port);
+    _checkEvents(port);
+
+    printf("checked    %d, %d failed\n", _checked, _failed);
+    return _failed;
+}
+
+int main(int argc, char **argv)
+{
+    LoadOptions options;
+
+    if (!_parseOptions(argc, argv, options))
+    {
+        fprintf(stderr, "usage: %s [-c clients] [-n requests | -d seconds | -j dumps | -l lookups | -q parses] [-k 0|1] [-m page,form,upload,schema,api,history,file,range,settings] [-p port] [-r rate,burst] [-s slow] [-t] [-u kilobytes] [-v level] [-w messages] [-x]\n", argv[0]);
+        return 2;
+    }
+
+    if (options.dumps > 0)
+    {
+        _benchJson(options.dumps);
+        return 0;
+    }
+
+    if (options.lookups > 0)
+    {
+        _benchRegistry(options.lookups);
+        return 0;
+    }
+
+    if (options.parses > 0)
+    {
+        _benchParser(options.parses);
+        return 0;
+    }
+
+    _buildRequests(options.keepAlive);
+
+    IOTHTTP *server = new IOTHTTP("HTTP", options.port, false);
+    std::thread loop;
+
+    _addRoutes(*server);
+    server->webLimit(options.rate, options.burst);
+    if (options.tasked)
+        server->webTask(0);
+    server->webStartup();
+
+    // Nothing more is allocated for the routes, measure from here
+    long idle = _heapUsed;
+
+    _heapPeak = idle;
+    _heapAllocs = 0;
+    _heapIgnore = true;
+
+    // As IOTMaster::iotService() does, a tasked server still needs loop()
+    // to answer its sync calls
+    loop = std::thread([server] {
+        while (!_served)
+        {
+            if (server->webTasked())
+            {
+                server->webDispatch();
+                yield();
+            }
+            else
+                server->webService();
+        }
+    });
+
+    if (options.messages > 0 || options.upload > 0 || options.check)
+    {
+        int status = (options.check) ? _checkRoutes(options.port) : (options.upload > 0) ? _benchUpload(options) : _benchSocket(options);
+
+        _served = true;
+        loop.join();
+        server->webShutdown();
+        return status;
+    }
+
+    std::vector<LoadResult> results(options.clients);
+    std::vector<std::thread> clients;
+    unsigned long start = micros();
+
+    std::vector<LoadResult> slowResults(options.slow);
+    std::vector<std::thread> slow;
+
+    for (int c = 0; c < options.slow; c++)
+        slow.emplace_back(_slowClient, std::cref(options), std::ref(slowResults[c]));
+    for (int c = 0; c < options.clients; c++)
+        clients.emplace_back(_client, std::cref(options), c, std::ref(results[c]));
+
+    if (options.seconds)
+    {
+        usleep((useconds_t)(options.seconds * 1e6));
+        _stop = true;
+    }
+    for (auto &client : clients)
+        client.join();
+
+    double elapsed = (micros() - start) / 1e6;
+
+    _stop = true;
+    for (auto &client : slow)
+        client.join();
+
+    _served = true;
+    if (loop.joinable())
+        loop.join();
+    server->webShutdown();
+
+    LoadResult total;
+
+    for (auto &result : results)
+    {
+        total.latency.insert(total.latency.end(), result.latency.begin(), result.latency.end());
+        for (int k = 0; k < LOAD_KINDS; k++)
+            total.count[k] += result.count[k];
+        total.errors += result.errors;
+        total.connects += result.connects;
+        total.refused += result.refused;
+    }
+    std::sort(total.latency.begin(), total.latency.end());
+
+    printf("clients    %d, keep-alive %s, %s, %d slots\n", options.clients, (options.keepAlive) ? "on" : "off",
+           (options.tasked) ? "tasked" : "loop", HTTP_MAX_CLIENTS);
+    printf("requests   %lu in %.2fs, %.0f req/s, %lu errors, %lu connections\n",
+           (unsigned long)total.latency.size(), elapsed, total.latency.size() / elapsed, total.errors, total.connects);
+    printf("refused    %lu seen by clients, %u rate, %u busy, %u idle reclaimed\n", total.refused,
+           (unsigned)server->webLimiter().limited(), (unsigned)server->webLimiter().busy(),
+           (unsigned)server->webLimiter().reclaimed());
+    printf("mix       ");
+    for (int k = 0; k < LOAD_KINDS; k++)
+        printf(" %s %lu", _kindNames[k], total.count[k]);
+    printf("\n");
+    printf("latency    p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms\n",
+           _percentile(total.latency, 0.50), _percentile(total.latency, 0.90), _percentile(total.latency, 0.99),
+           _percentile(total.latency, 0.999), _percentile(total.latency, 1.0));
+
+    if (options.slow)
+    {
+        LoadResult slowest;
+
+        for (auto &result : slowResults)
+        {
+            slowest.latency.insert(slowest.latency.end(), result.latency.begin(), result.latency.end());
+            slowest.errors += result.errors;
+        }
+        std::sort(slowest.latency.begin(), slowest.latency.end());
+        printf("slow       %d clients, %lu requests, %lu errors, p50 %.3fms, max %.3fms\n", options.slow,
+               (unsigned long)slowest.latency.size(), slowest.errors, _percentile(slowest.latency, 0.50),
+               _percentile(slowest.latency, 1.0));
+    }
+    printf("heap       %ld bytes idle, peak %ld above it, %lu allocations while serving\n",
+           idle, (long)_heapPeak - idle, (unsigned long)_heapAllocs);
+
+    return (total.errors) ? 1 : 0;
+}
+
+/******************************************************************************/
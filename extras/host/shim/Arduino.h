@@ -0,0 +1,288 @@
+/*
+** EasyIOT - (Host) Arduino Core Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_ARDUINO_H
+#define _IOT_HOST_ARDUINO_H
+
+/*
+** Only as much of the Arduino core as the HTTP server uses, so it can be
+** built and measured on Linux.  String is a thin wrapper over std::string,
+** which is close enough in its allocation pattern to show a regression.
+*/
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cstdint>
+#include <cstdarg>
+#include <cctype>
+#include <ctime>
+#include <functional>
+#include <algorithm>
+#include <memory>
+#include <inttypes.h>
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void yield(void);
+
+inline uint32_t esp_random(void) { return (uint32_t)rand(); }
+
+#define F(s) (s)
+#define PROGMEM
+#define IRAM_ATTR
+
+class String
+{
+  public:
+    String() {}
+    String(const char *text)
+    {
+        if (text)
+            _s = text;
+    }
+    String(const std::string &text) : _s(text) {}
+    String(char c) : _s(1, c) {}
+    String(int v) : _s(std::to_string(v)) {}
+    String(unsigned int v) : _s(std::to_string(v)) {}
+    String(long v) : _s(std::to_string(v)) {}
+    String(unsigned long v) : _s(std::to_string(v)) {}
+    String(long long v) : _s(std::to_string(v)) {}
+    String(unsigned long long v) : _s(std::to_string(v)) {}
+    String(unsigned char v) : _s(std::to_string(v)) {}
+    String(double v, unsigned char decimals = 2)
+    {
+        char buf[64];
+
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        _s = buf;
+    }
+
+    unsigned int length(void) const { return _s.size(); }
+    const char *c_str(void) const { return _s.c_str(); }
+    bool reserve(unsigned int size)
+    {
+        _s.reserve(size);
+        return true;
+    }
+
+    char charAt(unsigned int i) const { return (i < _s.size()) ? _s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char &operator[](unsigned int i) { return _s[i]; }
+
+    String substring(unsigned int from) const { return (from >= _s.size()) ? String() : String(_s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (to > _s.size())
+            to = _s.size();
+        if (from > to)
+            std::swap(from, to);
+        return String(_s.substr(from, to - from));
+    }
+
+    int indexOf(char c, unsigned int from = 0) const { return _pos(_s.find(c, from)); }
+    int indexOf(const char *text, unsigned int from = 0) const { return _pos(_s.find(text, from)); }
+    int indexOf(const String &text, unsigned int from = 0) const { return _pos(_s.find(text._s, from)); }
+    int lastIndexOf(char c) const { return _pos(_s.rfind(c)); }
+
+    bool equals(const String &other) const { return _s == other._s; }
+    bool equals(const char *other) const { return _s == other; }
+    bool equalsIgnoreCase(const String &other) const { return strcasecmp(_s.c_str(), other.c_str()) == 0; }
+    bool startsWith(const String &prefix) const { return _s.compare(0, prefix._s.size(), prefix._s) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return _s.size() >= suffix._s.size() && _s.compare(_s.size() - suffix._s.size(), suffix._s.size(), suffix._s) == 0;
+    }
+
+    long toInt(void) const { return atol(_s.c_str()); }
+    float toFloat(void) const { return atof(_s.c_str()); }
+
+    void trim(void)
+    {
+        size_t first = 0, last = _s.size();
+
+        while (first < last && isspace((unsigned char)_s[first]))
+            first++;
+        while (last > first && isspace((unsigned char)_s[last - 1]))
+            last--;
+        _s = _s.substr(first, last - first);
+    }
+
+    void remove(unsigned int index)
+    {
+        if (index < _s.size())
+            _s.erase(index);
+    }
+    void remove(unsigned int index, unsigned int count)
+    {
+        if (index < _s.size())
+            _s.erase(index, count);
+    }
+
+    void toLowerCase(void)
+    {
+        for (auto &c : _s)
+            c = tolower((unsigned char)c);
+    }
+
+    bool concat(const char *text, unsigned int len)
+    {
+        _s.append(text, len);
+        return true;
+    }
+    bool concat(const String &text)
+    {
+        _s += text._s;
+        return true;
+    }
+
+    String &operator+=(const String &other)
+    {
+        _s += other._s;
+        return *this;
+    }
+    String &operator+=(const char *other)
+    {
+        _s += other;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        _s += c;
+        return *this;
+    }
+    String &operator+=(int v) { return *this += String(v); }
+    String &operator+=(unsigned int v) { return *this += String(v); }
+    String &operator+=(long v) { return *this += String(v); }
+    String &operator+=(unsigned long v) { return *this += String(v); }
+
+    bool operator==(const String &other) const { return _s == other._s; }
+    bool operator==(const char *other) const { return _s == other; }
+    bool operator!=(const String &other) const { return _s != other._s; }
+    bool operator!=(const char *other) const { return _s != other; }
+    bool operator<(const String &other) const { return _s < other._s; }
+    explicit operator bool(void) const { return true; }
+
+    friend String operator+(const String &a, const String &b) { return String(a._s + b._s); }
+    friend String operator+(const String &a, const char *b) { return String(a._s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b._s); }
+    friend String operator+(const String &a, char b) { return String(a._s + b); }
+
+  private:
+    static int _pos(size_t pos) { return (pos == std::string::npos) ? -1 : (int)pos; }
+
+    std::string _s;
+};
+
+class Print
+{
+  public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t size)
+    {
+        size_t done = 0;
+
+        while (size--)
+            done += write(*buf++);
+        return done;
+    }
+    size_t write(const char *text) { return (text) ? write((const uint8_t *)text, strlen(text)) : 0; }
+    size_t write(const char *buf, size_t size) { return write((const uint8_t *)buf, size); }
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(const String &text) { return write(text.c_str(), text.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return print(String(v)); }
+    size_t print(unsigned int v) { return print(String(v)); }
+    size_t print(long v) { return print(String(v)); }
+    size_t print(unsigned long v) { return print(String(v)); }
+    size_t println(const char *text = "") { return print(text) + write("\r\n"); }
+    size_t println(const String &text) { return print(text) + write("\r\n"); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buf[512];
+        va_list args;
+
+        va_start(args, format);
+        int len = vsnprintf(buf, sizeof(buf), format, args);
+        va_end(args);
+
+        if (len < 0)
+            return 0;
+        return write((const uint8_t *)buf, std::min((size_t)len, sizeof(buf) - 1));
+    }
+
+    virtual void flush(void) {}
+};
+
+class Stream : public Print
+{
+  public:
+    virtual int available(void) = 0;
+    virtual int read(void) = 0;
+    virtual int peek(void) = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+
+    virtual size_t readBytes(char *buf, size_t size)
+    {
+        size_t done = 0;
+
+        while (done < size)
+        {
+            int c = _timedRead();
+
+            if (c < 0)
+                break;
+            buf[done++] = (char)c;
+        }
+        return done;
+    }
+    size_t readBytes(uint8_t *buf, size_t size) { return readBytes((char *)buf, size); }
+
+    String readStringUntil(char terminator)
+    {
+        String text;
+        int c;
+
+        while ((c = _timedRead()) >= 0 && c != terminator)
+            text += (char)c;
+        return text;
+    }
+
+  protected:
+    int _timedRead(void)
+    {
+        unsigned long start = millis();
+
+        do
+        {
+            int c = read();
+
+            if (c >= 0)
+                return c;
+            yield();
+        } while (millis() - start < _timeout);
+        return -1;
+    }
+
+    unsigned long _timeout = 1000;
+};
+
+#endif // _IOT_HOST_ARDUINO_H
+
+/******************************************************************************/
@@ -0,0 +1,35 @@
+/*
+** EasyIOT - (Host) mDNS Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_ESPMDNS_H
+#define _IOT_HOST_ESPMDNS_H
+
+#include <Arduino.h>
+
+class MDNSResponder
+{
+  public:
+    bool begin(const char *hostname) { return (void)hostname, true; }
+    void addService(const char *service, const char *proto, uint16_t port)
+    {
+        (void)service;
+        (void)proto;
+        (void)port;
+    }
+};
+
+extern MDNSResponder MDNS;
+
+#endif // _IOT_HOST_ESPMDNS_H
+
+/******************************************************************************/
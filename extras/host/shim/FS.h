@@ -0,0 +1,112 @@
+/*
+** EasyIOT - (Host) Filesystem Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_FS_H
+#define _IOT_HOST_FS_H
+
+#include <Arduino.h>
+#include <dirent.h>
+
+/*
+** A directory of the host stands in for the flash filesystem, paths are
+** taken below the root the FS was created with
+*/
+namespace fs
+{
+
+enum SeekMode
+{
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+class File : public Stream
+{
+  public:
+    File() {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) override { return (_file()) ? fwrite(buf, 1, size, _file()) : 0; }
+    using Print::write;
+
+    int available(void) override { return (_file()) ? (int)(size() - position()) : 0; }
+    int read(void) override { return (_file()) ? fgetc(_file()) : -1; }
+    size_t read(uint8_t *buf, size_t size) { return (_file()) ? fread(buf, 1, size, _file()) : 0; }
+    int peek(void) override;
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) { return _file() && fseek(_file(), pos, (int)mode) == 0; }
+    size_t position(void) const { return (_file()) ? ftell(_file()) : 0; }
+    size_t size(void) const;
+    time_t getLastWrite(void) const;
+
+    const char *name(void) const { return (_handle) ? _handle->path.c_str() : ""; }
+    bool isDirectory(void) const { return _handle && _handle->dir; }
+    File openNextFile(const char *mode = "r");
+    // As the ESP32 core, closing closes every copy of the file
+    void close(void)
+    {
+        if (_handle)
+            _handle->close();
+        _handle.reset();
+    }
+    operator bool(void) const { return _handle && (_handle->file || _handle->dir); }
+
+  private:
+    friend class FS;
+
+    struct Handle
+    {
+        ~Handle() { close(); }
+        void close(void);
+        std::string root;
+        std::string path;
+        FILE *file = nullptr;
+        DIR *dir = nullptr;
+    };
+
+    File(std::shared_ptr<Handle> handle) : _handle(handle) {}
+    FILE *_file(void) const { return (_handle) ? _handle->file : nullptr; }
+
+    std::shared_ptr<Handle> _handle;
+};
+
+class FS
+{
+  public:
+    FS(const char *root) : _root(root) {}
+
+    File open(const char *path, const char *mode = "r");
+    File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+
+    static unsigned long opened; // files and directories opened, for the checks
+
+  private:
+    std::string _root;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
+
+#endif // _IOT_HOST_FS_H
+
+/******************************************************************************/
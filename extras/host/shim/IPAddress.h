@@ -0,0 +1,43 @@
+/*
+** EasyIOT - (Host) IP Address Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_IPADDRESS_H
+#define _IOT_HOST_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress
+{
+  public:
+    IPAddress() : _addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _addr(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+    IPAddress(uint32_t addr) : _addr(addr) {}
+
+    operator uint32_t() const { return _addr; }
+    uint8_t operator[](int i) const { return (_addr >> (i * 8)) & 0xFF; }
+
+    String toString(void) const
+    {
+        char text[16];
+
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+        return String(text);
+    }
+
+  private:
+    uint32_t _addr; // network order, as lwIP keeps it
+};
+
+#endif // _IOT_HOST_IPADDRESS_H
+
+/******************************************************************************/
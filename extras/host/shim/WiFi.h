@@ -0,0 +1,32 @@
+/*
+** EasyIOT - (Host) WiFi Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_WIFI_H
+#define _IOT_HOST_WIFI_H
+
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+#include "WiFiUdp.h"
+
+class WiFiClass
+{
+  public:
+    IPAddress localIP(void) { return IPAddress(127, 0, 0, 1); }
+};
+
+extern WiFiClass WiFi;
+
+#endif // _IOT_HOST_WIFI_H
+
+/******************************************************************************/
@@ -0,0 +1,73 @@
+/*
+** EasyIOT - (Host) WiFi Client Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_WIFICLIENT_H
+#define _IOT_HOST_WIFICLIENT_H
+
+#include <Arduino.h>
+#include "IPAddress.h"
+
+/*
+** A POSIX socket behind the Arduino client interface.  Copies share the
+** descriptor, which is closed with the last of them as on the ESP32.
+** Reads never block, writes wait for the socket to drain as lwIP does.
+*/
+class WiFiClient : public Stream
+{
+  public:
+    WiFiClient() : _connected(false) {}
+    WiFiClient(int fd) : _socket(std::make_shared<Socket>(fd)), _connected(true) {}
+
+    int connect(IPAddress ip, uint16_t port);
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+
+    int available(void) override;
+    int read(void) override;
+    int read(uint8_t *buf, size_t size);
+    int peek(void) override;
+    size_t readBytes(char *buf, size_t size) override;
+    using Stream::readBytes;
+
+    void flush(void) override {}
+    void stop(void)
+    {
+        _socket.reset();
+        _connected = false;
+    }
+    uint8_t connected(void);
+
+    operator bool(void) const { return _socket != nullptr; }
+    bool operator==(const WiFiClient &other) const { return _socket == other._socket; }
+
+    IPAddress remoteIP(void) const;
+    uint16_t remotePort(void) const;
+    int setNoDelay(bool noDelay);
+    int fd(void) const { return (_socket) ? _socket->fd : -1; }
+
+  private:
+    struct Socket
+    {
+        Socket(int f) : fd(f) {}
+        ~Socket();
+        int fd;
+    };
+
+    std::shared_ptr<Socket> _socket;
+    bool _connected;
+};
+
+#endif // _IOT_HOST_WIFICLIENT_H
+
+/******************************************************************************/
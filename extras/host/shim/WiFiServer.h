@@ -0,0 +1,42 @@
+/*
+** EasyIOT - (Host) WiFi Server Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_WIFISERVER_H
+#define _IOT_HOST_WIFISERVER_H
+
+#include "WiFiClient.h"
+
+/*
+** Listens on the loopback interface only, the shim is for measurement
+*/
+class WiFiServer
+{
+  public:
+    WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : _port(port), _fd(-1) { (void)maxClients; }
+
+    void begin(uint16_t port = 0);
+    WiFiClient available(void);
+    void stop(void);
+    void close(void) { stop(); }
+    void end(void) { stop(); }
+    void setNoDelay(bool noDelay) { (void)noDelay; }
+    operator bool(void) const { return _fd >= 0; }
+
+  private:
+    uint16_t _port;
+    int _fd;
+};
+
+#endif // _IOT_HOST_WIFISERVER_H
+
+/******************************************************************************/
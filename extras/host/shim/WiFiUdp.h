@@ -0,0 +1,37 @@
+/*
+** EasyIOT - (Host) WiFi UDP Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_WIFIUDP_H
+#define _IOT_HOST_WIFIUDP_H
+
+#include "IPAddress.h"
+
+/*
+** Declared by the server header only, nothing is sent
+*/
+class WiFiUDP : public Stream
+{
+  public:
+    uint8_t begin(uint16_t port) { return (void)port, 0; }
+    void stop(void) {}
+    size_t write(uint8_t c) override { return (void)c, 0; }
+    using Print::write;
+    int parsePacket(void) { return 0; }
+    int available(void) override { return 0; }
+    int read(void) override { return -1; }
+    int peek(void) override { return -1; }
+};
+
+#endif // _IOT_HOST_WIFIUDP_H
+
+/******************************************************************************/
@@ -0,0 +1,55 @@
+/*
+** EasyIOT - (Host) Logging Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_ESP_LOG_H
+#define _IOT_HOST_ESP_LOG_H
+
+#include <cstdio>
+
+typedef enum
+{
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+/*
+** One level for every tag, set from the command line of the host program
+*/
+extern esp_log_level_t host_log_level;
+
+inline void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void)tag;
+    host_log_level = level;
+}
+
+#define HOST_LOG(level, letter, tag, format, ...)                                  \
+    do                                                                             \
+    {                                                                              \
+        if (host_log_level >= level)                                               \
+            fprintf(stderr, letter " (%s) " format "\n", tag, ##__VA_ARGS__);      \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+#endif // _IOT_HOST_ESP_LOG_H
+
+/******************************************************************************/
@@ -0,0 +1,65 @@
+/*
+** EasyIOT - (Host) FreeRTOS Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_FREERTOS_H
+#define _IOT_HOST_FREERTOS_H
+
+/*
+** Tasks are threads, semaphores and queues are built on a mutex and a
+** condition variable.  A tick is one millisecond.
+*/
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFF)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+// Critical sections are a mutex, there are no interrupts to mask
+typedef struct
+{
+    std::mutex lock;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) (mux)->lock.lock()
+#define portEXIT_CRITICAL(mux) (mux)->lock.unlock()
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux) portEXIT_CRITICAL(mux)
+
+// Wait on a condition for up to the ticks given, for ever at portMAX_DELAY
+template <typename Predicate>
+inline bool hostWait(std::unique_lock<std::mutex> &lock, std::condition_variable &cv, TickType_t ticks, Predicate ready)
+{
+    if (ticks == portMAX_DELAY)
+    {
+        cv.wait(lock, ready);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+#endif // _IOT_HOST_FREERTOS_H
+
+/******************************************************************************/
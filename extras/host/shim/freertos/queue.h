@@ -0,0 +1,69 @@
+/*
+** EasyIOT - (Host) FreeRTOS Queue Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_FREERTOS_QUEUE_H
+#define _IOT_HOST_FREERTOS_QUEUE_H
+
+#include "FreeRTOS.h"
+#include <cstring>
+#include <deque>
+#include <vector>
+
+struct HostQueue
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+typedef HostQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    QueueHandle_t queue = new HostQueue();
+
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+inline void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+
+    if (!hostWait(lock, queue->cv, ticks, [queue] { return queue->items.size() < queue->length; }))
+        return pdFALSE;
+    queue->items.emplace_back((const uint8_t *)item, (const uint8_t *)item + queue->itemSize);
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(queue->lock);
+
+    if (!hostWait(lock, queue->cv, ticks, [queue] { return !queue->items.empty(); }))
+        return pdFALSE;
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->cv.notify_all();
+    return pdTRUE;
+}
+
+#endif // _IOT_HOST_FREERTOS_QUEUE_H
+
+/******************************************************************************/
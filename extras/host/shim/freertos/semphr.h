@@ -0,0 +1,83 @@
+/*
+** EasyIOT - (Host) FreeRTOS Semaphore Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_FREERTOS_SEMPHR_H
+#define _IOT_HOST_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+#include <thread>
+
+/*
+** One type serves as binary semaphore and recursive mutex, as the handle
+** does in FreeRTOS
+*/
+struct HostSemaphore
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    int count = 0;
+    std::thread::id owner;
+    int depth = 0;
+};
+
+typedef HostSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary(void) { return new HostSemaphore(); }
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) { return new HostSemaphore(); }
+inline void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    std::unique_lock<std::mutex> lock(sem->lock);
+
+    if (!hostWait(lock, sem->cv, ticks, [sem] { return sem->count > 0; }))
+        return pdFALSE;
+    sem->count = 0;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(sem->lock);
+
+    sem->count = 1;
+    sem->cv.notify_one();
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    std::thread::id self = std::this_thread::get_id();
+    std::unique_lock<std::mutex> lock(sem->lock);
+
+    if (!hostWait(lock, sem->cv, ticks, [sem, self] { return !sem->depth || sem->owner == self; }))
+        return pdFALSE;
+    sem->owner = self;
+    sem->depth++;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(sem->lock);
+
+    if (!sem->depth || sem->owner != std::this_thread::get_id())
+        return pdFALSE;
+    if (!--sem->depth)
+        sem->cv.notify_one();
+    return pdTRUE;
+}
+
+#endif // _IOT_HOST_FREERTOS_SEMPHR_H
+
+/******************************************************************************/
@@ -0,0 +1,30 @@
+/*
+** EasyIOT - (Host) FreeRTOS Task Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_FREERTOS_TASK_H
+#define _IOT_HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct HostTask *TaskHandle_t;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+void vTaskDelay(TickType_t ticks);
+
+#endif // _IOT_HOST_FREERTOS_TASK_H
+
+/******************************************************************************/
@@ -0,0 +1,23 @@
+/*
+** EasyIOT - (Host) Base64 Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_CENCODE_H
+#define _IOT_HOST_CENCODE_H
+
+#define base64_encode_expected_len(n) ((((4 * (n)) / 3) + 3) & ~3)
+
+int base64_encode_chars(const char *plaintext_in, int length_in, char *code_out);
+
+#endif // _IOT_HOST_CENCODE_H
+
+/******************************************************************************/
@@ -0,0 +1,23 @@
+/*
+** EasyIOT - (Host) SHA1 Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HOST_MBEDTLS_SHA1_H
+#define _IOT_HOST_MBEDTLS_SHA1_H
+
+#include <cstddef>
+
+int mbedtls_sha1_ret(const unsigned char *input, size_t ilen, unsigned char output[20]);
+
+#endif // _IOT_HOST_MBEDTLS_SHA1_H
+
+/******************************************************************************/
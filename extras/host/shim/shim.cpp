@@ -0,0 +1,496 @@
+/*
+** EasyIOT - (Host) Platform Shim
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include <Arduino.h>
+#include <WiFi.h>
+#include <FS.h>
+#include <ESPmDNS.h>
+#include <esp_log.h>
+#include <libb64/cencode.h>
+#include <mbedtls/sha1.h>
+#include <freertos/task.h>
+#include <thread>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+
+#define HOST_SEND_WAIT 5000 //ms a write waits for the socket to drain, as lwIP's send timeout
+
+esp_log_level_t host_log_level = ESP_LOG_ERROR;
+
+// lwIP reports a reset peer through errno alone
+static const auto _ignorePipe = signal(SIGPIPE, SIG_IGN);
+
+WiFiClass WiFi;
+MDNSResponder MDNS;
+
+/*
+** Time
+*/
+static const auto _epoch = std::chrono::steady_clock::now();
+
+unsigned long millis(void)
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+unsigned long micros(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+void yield(void) { std::this_thread::yield(); }
+
+/*
+** Tasks
+*/
+static thread_local TaskHandle_t _currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    (void)name;
+    (void)stack;
+    (void)priority;
+    (void)core;
+
+    // Only the address is used, it names the task
+    TaskHandle_t task = (TaskHandle_t) new char;
+
+    if (handle)
+        *handle = task;
+
+    std::thread([fn, arg, task] {
+        _currentTask = task;
+        fn(arg);
+        delete (char *)task;
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) { (void)task; }
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return _currentTask; }
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+/*
+** Encoders
+*/
+int base64_encode_chars(const char *plaintext_in, int length_in, char *code_out)
+{
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    const uint8_t *in = (const uint8_t *)plaintext_in;
+    int out = 0;
+
+    for (int i = 0; i < length_in; i += 3)
+    {
+        uint32_t v = in[i] << 16;
+
+        if (i + 1 < length_in)
+            v |= in[i + 1] << 8;
+        if (i + 2 < length_in)
+            v |= in[i + 2];
+
+        code_out[out++] = table[(v >> 18) & 63];
+        code_out[out++] = table[(v >> 12) & 63];
+        code_out[out++] = (i + 1 < length_in) ? table[(v >> 6) & 63] : '=';
+        code_out[out++] = (i + 2 < length_in) ? table[v & 63] : '=';
+    }
+    code_out[out] = '\0';
+    return out;
+}
+
+static inline uint32_t _rol(uint32_t v, int bits) { return (v << bits) | (v >> (32 - bits)); }
+
+static void _sha1Block(uint32_t h[5], const uint8_t *block)
+{
+    uint32_t w[80];
+
+    for (int i = 0; i < 16; i++)
+        w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = _rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+
+        if (i < 20)
+            f = (b & c) | (~b & d), k = 0x5A827999;
+        else if (i < 40)
+            f = b ^ c ^ d, k = 0x6ED9EBA1;
+        else if (i < 60)
+            f = (b & c) | (b & d) | (c & d), k = 0x8F1BBCDC;
+        else
+            f = b ^ c ^ d, k = 0xCA62C1D6;
+
+        uint32_t t = _rol(a, 5) + f + e + k + w[i];
+
+        e = d;
+        d = c;
+        c = _rol(b, 30);
+        b = a;
+        a = t;
+    }
+
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+int mbedtls_sha1_ret(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block[64];
+    size_t done = 0;
+
+    for (; ilen - done >= 64; done += 64)
+        _sha1Block(h, input + done);
+
+    size_t tail = ilen - done;
+    uint64_t bits = (uint64_t)ilen * 8;
+
+    memcpy(block, input + done, tail);
+    block[tail++] = 0x80;
+    if (tail > 56)
+    {
+        memset(block + tail, 0, 64 - tail);
+        _sha1Block(h, block);
+        tail = 0;
+    }
+    memset(block + tail, 0, 56 - tail);
+    for (int i = 0; i < 8; i++)
+        block[56 + i] = bits >> (56 - i * 8);
+    _sha1Block(h, block);
+
+    for (int i = 0; i < 20; i++)
+        output[i] = h[i / 4] >> (24 - (i % 4) * 8);
+    return 0;
+}
+
+/*
+** Sockets
+*/
+WiFiClient::Socket::~Socket()
+{
+    if (fd >= 0)
+        ::close(fd);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = (uint32_t)ip;
+
+    if (fd < 0 || ::connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        return 0;
+    }
+
+    _socket = std::make_shared<Socket>(fd);
+    _connected = true;
+    return 1;
+}
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size)
+{
+    size_t sent = 0;
+    unsigned long start = millis();
+
+    while (_socket && sent < size)
+    {
+        ssize_t len = ::send(fd(), buf + sent, size - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+
+        if (len > 0)
+        {
+            sent += len;
+            continue;
+        }
+
+        if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && millis() - start < HOST_SEND_WAIT)
+        {
+            pollfd wait = {fd(), POLLOUT, 0};
+
+            poll(&wait, 1, 10);
+            continue;
+        }
+
+        _connected = false;
+        break;
+    }
+    return sent;
+}
+
+int WiFiClient::available(void)
+{
+    int len = 0;
+
+    if (!_socket || ioctl(fd(), FIONREAD, &len) < 0)
+        return 0;
+    return len;
+}
+
+int WiFiClient::read(void)
+{
+    uint8_t c;
+
+    return (read(&c, 1) == 1) ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size)
+{
+    if (!_socket)
+        return -1;
+
+    ssize_t len = ::recv(fd(), buf, size, MSG_DONTWAIT);
+
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        _connected = false;
+    return (len > 0) ? (int)len : -1;
+}
+
+int WiFiClient::peek(void)
+{
+    uint8_t c;
+
+    if (!_socket)
+        return -1;
+    return (::recv(fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT) == 1) ? c : -1;
+}
+
+size_t WiFiClient::readBytes(char *buf, size_t size)
+{
+    size_t done = 0;
+    unsigned long start = millis();
+
+    while (done < size && millis() - start < _timeout)
+    {
+        int len = read((uint8_t *)buf + done, size - done);
+
+        if (len > 0)
+            done += len;
+        else if (!connected())
+            break;
+        else
+        {
+            pollfd wait = {fd(), POLLIN, 0};
+
+            poll(&wait, 1, 10);
+        }
+    }
+    return done;
+}
+
+uint8_t WiFiClient::connected(void)
+{
+    char c;
+
+    if (!_socket || !_connected)
+        return 0;
+
+    ssize_t len = ::recv(fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    // Data still unread keeps a closed connection readable, as lwIP does
+    if (len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+        _connected = false;
+    return _connected;
+}
+
+IPAddress WiFiClient::remoteIP(void) const
+{
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+
+    getpeername(fd(), (sockaddr *)&addr, &len);
+    return IPAddress((uint32_t)addr.sin_addr.s_addr);
+}
+
+uint16_t WiFiClient::remotePort(void) const
+{
+    sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+
+    getpeername(fd(), (sockaddr *)&addr, &len);
+    return ntohs(addr.sin_port);
+}
+
+int WiFiClient::setNoDelay(bool noDelay)
+{
+    int on = noDelay;
+
+    return setsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+void WiFiServer::begin(uint16_t port)
+{
+    sockaddr_in addr = {};
+    int on = 1;
+
+    if (port)
+        _port = port;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    _fd = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    if (bind(_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(_fd, 64) != 0)
+    {
+        ESP_LOGE("HOST", "Unable to listen on port %u: %s", _port, strerror(errno));
+        stop();
+        return;
+    }
+    fcntl(_fd, F_SETFL, O_NONBLOCK);
+}
+
+WiFiClient WiFiServer::available(void)
+{
+    int fd = (_fd >= 0) ? accept(_fd, nullptr, nullptr) : -1;
+    int on = 1;
+
+    if (fd < 0)
+        return WiFiClient();
+
+    // lwIP sends small segments straight away as well
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return WiFiClient(fd);
+}
+
+void WiFiServer::stop(void)
+{
+    if (_fd >= 0)
+        ::close(_fd);
+    _fd = -1;
+}
+
+/*
+** Files
+*/
+namespace fs
+{
+
+void File::Handle::close(void)
+{
+    if (file)
+        fclose(file);
+    if (dir)
+        closedir(dir);
+    file = nullptr;
+    dir = nullptr;
+}
+
+int File::peek(void)
+{
+    int c = read();
+
+    if (c >= 0)
+        ungetc(c, _file());
+    return c;
+}
+
+size_t File::size(void) const
+{
+    struct stat st;
+
+    if (!_file() || fstat(fileno(_file()), &st) != 0)
+        return 0;
+    return st.st_size;
+}
+
+time_t File::getLastWrite(void) const
+{
+    struct stat st;
+    std::string full = (_handle) ? _handle->root + _handle->path : std::string();
+
+    if (!_handle || stat(full.c_str(), &st) != 0)
+        return 0;
+    return st.st_mtime;
+}
+
+File File::openNextFile(const char *mode)
+{
+    struct dirent *entry;
+
+    if (!_handle || !_handle->dir)
+        return File();
+
+    while ((entry = readdir(_handle->dir)))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+
+        std::string path = _handle->path;
+
+        if (path.empty() || path.back() != '/')
+            path += '/';
+        path += entry->d_name;
+        return FS(_handle->root.c_str()).open(path.c_str(), mode);
+    }
+    return File();
+}
+
+unsigned long FS::opened = 0;
+
+File FS::open(const char *path, const char *mode)
+{
+    auto handle = std::make_shared<File::Handle>();
+    std::string full = _root + path;
+    struct stat st;
+
+    opened++;
+    handle->root = _root;
+    handle->path = path;
+
+    if (stat(full.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+        handle->dir = opendir(full.c_str());
+    else
+        handle->file = fopen(full.c_str(), (mode[0] == 'w') ? "wb" : (mode[0] == 'a') ? "ab" : "rb");
+
+    return (handle->file || handle->dir) ? File(handle) : File();
+}
+
+bool FS::exists(const char *path)
+{
+    struct stat st;
+
+    return stat((_root + path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+    return ::remove((_root + path).c_str()) == 0;
+}
+
+} // namespace fs
+
+/******************************************************************************/
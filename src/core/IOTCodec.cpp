@@ -0,0 +1,353 @@
+/*
+** EasyIOT - Property Value Codec
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "IOTCodec.h"
+#include <errno.h>
+
+/*
+** Words a boolean is read from, as properties write them and more
+*/
+static constexpr struct
+{
+    const char *word;
+    bool value;
+} _boolWords[] = {
+    {"true", true}, {"false", false}, {"on", true}, {"off", false},
+    {"high", true}, {"low", false}, {"yes", true}, {"no", false},
+};
+
+/*
+** Text
+*/
+size_t IOTCodec::toChars(char *buf, size_t max, int64_t value)
+{
+    uint64_t magnitude = (value < 0) ? 0 - (uint64_t)value : value;
+
+    if (value >= 0)
+        return toChars(buf, max, magnitude);
+
+    if (max < 2)
+        return toChars(buf, max, "", 0);
+
+    buf[0] = '-';
+    return 1 + toChars(&buf[1], max - 1, magnitude);
+}
+
+size_t IOTCodec::toChars(char *buf, size_t max, uint64_t value)
+{
+    char text[24];
+    char *at = &text[sizeof(text)];
+
+    do
+    {
+        *--at = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    return toChars(buf, max, at, &text[sizeof(text)] - at);
+}
+
+// Places fixed as asked, otherwise the fewest digits that read back the same
+size_t IOTCodec::toChars(char *buf, size_t max, double value, int8_t places)
+{
+    char text[IOT_CODEC_NUMBER + 8];
+    int len;
+
+    if (places >= 0)
+        len = snprintf(text, sizeof(text), "%.*f", places, value);
+    else
+    {
+        for (int digits = 15; digits <= 17; digits++)
+        {
+            len = snprintf(text, sizeof(text), "%.*g", digits, value);
+            if (strtod(text, NULL) == value || value != value)
+                break;
+        }
+    }
+
+    if (len < 0)
+        len = 0;
+    return toChars(buf, max, text, std::min((size_t)len, sizeof(text) - 1));
+}
+
+size_t IOTCodec::toChars(char *buf, size_t max, const char *text, size_t len)
+{
+    if (!max)
+        return 0;
+    if (len > max - 1)
+        len = max - 1;
+
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+    return len;
+}
+
+/*
+** Parsers, spaces either side are allowed and nothing else
+*/
+static bool _number(const char *text, size_t len, char *buf)
+{
+    while (len && isspace((unsigned char)*text))
+        text++, len--;
+    while (len && isspace((unsigned char)text[len - 1]))
+        len--;
+
+    if (!len || len >= IOT_CODEC_NUMBER)
+        return false;
+
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+    return true;
+}
+
+bool IOTCodec::fromChars(const char *text, size_t len, int64_t &value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    char *end;
+
+    if (!_number(text, len, buf))
+        return false;
+
+    errno = 0;
+    long long whole = strtoll(buf, &end, 10);
+
+    if (*end == '\0' && end != buf && errno == 0)
+    {
+        value = whole;
+        return true;
+    }
+
+    // A fraction or exponent is taken towards zero
+    double real;
+
+    if (!fromChars(buf, strlen(buf), real) || !(real > -9.2e18 && real < 9.2e18))
+        return false;
+
+    value = (int64_t)real;
+    return true;
+}
+
+bool IOTCodec::fromChars(const char *text, size_t len, double &value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    char *end;
+
+    if (!_number(text, len, buf))
+        return false;
+
+    double real = strtod(buf, &end);
+
+    if (*end != '\0' || end == buf)
+        return false;
+
+    value = real;
+    return true;
+}
+
+bool IOTCodec::fromChars(const char *text, size_t len, bool &value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    double real;
+
+    if (!_number(text, len, buf))
+        return false;
+
+    for (const auto &word : _boolWords)
+    {
+        if (strcasecmp(buf, word.word) == 0)
+        {
+            value = word.value;
+            return true;
+        }
+    }
+
+    if (!fromChars(buf, strlen(buf), real))
+        return false;
+
+    value = real != 0;
+    return true;
+}
+
+/*
+** Binary, nothing is written unless the whole value fits
+*/
+size_t IOTCodec::encode(uint8_t *buf, size_t max, bool value)
+{
+    if (max < 1)
+        return 0;
+
+    buf[0] = (value) ? IOT_CODEC_TRUE : IOT_CODEC_FALSE;
+    return 1;
+}
+
+size_t IOTCodec::encode(uint8_t *buf, size_t max, int64_t value)
+{
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t len;
+
+    if (max < 2 || !(len = putVarint(&buf[1], max - 1, zigzag)))
+        return 0;
+
+    buf[0] = IOT_CODEC_SINT;
+    return 1 + len;
+}
+
+size_t IOTCodec::encode(uint8_t *buf, size_t max, uint64_t value)
+{
+    size_t len;
+
+    if (max < 2 || !(len = putVarint(&buf[1], max - 1, value)))
+        return 0;
+
+    buf[0] = IOT_CODEC_UINT;
+    return 1 + len;
+}
+
+size_t IOTCodec::encode(uint8_t *buf, size_t max, float value)
+{
+    uint32_t bits;
+
+    if (max < 5)
+        return 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    buf[0] = IOT_CODEC_FLOAT;
+    for (int b = 0; b < 4; b++)
+        buf[1 + b] = (uint8_t)(bits >> (8 * b));
+    return 5;
+}
+
+size_t IOTCodec::encode(uint8_t *buf, size_t max, double value)
+{
+    uint64_t bits;
+
+    if (max < 9)
+        return 0;
+
+    memcpy(&bits, &value, sizeof(bits));
+    buf[0] = IOT_CODEC_DOUBLE;
+    for (int b = 0; b < 8; b++)
+        buf[1 + b] = (uint8_t)(bits >> (8 * b));
+    return 9;
+}
+
+size_t IOTCodec::encode(uint8_t *buf, size_t max, const char *text, size_t len)
+{
+    size_t head;
+
+    if (max < 2 || !(head = putVarint(&buf[1], max - 1, len)) || 1 + head + len > max)
+        return 0;
+
+    buf[0] = IOT_CODEC_TEXT;
+    memcpy(&buf[1 + head], text, len);
+    return 1 + head + len;
+}
+
+// Bytes taken, zero if the value is cut short or of an unknown kind
+size_t IOTCodec::decode(const uint8_t *buf, size_t len, IOTCodecValue &value)
+{
+    size_t used;
+    uint64_t bits = 0;
+
+    if (len < 1)
+        return 0;
+
+    value.tag = buf[0];
+    value.uint = 0;
+    value.text = nullptr;
+    value.len = 0;
+
+    switch (value.tag)
+    {
+    case IOT_CODEC_FALSE:
+    case IOT_CODEC_TRUE:
+        value.uint = value.tag == IOT_CODEC_TRUE;
+        return 1;
+
+    case IOT_CODEC_SINT:
+        if (!(used = getVarint(&buf[1], len - 1, bits)))
+            return 0;
+        value.sint = (int64_t)(bits >> 1) ^ -(int64_t)(bits & 1);
+        return 1 + used;
+
+    case IOT_CODEC_UINT:
+        if (!(used = getVarint(&buf[1], len - 1, value.uint)))
+            return 0;
+        return 1 + used;
+
+    case IOT_CODEC_FLOAT:
+    {
+        float single;
+        uint32_t word = 0;
+
+        if (len < 5)
+            return 0;
+        for (int b = 0; b < 4; b++)
+            word |= (uint32_t)buf[1 + b] << (8 * b);
+        memcpy(&single, &word, sizeof(single));
+        value.real = single;
+        return 5;
+    }
+
+    case IOT_CODEC_DOUBLE:
+        if (len < 9)
+            return 0;
+        for (int b = 0; b < 8; b++)
+            bits |= (uint64_t)buf[1 + b] << (8 * b);
+        memcpy(&value.real, &bits, sizeof(bits));
+        return 9;
+
+    case IOT_CODEC_TEXT:
+        if (!(used = getVarint(&buf[1], len - 1, bits)) || bits > len - 1 - used)
+            return 0;
+        value.text = (const char *)&buf[1 + used];
+        value.len = bits;
+        return 1 + used + bits;
+    }
+    return 0;
+}
+
+/*
+** Varints, seven bits a byte, least significant first
+*/
+size_t IOTCodec::putVarint(uint8_t *buf, size_t max, uint64_t value)
+{
+    size_t len = 0;
+
+    do
+    {
+        if (len == max)
+            return 0;
+
+        uint8_t byte = value & 0x7F;
+
+        value >>= 7;
+        buf[len++] = (value) ? byte | 0x80 : byte;
+    } while (value);
+    return len;
+}
+
+size_t IOTCodec::getVarint(const uint8_t *buf, size_t len, uint64_t &value)
+{
+    value = 0;
+
+    for (size_t b = 0; b < len && b < IOT_CODEC_VARINT; b++)
+    {
+        value |= (uint64_t)(buf[b] & 0x7F) << (7 * b);
+        if (!(buf[b] & 0x80))
+            return b + 1;
+    }
+    return 0;
+}
+
+/******************************************************************************/
@@ -0,0 +1,91 @@
+/*
+** EasyIOT - Property Value Codec
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_CODEC_H
+#define _IOT_CODEC_H
+
+#include <Arduino.h>
+#include <inttypes.h>
+
+/*
+** Equates and Defintions
+*/
+#define IOT_CODEC_NUMBER 32 // longest number parsed or written as text, "-1.7976931348623157e+308"
+#define IOT_CODEC_VARINT 10 // longest varint, a 64 bit value
+
+/*
+** Binary Tags, the first byte of every encoded value
+*/
+#define IOT_CODEC_NONE 0x00
+#define IOT_CODEC_FALSE 0x01  // the tag alone
+#define IOT_CODEC_TRUE 0x02   // the tag alone
+#define IOT_CODEC_SINT 0x03   // zigzag varint, a small magnitude either side of zero is one byte
+#define IOT_CODEC_UINT 0x04   // varint
+#define IOT_CODEC_FLOAT 0x05  // IEEE 754 single, little endian
+#define IOT_CODEC_DOUBLE 0x06 // IEEE 754 double, little endian
+#define IOT_CODEC_TEXT 0x07   // varint length, then the bytes
+
+/*
+** A decoded value, text points into the buffer it came from
+*/
+typedef struct
+{
+  uint8_t tag;
+  union {
+    int64_t sint;
+    uint64_t uint;
+    double real;
+  };
+  const char *text;
+  size_t len;
+} IOTCodecValue;
+
+/*
+** Value Codec Class
+**
+** Turns property values into text in a caller's buffer and back, and to
+** and from a compact binary form for wire protocols, without a String or
+** the heap.  Text is always terminated and cut to fit; the length written
+** is returned.  Doubles are written with the fewest digits that read back
+** to the same value.  Parsers take a length, so a value can be read in
+** place from a request, and refuse text that is not wholly a number.
+**
+** Each binary value opens with a tag naming its encoding, so a reader needs
+** no schema, and a property takes whichever encoding it is sent.
+*/
+class IOTCodec
+{
+public:
+  static size_t toChars(char *buf, size_t max, int64_t value);
+  static size_t toChars(char *buf, size_t max, uint64_t value);
+  static size_t toChars(char *buf, size_t max, double value, int8_t places = -1);
+  static size_t toChars(char *buf, size_t max, const char *text, size_t len);
+
+  static bool fromChars(const char *text, size_t len, int64_t &value);
+  static bool fromChars(const char *text, size_t len, double &value);
+  static bool fromChars(const char *text, size_t len, bool &value);
+
+  static size_t encode(uint8_t *buf, size_t max, bool value);
+  static size_t encode(uint8_t *buf, size_t max, int64_t value);
+  static size_t encode(uint8_t *buf, size_t max, uint64_t value);
+  static size_t encode(uint8_t *buf, size_t max, float value);
+  static size_t encode(uint8_t *buf, size_t max, double value);
+  static size_t encode(uint8_t *buf, size_t max, const char *text, size_t len);
+  static size_t decode(const uint8_t *buf, size_t len, IOTCodecValue &value);
+
+  static size_t putVarint(uint8_t *buf, size_t max, uint64_t value);
+  static size_t getVarint(const uint8_t *buf, size_t len, uint64_t &value);
+};
+
+#endif // _IOT_CODEC_H
+/******************************************************************************/
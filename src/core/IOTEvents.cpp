@@ -0,0 +1,158 @@
+/*
+** EasyIOT - Property Change Events
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "IOTEvents.h"
+#include "IOTFunction.h"
+
+static const char *_tag = "events";
+
+static_assert((IOT_EVENT_RING & (IOT_EVENT_RING - 1)) == 0, "IOT_EVENT_RING must be a power of two");
+
+IOTEvents::IOTEvents() : _head(0), _lost(0)
+{
+    for (Slot &slot : _ring)
+        slot.stamp.store(0, std::memory_order_relaxed);
+}
+
+/*
+** Publish a change, from anywhere.  The value is snapshot before the lock
+** is taken, so the lock is held only to copy the record.
+*/
+void IOTEvents::publish(IOTFunction *function, uint8_t index, IOTProperty *property, bool urgent)
+{
+    IOTEvent event;
+
+    if (property == nullptr)
+        return;
+
+    event.function = function;
+    event.property = property;
+    event.index = index;
+    event.urgent = urgent;
+    event.flags = property->_dataFlags;
+    event.pClass = property->_dataClass;
+    event.time = property->_dataTime;
+    event.len = property->toBinary(event.value, sizeof(event.value));
+
+    portENTER_CRITICAL_SAFE(&_mux);
+
+    uint32_t seq = _head.load(std::memory_order_relaxed);
+    Slot &slot = _ring[seq & (IOT_EVENT_RING - 1)];
+
+    slot.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&slot.event, &event, sizeof(event));
+    slot.stamp.store(seq + 1, std::memory_order_release);
+    _head.store(seq + 1, std::memory_order_release);
+
+    portEXIT_CRITICAL_SAFE(&_mux);
+}
+
+/*
+** Read the next record at a cursor that passes the filter, false when
+** there are none left
+*/
+bool IOTEvents::read(Cursor &at, IOTEvent &event, const IOTEventFilter *filter)
+{
+    for (;;)
+    {
+        uint32_t head = _head.load(std::memory_order_acquire);
+
+        if (at.next == head)
+            return false;
+
+        // Lapped, go on from half a ring back rather than from the oldest,
+        // which is the next to be overwritten
+        if (head - at.next > IOT_EVENT_RING)
+        {
+            uint32_t lost = head - IOT_EVENT_RING / 2 - at.next;
+
+            at.lost += lost;
+            _lost.fetch_add(lost, std::memory_order_relaxed);
+            at.next = head - IOT_EVENT_RING / 2;
+        }
+
+        Slot &slot = _ring[at.next & (IOT_EVENT_RING - 1)];
+        uint32_t stamp = slot.stamp.load(std::memory_order_acquire);
+
+        memcpy(&event, &slot.event, sizeof(event));
+        std::atomic_thread_fence(std::memory_order_acquire);
+
+        // Being overwritten, the head has moved on by the time it is read again
+        if (stamp != at.next + 1 || slot.stamp.load(std::memory_order_relaxed) != stamp)
+            continue;
+
+        at.next++;
+        if (filter == nullptr || _match(event, *filter))
+            return true;
+    }
+}
+
+bool IOTEvents::_match(const IOTEvent &event, const IOTEventFilter &filter)
+{
+    if (filter.tag != nullptr && (event.function == nullptr || strcmp(event.function->iotTag(), filter.tag) != 0))
+        return false;
+    if (filter.flags && !(event.flags & filter.flags))
+        return false;
+    if (filter.pClass != PROPERTY_CLASS::GENERIC && event.pClass != filter.pClass)
+        return false;
+    return true;
+}
+
+/*
+** Subscribers, called from the service loop with the changes since the last
+*/
+int IOTEvents::subscribe(handler_t handler, const char *tag, uint16_t flags, PROPERTY_CLASS pClass)
+{
+    for (int id = 0; id < IOT_EVENT_SUBSCRIBERS; id++)
+    {
+        Subscriber &sub = _subscribers[id];
+
+        if (!sub.handler)
+        {
+            sub.handler = handler;
+            sub.filter = {tag, flags, pClass};
+            sub.at = cursor();
+            return id;
+        }
+    }
+
+    ESP_LOGE(_tag, "Too Many Subscribers, Handler Not Added");
+    return -1;
+}
+
+void IOTEvents::unsubscribe(int id)
+{
+    if (id >= 0 && id < IOT_EVENT_SUBSCRIBERS)
+        _subscribers[id].handler = nullptr;
+}
+
+uint32_t IOTEvents::lost(int id) const
+{
+    if (id >= 0 && id < IOT_EVENT_SUBSCRIBERS)
+        return _subscribers[id].at.lost;
+    return 0;
+}
+
+void IOTEvents::dispatch(void)
+{
+    IOTEvent event;
+
+    for (Subscriber &sub : _subscribers)
+    {
+        while (sub.handler && read(sub.at, event, &sub.filter))
+            sub.handler(event);
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,134 @@
+/*
+** EasyIOT - Property Change Events
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_EVENTS_H
+#define _IOT_EVENTS_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <functional>
+#include <freertos/FreeRTOS.h>
+#include "IOTProperty.h"
+
+/*
+** Equates and Defintions
+*/
+#ifndef IOT_EVENT_RING
+#define IOT_EVENT_RING 32 // changes held for readers, a power of two
+#endif
+
+#ifndef IOT_EVENT_VALUE
+#define IOT_EVENT_VALUE 24 // longest value snapshot, a longer value is left out
+#endif
+
+#ifndef IOT_EVENT_SUBSCRIBERS
+#define IOT_EVENT_SUBSCRIBERS 8 // handlers called from the service loop
+#endif
+
+#ifndef portENTER_CRITICAL_SAFE
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL_ISR(mux)
+#define portEXIT_CRITICAL_SAFE(mux) portEXIT_CRITICAL_ISR(mux)
+#endif
+
+/*
+** A property change, as published
+*/
+typedef struct
+{
+  IOTFunction *function;
+  IOTProperty *property;
+  uint8_t index;                  // the property's place in its function
+  bool urgent;
+  uint16_t flags;                 // the property's flags
+  PROPERTY_CLASS pClass;
+  time_t time;
+  uint8_t len;                    // snapshot length, 0 when the value was too long
+  uint8_t value[IOT_EVENT_VALUE]; // the value as it changed, see IOTCodec::decode()
+} IOTEvent;
+
+/*
+** The changes a subscriber is given, every one when left empty
+*/
+typedef struct
+{
+  const char *tag;       // of the function
+  uint16_t flags;        // any of these property flags
+  PROPERTY_CLASS pClass; // GENERIC for any class
+} IOTEventFilter;
+
+/*
+** Property Change Event Bus
+**
+** Changes are published to a ring of fixed records, each taken by every
+** reader in turn.  Publishing never waits on a reader: the oldest record
+** is overwritten, and a reader that falls behind counts what it lost and
+** carries on from the newer half of the ring.  A publisher holds a
+** spinlock for the copy of one record, so changes may come from other
+** tasks or an ISR.  Readers take no lock, a record overwritten as it is
+** read is read again.
+**
+** A subscriber's handler is called from the service loop.  A task may read
+** instead, from a cursor of its own.
+*/
+class IOTEvents
+{
+public:
+  typedef std::function<void(const IOTEvent &event)> handler_t;
+
+  typedef struct
+  {
+    uint32_t next; // sequence of the next record to read
+    uint32_t lost; // records overwritten before they were read
+  } Cursor;
+
+  IOTEvents();
+
+  void publish(IOTFunction *function, uint8_t index, IOTProperty *property, bool urgent = false);
+
+  Cursor cursor(void) const { return {_head.load(std::memory_order_acquire), 0}; }
+  bool read(Cursor &at, IOTEvent &event, const IOTEventFilter *filter = nullptr);
+
+  int subscribe(handler_t handler, const char *tag = nullptr, uint16_t flags = 0,
+                PROPERTY_CLASS pClass = PROPERTY_CLASS::GENERIC);
+  void unsubscribe(int id);
+  void dispatch(void);
+
+  uint32_t published(void) const { return _head.load(std::memory_order_relaxed); }
+  uint32_t lost(void) const { return _lost.load(std::memory_order_relaxed); }
+  uint32_t lost(int id) const;
+
+private:
+  typedef struct
+  {
+    std::atomic<uint32_t> stamp; // sequence + 1 once written, 0 while being written
+    IOTEvent event;
+  } Slot;
+
+  typedef struct
+  {
+    handler_t handler;
+    IOTEventFilter filter;
+    Cursor at;
+  } Subscriber;
+
+  bool _match(const IOTEvent &event, const IOTEventFilter &filter);
+
+  Slot _ring[IOT_EVENT_RING];
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _lost;
+  portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+  Subscriber _subscribers[IOT_EVENT_SUBSCRIBERS];
+};
+
+#endif // _IOT_EVENTS_H
+/******************************************************************************/
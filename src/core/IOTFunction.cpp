@@ -27,6 +27,7 @@ IOTProperty *IOTFunction::_nullProperty = NULL;
 */
 IOTFunction::IOTFunction(const char *tag, uint8_t numProperties)
     : _tag(tag),
+      _iotMaster(nullptr),
       _nvsHandle(0), 
       _flags(0),
       _state(IOT_STOPPED), 
@@ -51,6 +52,13 @@ IOTFunction::IOTFunction(const char *tag, uint8_t numProperties)
 */
 IOTFunction::~IOTFunction()
 {
+    // Leave the master's list and registry before the properties go
+    if (_iotMaster != nullptr && _iotMaster != this)
+    {
+        _iotMaster->listRemove(this);
+        _iotMaster = nullptr;
+    }
+
     if (_Properties != NULL)
     {
         for (int p = 0; p < _propCount; p++)
@@ -76,17 +84,35 @@ IOTHTTP *IOTFunction::Server(void) const
     return nullptr;
 }
 
+IOTEvents *IOTFunction::Events(void) const
+{
+    if (_iotMaster != nullptr)
+        return _iotMaster->Events();
+    return nullptr;
+}
+
+IOTRegistry *IOTFunction::Registry(void) const
+{
+    if (_iotMaster != nullptr)
+        return _iotMaster->Registry();
+    return nullptr;
+}
+
 /*
 ** Find function by tag
 */
 IOTFunction *IOTFunction::Function(const char * tag)
 {
     if (tag != nullptr) {
+        IOTRegistry *registry = Registry();
         IOTFunction *func = listHead();
 
         if (strcmp(tag, _tag) == 0)
             return this;
 
+        if (registry != nullptr)
+            return registry->function(tag, strlen(tag));
+
         while (func != nullptr)
         {
             if (strcmp(tag, func->_tag) == 0)
@@ -375,7 +401,17 @@ void IOTFunction::_postUpdate(IOTProperty *prop, bool urgent)
     if (!(prop->_dataFlags & IOT_FLAG_READONLY))
         _saveProperty(prop);
 
-    // TODO: Call user onChange Handler, if any
+    // Publish the change to its subscribers
+    IOTEvents *events = Events();
+
+    for (uint8_t p = 0; events != nullptr && p < _propCount; p++)
+    {
+        if (_Properties[p] == prop)
+        {
+            events->publish(this, p, prop, urgent);
+            break;
+        }
+    }
 }
 
 /*
@@ -392,6 +428,27 @@ IOTProperty *IOTFunction::Property(uint8_t p)
     return _nullProperty;
 }
 
+/*
+** Find a property by path, "tag/label" or "tag/index", NULL if none
+*/
+IOTProperty *IOTFunction::Resolve(const char *path)
+{
+    IOTRegistry *registry = Registry();
+    IOTFunction *func;
+    IOTProperty *prop;
+    uint8_t p;
+
+    if (registry == nullptr)
+        return nullptr;
+
+    if ((prop = registry->resolve(path, func, p)) != nullptr)
+        return prop;
+
+    if (func == nullptr || func->_Properties == nullptr || p >= func->_propCount)
+        return nullptr;
+    return func->_Properties[p];
+}
+
 /*
 ** Function Label
 */
@@ -17,6 +17,8 @@
 #include <Arduino.h>
 #include "esp_log.h"
 #include "IOTProperty.h"
+#include "IOTEvents.h"
+#include "IOTRegistry.h"
 #include "IOTRandom.h"
 #include "IOTHttp.h"
 
@@ -58,7 +60,10 @@ public:
   IOTFunction *Function(const char * tag);
   IOTMaster *Master(void) const { return _iotMaster; }
   IOTProperty *Property(uint8_t p = 0);
+  IOTProperty *Resolve(const char *path);
   virtual IOTHTTP *Server(void) const;
+  virtual IOTEvents *Events(void) const;
+  virtual IOTRegistry *Registry(void) const;
   
   const char *getLabel(void) const;
   void getLabel(char *);
@@ -123,19 +128,31 @@ public:
   IOTFunction& addFunction(IOTFunction &fun) { (void)addFunction(&fun); return fun; }
   void addFunction(IOTFunction *fun);
   IOTHTTP *Server(void) const;
+  IOTEvents *Events(void) const;
+  IOTRegistry *Registry(void) const;
+  void iotSocket(const char *uri = "/ws");
+  void iotApi(const char *uri = "/api");
   
 protected:
   void sysReboot(void);
   void sysReset(void);  
   bool _propUpdate(IOTProperty *prop);
+  bool _socketProperty(const char *tag, uint8_t index, const char *value, String &result);
+  IOTFunction *_apiLookup(uint8_t function);
+  const char *_apiFunction(uint8_t function, uint8_t &properties, const char *&label);
+  int _apiProperty(uint8_t function, uint8_t index, const char *value, HTTPJson *json);
   IOTFunction *listHead(void) const;
   IOTFunction *listTail(void) const;
   IOTHTTP *_webServer;
+  IOTEvents *_events;
+  IOTRegistry *_registry;
 
 private:
   char _uuid[IOT_UUID_LENGTH + 1];
   bool _needReboot;
   uint64_t _chipID;
+  void _register(IOTFunction *func);
+  void _unregister(IOTFunction *func);
   void listHead(IOTFunction *head);
   void listTail(IOTFunction *tail);
   void listInsert(IOTFunction *pBot, IOTFunction *pSibling),
@@ -0,0 +1,306 @@
+/*
+** EasyIOT - Property History
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "IOTHistory.h"
+#include <math.h>
+#if defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+#endif
+
+#define HISTORY_RECORD (2 * IOT_CODEC_VARINT) // longest raw sample
+#define HISTORY_LIMIT (1LL << 53)             // largest value in units, past it a change may not fit
+
+static_assert(IOT_HISTORY_BYTES >= 4 * HISTORY_RECORD, "IOT_HISTORY_BYTES is too small to hold samples");
+
+static inline int32_t _clamp32(int64_t value)
+{
+    return (value > INT32_MAX) ? INT32_MAX : (value < INT32_MIN) ? INT32_MIN : (int32_t)value;
+}
+
+IOTHistory::IOTHistory(uint8_t places, bool psram)
+    : _block(nullptr), _ring(nullptr),
+      _head(0), _tail(0), _used(0),
+      _seq(0), _count(0),
+      _first({0, 0}), _last({0, 0}),
+      _minutes(), _quarters(),
+      _scale(pow(10, places)),
+      _places(places)
+{
+    size_t buckets = IOT_HISTORY_MINUTES + IOT_HISTORY_QUARTERS;
+    size_t size = buckets * sizeof(IOTHistoryBucket) + IOT_HISTORY_BYTES;
+
+#if defined(BOARD_HAS_PSRAM)
+    if (psram)
+        _block = (uint8_t *)heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+    (void)psram;
+#endif
+    if (_block == nullptr)
+        _block = (uint8_t *)malloc(size);
+    if (_block == nullptr)
+        return;
+
+    _minutes.buckets = (IOTHistoryBucket *)_block;
+    _minutes.size = IOT_HISTORY_MINUTES;
+    _minutes.span = 60;
+    _quarters.buckets = &_minutes.buckets[IOT_HISTORY_MINUTES];
+    _quarters.size = IOT_HISTORY_QUARTERS;
+    _quarters.span = 15 * 60;
+    _ring = (uint8_t *)&_quarters.buckets[IOT_HISTORY_QUARTERS];
+}
+
+IOTHistory::~IOTHistory()
+{
+    if (_block != nullptr)
+    {
+        free(_block);
+        _block = nullptr;
+    }
+}
+
+/*
+** Add a sample
+*/
+bool IOTHistory::add(uint32_t time, const IOTCodecValue &value)
+{
+    double number;
+
+    switch (value.tag)
+    {
+    case IOT_CODEC_FALSE:
+    case IOT_CODEC_TRUE:
+    case IOT_CODEC_SINT:
+        number = value.sint;
+        break;
+    case IOT_CODEC_UINT:
+        number = value.uint;
+        break;
+    case IOT_CODEC_FLOAT:
+    case IOT_CODEC_DOUBLE:
+        number = value.real;
+        break;
+    case IOT_CODEC_TEXT:
+        if (!IOTCodec::fromChars(value.text, value.len, number))
+            return false;
+        break;
+    default:
+        return false;
+    }
+
+    add(time, number);
+    return true;
+}
+
+void IOTHistory::add(uint32_t time, double value)
+{
+    if (!ready() || value != value)
+        return;
+
+    double units = round(value * _scale);
+    int64_t whole = (units >= HISTORY_LIMIT) ? HISTORY_LIMIT : (units <= -HISTORY_LIMIT) ? -HISTORY_LIMIT : (int64_t)units;
+
+    if (_count && time < _last.time)
+        time = _last.time;
+
+    _bucket(_minutes, time, whole);
+    _bucket(_quarters, time, whole);
+
+    if (_count++ == 0)
+    {
+        _first = _last = {time, whole};
+        _seq++;
+        return;
+    }
+
+    // The change from the last, made room for by folding in the oldest
+    uint8_t record[HISTORY_RECORD];
+    int64_t change = whole - _last.value;
+    size_t len = IOTCodec::putVarint(record, sizeof(record), time - _last.time);
+
+    len += IOTCodec::putVarint(&record[len], sizeof(record) - len, ((uint64_t)change << 1) ^ (uint64_t)(change >> 63));
+
+    while (IOT_HISTORY_BYTES - _used < len)
+        _evict();
+
+    for (size_t b = 0; b < len; b++)
+        _ring[(_head + b) % IOT_HISTORY_BYTES] = record[b];
+
+    _head = (_head + len) % IOT_HISTORY_BYTES;
+    _used += len;
+    _last = {time, whole};
+    _seq++;
+}
+
+void IOTHistory::_evict(void)
+{
+    uint32_t delta;
+    int64_t change;
+    size_t len = _read(_tail, delta, change);
+
+    _first.time += delta;
+    _first.value += change;
+    _tail = (_tail + len) % IOT_HISTORY_BYTES;
+    _used -= len;
+    _count--;
+}
+
+// The sample at an offset in the ring, returning its length
+size_t IOTHistory::_read(size_t offset, uint32_t &delta, int64_t &change)
+{
+    uint8_t record[HISTORY_RECORD];
+    uint64_t bits;
+    size_t len;
+
+    for (size_t b = 0; b < sizeof(record); b++)
+        record[b] = _ring[(offset + b) % IOT_HISTORY_BYTES];
+
+    len = IOTCodec::getVarint(record, sizeof(record), bits);
+    delta = (uint32_t)bits;
+    len += IOTCodec::getVarint(&record[len], sizeof(record) - len, bits);
+    change = (int64_t)(bits >> 1) ^ -(int64_t)(bits & 1);
+    return len;
+}
+
+void IOTHistory::_bucket(Tier &tier, uint32_t time, int64_t value)
+{
+    uint32_t start = time - time % tier.span;
+
+    if (tier.count && start != tier.start)
+    {
+        IOTHistoryBucket &bucket = tier.buckets[tier.closed++ % tier.size];
+
+        bucket.time = tier.start;
+        bucket.min = _clamp32(tier.min);
+        bucket.max = _clamp32(tier.max);
+        bucket.avg = _clamp32(tier.sum / (int64_t)tier.count);
+        tier.count = 0;
+    }
+
+    if (tier.count++ == 0)
+    {
+        tier.start = start;
+        tier.min = tier.max = tier.sum = value;
+        return;
+    }
+
+    tier.min = std::min(tier.min, value);
+    tier.max = std::max(tier.max, value);
+    tier.sum += value;
+}
+
+/*
+** Readers, false once there are no more
+*/
+bool IOTHistory::next(Cursor &at, uint32_t &time, int64_t &value)
+{
+    uint32_t first = _seq - _count;
+
+    if (!_count || at.seq >= _seq)
+        return false;
+
+    if (at.seq <= first)
+    {
+        at.seq = first;
+        at.offset = _tail;
+        at.time = _first.time;
+        at.value = _first.value;
+    }
+    else
+    {
+        uint32_t delta;
+        int64_t change;
+
+        at.offset = (at.offset + _read(at.offset, delta, change)) % IOT_HISTORY_BYTES;
+        at.time += delta;
+        at.value += change;
+    }
+
+    at.seq++;
+    time = at.time;
+    value = at.value;
+    return true;
+}
+
+bool IOTHistory::next(HISTORY_TIER tier, Cursor &at, IOTHistoryBucket &bucket)
+{
+    if (tier == HISTORY_TIER::RAW)
+    {
+        int64_t value;
+
+        if (!next(at, bucket.time, value))
+            return false;
+        bucket.min = bucket.max = bucket.avg = _clamp32(value);
+        return true;
+    }
+
+    Tier &t = (tier == HISTORY_TIER::MINUTE) ? _minutes : _quarters;
+    uint32_t oldest = (t.closed > t.size) ? t.closed - t.size : 0;
+
+    if (at.seq < oldest)
+        at.seq = oldest;
+
+    if (at.seq < t.closed)
+    {
+        bucket = t.buckets[at.seq++ % t.size];
+        return true;
+    }
+
+    // Then the bucket still filling
+    if (at.seq > t.closed || !t.count)
+        return false;
+
+    at.seq++;
+    bucket.time = t.start;
+    bucket.min = _clamp32(t.min);
+    bucket.max = _clamp32(t.max);
+    bucket.avg = _clamp32(t.sum / (int64_t)t.count);
+    return true;
+}
+
+/*
+** A value in units as text, exactly, "-12.05" for -1205 at two places
+*/
+size_t IOTHistory::toChars(char *buf, size_t max, int64_t value, uint8_t places)
+{
+    char text[IOT_CODEC_NUMBER];
+    uint64_t magnitude = (value < 0) ? 0 - (uint64_t)value : value;
+    size_t len = 0;
+
+    if (value < 0)
+        text[len++] = '-';
+
+    len += IOTCodec::toChars(&text[len], sizeof(text) - len, magnitude);
+
+    // Pad to one whole digit before the point, then place it
+    if (places && places < sizeof(text) - 3)
+    {
+        size_t digits = len - (value < 0);
+
+        if (digits <= places)
+        {
+            size_t pad = places + 1 - digits;
+
+            memmove(&text[len - digits + pad], &text[len - digits], digits);
+            memset(&text[len - digits], '0', pad);
+            len += pad;
+        }
+
+        memmove(&text[len - places + 1], &text[len - places], places);
+        text[len - places] = '.';
+        len++;
+    }
+
+    return IOTCodec::toChars(buf, max, text, std::min(len, sizeof(text) - 1));
+}
+
+/******************************************************************************/
@@ -0,0 +1,146 @@
+/*
+** EasyIOT - Property History
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HISTORY_H
+#define _IOT_HISTORY_H
+
+#include <Arduino.h>
+#include "IOTCodec.h"
+
+/*
+** Equates and Defintions, a history takes IOT_HISTORY_BYTES and sixteen
+** bytes a bucket, as one block
+*/
+#ifndef IOT_HISTORY_BYTES
+#define IOT_HISTORY_BYTES 512 // raw samples, a few bytes each as deltas from the last
+#endif
+
+#ifndef IOT_HISTORY_MINUTES
+#define IOT_HISTORY_MINUTES 60 // one minute buckets, an hour
+#endif
+
+#ifndef IOT_HISTORY_QUARTERS
+#define IOT_HISTORY_QUARTERS 96 // fifteen minute buckets, a day
+#endif
+
+/*
+** History Resolution
+*/
+enum class HISTORY_TIER
+{
+  RAW,
+  MINUTE,
+  QUARTER
+};
+
+/*
+** A downsampled period, values in units of the history's places
+*/
+typedef struct
+{
+  uint32_t time; // start of the period
+  int32_t min;
+  int32_t max;
+  int32_t avg;
+} IOTHistoryBucket;
+
+/*
+** Property History Class
+**
+** Keeps the recent values of one property, as samples of a time and a
+** value, at three resolutions in a fixed block of memory.
+**
+** Raw samples go into a byte ring, each one a varint of the seconds since
+** the last and a zigzag varint of the change in value, so a slowly moving
+** sensor costs two or three bytes a sample.  The oldest sample is held
+** whole outside the ring and the ring is read forward from it; when the
+** ring is full the oldest is folded into it to make room.
+**
+** Every sample also goes into the open one minute and fifteen minute
+** buckets, each kept as its minimum, maximum and mean once closed, so a
+** longer period can be graphed after its raw samples are gone.
+**
+** Values are held as whole numbers of units, 10^-places of the value.
+** Samples are taken in time order; one from before the last is taken as
+** at the time of the last.
+**
+** Reading is through a cursor, which a writer may hold between calls.  A
+** cursor overtaken by the ring goes on from the oldest sample left.
+*/
+class IOTHistory
+{
+public:
+  typedef struct
+  {
+    uint32_t seq;  // the next sample or bucket, from 0 for the oldest
+    size_t offset; // of the next raw sample in the ring
+    uint32_t time; // of the last raw sample read
+    int64_t value;
+  } Cursor;
+
+  IOTHistory(uint8_t places = 2, bool psram = false);
+  ~IOTHistory();
+
+  bool ready(void) const { return _block != nullptr; }
+  uint8_t places(void) const { return _places; }
+  size_t samples(void) const { return _count; }
+
+  void add(uint32_t time, double value);
+  bool add(uint32_t time, const IOTCodecValue &value);
+
+  bool next(Cursor &at, uint32_t &time, int64_t &value);
+  bool next(HISTORY_TIER tier, Cursor &at, IOTHistoryBucket &bucket);
+
+  static size_t toChars(char *buf, size_t max, int64_t value, uint8_t places);
+
+private:
+  typedef struct
+  {
+    uint32_t time;
+    int64_t value;
+  } Sample;
+
+  typedef struct
+  {
+    IOTHistoryBucket *buckets;
+    size_t size;
+    uint32_t span;   // seconds a bucket covers
+    uint32_t closed; // buckets closed so far
+    uint32_t start;  // of the open bucket
+    int64_t min;
+    int64_t max;
+    int64_t sum;
+    uint32_t count; // samples in the open bucket, none when 0
+  } Tier;
+
+  void _bucket(Tier &tier, uint32_t time, int64_t value);
+  size_t _read(size_t offset, uint32_t &delta, int64_t &change);
+  void _evict(void);
+
+  uint8_t *_block;
+  uint8_t *_ring;
+  size_t _head; // where the next sample is written
+  size_t _tail; // the sample after the oldest
+  size_t _used;
+  uint32_t _seq;   // samples added so far
+  uint32_t _count; // samples held, the oldest one included
+  Sample _first;
+  Sample _last;
+  Tier _minutes;
+  Tier _quarters;
+  double _scale;
+  uint8_t _places;
+};
+
+#endif // _IOT_HISTORY_H
+/******************************************************************************/
@@ -19,33 +19,111 @@
 #include "http/FILEHandler.h"
 
 #include <libb64/cencode.h>
+#include <lwip/sockets.h>
 #include <FS.h>
 
 const char *AUTHORIZATION_HEADER = "Authorization";
+const char *IF_NONE_MATCH_HEADER = "If-None-Match";
+const char *RANGE_HEADER = "Range";
+const char *IF_RANGE_HEADER = "If-Range";
+
+// Names of the HTTPHeaderId headers, in the same order
+static const char *_builtinHeaders[HTTP_HEADER_BUILTIN] = {
+    AUTHORIZATION_HEADER,
+    IF_NONE_MATCH_HEADER,
+    RANGE_HEADER,
+    IF_RANGE_HEADER,
+    "Content-Type",
+    "Content-Length",
+    "Host",
+    "Connection",
+    "Transfer-Encoding"};
+
+// Headers before each part of a multipart/byteranges body, and its end
+static const char _partFormat[] = "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %u-%u/%u\r\n\r\n";
+static const char _endFormat[] = "\r\n--%s--\r\n";
+
+/*
+** Case folded FNV-1a, header names are tokens so setting bit 5 is enough
+*/
+static uint32_t _headerHash(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+
+    while (len--)
+        hash = (hash ^ (uint8_t)(*name++ | 0x20)) * 16777619u;
+    return hash;
+}
+
+/*
+** Takes as long wherever the first difference lies, only the length shows
+*/
+static bool _secureEquals(const char *given, size_t givenLen, const char *secret, size_t secretLen)
+{
+    uint8_t diff = (givenLen != secretLen);
+
+    for (size_t i = 0; i < secretLen; i++)
+        diff |= (uint8_t)(((i < givenLen) ? given[i] : 0) ^ secret[i]);
+    return diff == 0;
+}
 
 /*
 ** Class Construction
 */
 IOTHTTP::IOTHTTP(const char *tag, uint16_t port, bool mdns)
     : WiFiServer(port),
-      _tag(tag),
-      _port(port),
-      _bonjour(mdns),
-      _state(IOT_HTTP_STOPPED),
-      _currentMethod(HTTP_ANY),
-      _currentVersion(0),
-      _currentStatus(HC_NONE),
-      _statusChange(0),
       _currentHandler(0),
       _firstHandler(0),
       _lastHandler(0),
-      _currentArgCount(0),
-      _currentArgs(0),
+      _events(nullptr),
+      _socket(nullptr),
+      _metrics(nullptr),
+      _current(&_clients[0]),
+      _nextClient(0),
+      _waitingCount(0),
+      _waitingMax(HTTP_MAX_WAITING),
+      _currentMethod(HTTP_ANY),
+      _currentVersion(0),
       _headerKeysCount(0),
-      _currentHeaders(0),
-      _contentLength(0),
-      _chunked(false)
+      _authEpoch(1),
+      _keepAliveWait(HTTP_KEEPALIVE_WAIT),
+      _keepAliveMax(HTTP_KEEPALIVE_MAX),
+      _task(nullptr),
+      _taskCore(HTTP_TASK_CORE),
+      _taskStack(HTTP_TASK_STACK),
+      _taskStop(false),
+      _syncDone(nullptr),
+      _syncQueue(nullptr),
+      _tag(tag),
+      _state(IOT_HTTP_STOPPED),
+      _port(port),
+      _bonjour(mdns)
 {
+    _lock = xSemaphoreCreateRecursiveMutex();
+
+    memset(_headerTable, -1, sizeof(_headerTable));
+    for (int h = 0; h < HTTP_HEADER_BUILTIN; h++)
+        _headerTrack(_builtinHeaders[h]);
+
+    for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
+    {
+        _clients[c].status = HC_NONE;
+        _clients[c].handler = nullptr;
+        _clients[c].handlerTime = 0;
+        _clients[c].statusChange = 0;
+        _clients[c].requestStart = 0;
+        _clients[c].requests = 0;
+        _clients[c].authEpoch = 0;
+        _clients[c].contentLength = 0;
+        _clients[c].argCount = 0;
+        _clients[c].body.stage = HB_NONE;
+        _clients[c].body.taken = 0;
+        _clients[c].chunked = false;
+        _clients[c].keepAlive = false;
+        _clients[c].responded = false;
+        _clients[c].detached = false;
+    }
+
     ESP_LOGI(_tag, "Created HTTP (%d) Server", _port);
 }
 
@@ -55,11 +133,9 @@ IOTHTTP::IOTHTTP(const char *tag, uint16_t port, bool mdns)
 IOTHTTP::~IOTHTTP()
 {
     webShutdown();
-    if (_currentHeaders)
-        delete[] _currentHeaders;
-    _headerKeysCount = 0;
     HTTPHandler *handler = _firstHandler;
 
+    _router.clear();
     while (handler)
     {
         HTTPHandler *next = handler->nextHandler();
@@ -67,6 +143,12 @@ IOTHTTP::~IOTHTTP()
         handler = next;
     }
     close();
+
+    if (_syncQueue)
+        vQueueDelete(_syncQueue);
+    if (_syncDone)
+        vSemaphoreDelete(_syncDone);
+    vSemaphoreDelete(_lock);
 }
 
 /*
@@ -79,10 +161,9 @@ void IOTHTTP::webStartup(void)
 
     ESP_LOGI(_tag, "Starting HTTP Server: %d", _port);
 
-    _currentStatus = HC_NONE;
+    for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
+        _closeClient(_clients[c]);
     begin();
-    if (!_headerKeysCount)
-        collectHeaders(0, 0);
 
     if (_bonjour)
     {
@@ -91,6 +172,21 @@ void IOTHTTP::webStartup(void)
     }
 
     _state = IOT_HTTP_RUNNING;
+
+    if (_taskCore >= 0 && !_task)
+    {
+        if (!_syncQueue)
+            _syncQueue = xQueueCreate(1, sizeof(std::function<void(void)> *));
+        if (!_syncDone)
+            _syncDone = xSemaphoreCreateBinary();
+
+        _taskStop = false;
+        if (xTaskCreatePinnedToCore(_taskMain, _tag, _taskStack, this, HTTP_TASK_PRIORITY, &_task, _taskCore) != pdPASS)
+        {
+            ESP_LOGE(_tag, "HTTP Task Failed, Servicing From Loop");
+            _task = nullptr;
+        }
+    }
 }
 
 /*
@@ -102,9 +198,31 @@ void IOTHTTP::webShutdown(void)
         return;
 
     ESP_LOGI(_tag, "Stopping HTTP Server");
+
+    // The task may be waiting on a sync call, keep answering until it exits
+    if (_task)
+    {
+        _taskStop = true;
+        while (_task)
+        {
+            webDispatch();
+            delay(1);
+        }
+    }
+
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
+        _closeClient(_clients[c]);
+    while (_waitingCount)
+        _waiting[--_waitingCount] = WiFiClient();
+    if (_events)
+        _events->close();
+    if (_socket)
+        _socket->close();
     stop();
 
     _state = IOT_HTTP_STOPPED;
+    xSemaphoreGiveRecursive(_lock);
 }
 
 /*
@@ -115,357 +233,936 @@ void IOTHTTP::webService(void)
     if (_state != IOT_HTTP_RUNNING)
         return;
 
-    if (_currentStatus == HC_NONE)
-    {
-        WiFiClient client = available();
-        if (!client)
-        {
-            return;
-        }
-
-        ESP_LOGV(_tag, "Client Connected: %s:%d", client.remoteIP().toString().c_str(), client.remotePort());
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
 
-        _currentClient = client;
-        _currentStatus = HC_WAIT_READ;
-        _statusChange = millis();
-    }
+    _admitClients();
 
-    if (!_currentClient.connected())
+    // Service each connection in turn, so no one client can hog the server
+    for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
     {
-        _currentClient = WiFiClient();
-        _currentStatus = HC_NONE;
-        return;
+        _nextClient = (_nextClient + 1) % HTTP_MAX_CLIENTS;
+        if (_clients[_nextClient].status != HC_NONE)
+            _serviceClient(_clients[_nextClient]);
     }
 
-    // Wait for data from client to become available
-    if (_currentStatus == HC_WAIT_READ)
-    {
-        if (!_currentClient.available())
-        {
-            if (millis() - _statusChange > HTTP_MAX_DATA_WAIT)
-            {
-                _currentClient = WiFiClient();
-                _currentStatus = HC_NONE;
-            }
-            yield();
-            return;
-        }
+    if (_events)
+        _events->service();
+    if (_socket)
+        _socket->service();
 
-        ESP_LOGV(_tag, "Content Size: %d", _currentClient.available());
+    xSemaphoreGiveRecursive(_lock);
+}
 
-        if (!_parseRequest(_currentClient))
-        {
-            _currentClient = WiFiClient();
-            _currentStatus = HC_NONE;
-            ESP_LOGV(_tag, "Parsing Request Failed!");
-            return;
-        }
+/*
+** Admission Control
+**
+** New connections take a free slot, or wait a little for one, and are
+** refused with a canned response and a close once their address is out of
+** tokens or too many are open.  Nothing of a refused request is read.
+*/
+void IOTHTTP::_admitClients(void)
+{
+    unsigned long now = millis();
 
-        _currentClient.setTimeout(HTTP_MAX_SEND_WAIT);
-        _contentLength = CONTENT_LENGTH_NOT_SET;
-        _handleRequest();
+    // Those waiting go first, in the order they came
+    while (_waitingCount)
+    {
+        HTTPConnection *conn = _freeClient();
+
+        if (!conn && now - _waitingSince[0] <= HTTP_MAX_DATA_WAIT)
+            break;
 
-        if (!_currentClient.connected())
+        if (conn)
+            _openClient(*conn, _waiting[0]);
+        else
         {
-            _currentClient = WiFiClient();
-            _currentStatus = HC_NONE;
-            return;
+            _limiter.countBusy();
+            _refuseClient(_waiting[0], 503);
         }
-        else
+
+        _waitingCount--;
+        for (int w = 0; w < _waitingCount; w++)
         {
-            _currentStatus = HC_WAIT_CLOSE;
-            _statusChange = millis();
-            return;
+            _waiting[w] = _waiting[w + 1];
+            _waitingSince[w] = _waitingSince[w + 1];
         }
+        _waiting[_waitingCount] = WiFiClient();
     }
 
-    if (_currentStatus == HC_WAIT_CLOSE)
+    for (int n = 0; n < HTTP_MAX_CLIENTS + HTTP_MAX_WAITING; n++)
     {
-        if (millis() - _statusChange > HTTP_MAX_CLOSE_WAIT)
+        WiFiClient client = available();
+        if (!client)
+            break;
+
+        HTTPConnection *conn = nullptr;
+
+        if (!_limiter.ready(client.remoteIP(), now))
+        {
+            _limiter.countLimited();
+            _refuseClient(client, 429);
+        }
+        else if (!_waitingCount && (conn = _freeClient()))
+            _openClient(*conn, client);
+        else if (_waitingCount < _waitingMax)
         {
-            _currentClient = WiFiClient();
-            _currentStatus = HC_NONE;
+            _waiting[_waitingCount] = client;
+            _waitingSince[_waitingCount++] = now;
         }
         else
         {
-            yield();
-            return;
+            _limiter.countBusy();
+            _refuseClient(client, 503);
         }
     }
 }
 
 /*
-** HTTP Handlers
+** A free slot, finishing a connection whose response is sent or closing an
+** idle persistent one for one if need be.  One only just answered is likely
+** to be sent its next request any moment.
 */
-void IOTHTTP::webHandler(HTTPHandler *handler)
+HTTPConnection *IOTHTTP::_freeClient(void)
 {
-    _addRequestHandler(handler);
-}
+    HTTPConnection *done = nullptr;
+    HTTPConnection *idle = nullptr;
+    unsigned long now = millis();
 
-void IOTHTTP::_addRequestHandler(HTTPHandler *handler)
-{
-    if (!_lastHandler)
+    for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
     {
-        _firstHandler = handler;
-        _lastHandler = handler;
+        HTTPConnection &conn = _clients[c];
+
+        if (conn.status == HC_NONE)
+            return &conn;
+        if (conn.status == HC_WAIT_CLOSE && (!done || (long)(conn.statusChange - done->statusChange) < 0))
+            done = &conn;
+        if (conn.status == HC_WAIT_READ && conn.requests && !conn.parser.buffered() &&
+            now - conn.statusChange > HTTP_RECLAIM_IDLE && (!idle || (long)(conn.statusChange - idle->statusChange) < 0))
+            idle = &conn;
     }
-    else
-    {
-        // TODO: Check we don't already have the handler installed!
 
+    // Nothing more is owed one waiting for its peer to close
+    if (done)
+    {
+        _closeClient(*done);
+        return done;
+    }
 
-        _lastHandler->nextHandler(handler);
-        _lastHandler = handler;
+    if (idle)
+    {
+        ESP_LOGV(_tag, "Idle Client Reclaimed: %s:%d", idle->client.remoteIP().toString().c_str(), idle->client.remotePort());
+        _limiter.countReclaimed();
+        _closeClient(*idle);
     }
+    return idle;
 }
 
-/*
-** Basic HTTP Authentication
-*/
-void IOTHTTP::webAuthenticate()
+void IOTHTTP::_openClient(HTTPConnection &conn, WiFiClient &client)
 {
-    sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
-    send(401);
+    ESP_LOGV(_tag, "Client Connected (%d): %s:%d", (int)(&conn - _clients), client.remoteIP().toString().c_str(), client.remotePort());
+
+    conn.client = client;
+    conn.status = HC_WAIT_READ;
+    conn.statusChange = millis();
+    conn.requests = 0;
+    conn.authEpoch = 0;
+    conn.parser.clear();
 }
 
-bool IOTHTTP::webCredentials(const char *username, const char *password)
+void IOTHTTP::_refuseClient(WiFiClient &client, int code)
 {
-    if (hasHeader(AUTHORIZATION_HEADER))
-    {
-        String authReq = header(AUTHORIZATION_HEADER);
-
-        if (authReq.startsWith("Basic"))
-        {
-            authReq = authReq.substring(6);
-            authReq.trim();
-            char toencodeLen = strlen(username) + strlen(password) + 1;
-            char *toencode = new char[toencodeLen + 1];
-
-            if (toencode == NULL)
-            {
-                authReq = String();
-                return false;
-            }
+    static const char tooMany[] = "HTTP/1.1 429 Too Many Requests\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    const char *text = (code == 429) ? tooMany : busy;
 
-            char *encoded = new char[base64_encode_expected_len(toencodeLen) + 1];
+    ESP_LOGD(_tag, "Refused (%d): %s:%d", code, client.remoteIP().toString().c_str(), client.remotePort());
 
-            if (encoded == NULL)
-            {
-                authReq = String();
-                delete[] toencode;
-                return false;
-            }
-
-            sprintf(toencode, "%s:%s", username, password);
-
-            if (base64_encode_chars(toencode, toencodeLen, encoded) > 0 && authReq.equals(encoded))
-            {
-                authReq = String();
-                delete[] toencode;
-                delete[] encoded;
-                return true;
-            }
-            delete[] toencode;
-            delete[] encoded;
-        }
-        authReq = String();
-    }
-    return false;
+    // Whatever the socket takes at once, a refusal is not worth waiting for
+    ::send(client.fd(), text, strlen(text), MSG_DONTWAIT);
+    client.stop();
 }
 
 /*
-** On Handlers
+** Out of tokens part way through a persistent connection, answer without
+** reading the body and close once the client has had the answer
 */
-void IOTHTTP::on(const String &uri, http_callback_t fn)
+void IOTHTTP::_refuseRequest(HTTPConnection &conn)
 {
-    on(uri, HTTP_ANY, fn);
+    ESP_LOGD(_tag, "Refused (429): %s:%d", conn.client.remoteIP().toString().c_str(), conn.client.remotePort());
+
+    _limiter.countLimited();
+    conn.keepAlive = false;
+    conn.responded = true;
+    conn.response.header("Retry-After", "1");
+    conn.response.header("Content-Length", "0");
+    conn.response.header("Connection", "close");
+    conn.response.status(1, 429);
+
+    conn.status = HC_WAIT_SEND;
+    conn.statusChange = millis();
+    _sendClient(conn);
 }
 
-void IOTHTTP::on(const String &uri, HTTPMethod method, http_callback_t fn)
+/*
+** Server Task
+**
+** With a core chosen the server runs in its own task, so a slow client or a
+** large file no longer holds up loop().  Handlers then run on that task and
+** must reach properties and functions through webSync(), which hands the
+** work to loop() and waits for it.
+*/
+void IOTHTTP::webTask(int8_t core, uint32_t stack)
 {
-    on(uri, method, fn, _uploadHandler);
+    _taskCore = core;
+    _taskStack = stack;
 }
 
-void IOTHTTP::on(const String &uri, HTTPMethod method, http_callback_t fn, http_callback_t ufn)
+void IOTHTTP::_taskMain(void *server)
 {
-    ESP_LOGD(_tag, "On Handler: %s", uri.c_str());
-    _addRequestHandler(new PAGEHandler(fn, ufn, uri, method));
-}
+    IOTHTTP *web = (IOTHTTP *)server;
 
-void IOTHTTP::onFile(const char *uri, FS &fs, const char *path, const char *cache_header)
-{
-    _addRequestHandler(new FILEHandler(fs, path, uri, cache_header));
+    while (!web->_taskStop)
+    {
+        web->webService();
+        vTaskDelay(1);
+    }
+
+    web->_task = nullptr;
+    vTaskDelete(NULL);
 }
 
 /*
-** Arguments
+** Run a function on the loop() side, called from a handler
 */
-bool IOTHTTP::hasArg(String name)
+void IOTHTTP::webSync(std::function<void(void)> fn)
 {
-    for (int i = 0; i < _currentArgCount; ++i)
+    if (!_task || xTaskGetCurrentTaskHandle() != _task)
     {
-        if (_currentArgs[i].key == name)
-            return true;
+        fn();
+        return;
     }
-    return false;
-}
 
-String IOTHTTP::arg(String name)
-{
-    for (int i = 0; i < _currentArgCount; ++i)
-    {
-        if (_currentArgs[i].key == name)
-            return _currentArgs[i].value;
-    }
-    return String();
-}
+    std::function<void(void)> *call = &fn;
 
-String IOTHTTP::arg(int i)
-{
-    if (i < _currentArgCount)
-        return _currentArgs[i].value;
-    return String();
-}
+    // Let go of the server while loop() works, it may add a handler
+    UBaseType_t depth = 0;
+    while (xSemaphoreGiveRecursive(_lock) == pdTRUE)
+        depth++;
 
-String IOTHTTP::argName(int i)
-{
-    if (i < _currentArgCount)
-        return _currentArgs[i].key;
-    return String();
+    xQueueSend(_syncQueue, &call, portMAX_DELAY);
+    xSemaphoreTake(_syncDone, portMAX_DELAY);
+
+    while (depth--)
+        xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
 }
 
 /*
-** Headers
+** Answer the server task's sync calls, called from loop()
 */
-bool IOTHTTP::hasHeader(String name)
-{    
-    for (int i = 0; i < _headerKeysCount; ++i)
-    {       
-        if ((_currentHeaders[i].key.equalsIgnoreCase(name)) && (_currentHeaders[i].value.length() > 0))
-            return true;
-    }
-    return false;
-}
-
-void IOTHTTP::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+void IOTHTTP::webDispatch(void)
 {
-    // TODO: Merge Existing tracked headers, as the master may have added some!
-    _headerKeysCount = headerKeysCount + 1;
-    if (_currentHeaders)
-        delete[] _currentHeaders;
-    _currentHeaders = new RequestArgument[_headerKeysCount];
-    _currentHeaders[0].key = AUTHORIZATION_HEADER;
-    for (int i = 1; i < _headerKeysCount; i++)
+    std::function<void(void)> *call;
+
+    if (!_syncQueue)
+        return;
+
+    while (xQueueReceive(_syncQueue, &call, 0) == pdTRUE)
     {
-        _currentHeaders[i].key = headerKeys[i - 1];
+        (*call)();
+        xSemaphoreGive(_syncDone);
     }
 }
 
-String IOTHTTP::header(String name)
+void IOTHTTP::_serviceClient(HTTPConnection &conn)
 {
-    for (int i = 0; i < _headerKeysCount; ++i)
+    _current = &conn;
+
+    // A response may still drain to a peer that has finished sending
+    if (conn.status != HC_WAIT_SEND && !conn.client.connected())
     {
-        if (_currentHeaders[i].key.equalsIgnoreCase(name))
-            return _currentHeaders[i].value;
+        _closeClient(conn);
+        return;
     }
-    return String();
-}
 
-String IOTHTTP::header(int i)
-{
-    if (i < _headerKeysCount)
-        return _currentHeaders[i].value;
-    return String();
-}
+    // Collect the request headers as they arrive
+    if (conn.status == HC_WAIT_READ)
+    {
+        size_t held = conn.parser.buffered();
 
-String IOTHTTP::headerName(int i)
-{
-    if (i < _headerKeysCount)
-        return _currentHeaders[i].key;
-    return String();
-}
+        if (conn.parser.fill(conn.client))
+        {
+            conn.statusChange = millis();
+            if (!held)
+                conn.requestStart = micros();
+        }
 
-void IOTHTTP::_prepareHeader(String &response, int code, const char *content_type, size_t contentLength)
-{
-    response = "HTTP/1." + String(_currentVersion) + " ";
-    response += String(code);
-    response += " ";
-    response += _responseCodeToString(code);
-    response += "\r\n";
+        HTTPParseStatus parsed = conn.parser.parse();
 
-    if (!content_type)
-        content_type = MIME_TYPE_HTML;
+        if (parsed == HP_PARTIAL)
+        {
+            // An idle persistent connection waits longer for its next request
+            unsigned long wait = (conn.requests && !conn.parser.buffered()) ? _keepAliveWait : HTTP_MAX_DATA_WAIT;
 
-    sendHeader("Content-Type", content_type, true);
-    if (_contentLength == CONTENT_LENGTH_NOT_SET)
-    {
-        sendHeader("Content-Length", String(contentLength));
-    }
-    else if (_contentLength != CONTENT_LENGTH_UNKNOWN)
-    {
-        sendHeader("Content-Length", String(_contentLength));
-    }
-    else if (_contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion)
-    { //HTTP/1.1 or above client
-        //let's do chunked
-        _chunked = true;
-        sendHeader("Accept-Ranges", "none");
-        sendHeader("Transfer-Encoding", "chunked");
-    }
-    sendHeader("Connection", "close");
+            if (millis() - conn.statusChange > wait)
+                _closeClient(conn);
+            return;
+        }
 
-    response += _responseHeaders;
-    response += "\r\n";
-    _responseHeaders = String();
-}
+        ESP_LOGV(_tag, "Request Size: %u", (unsigned)conn.parser.buffered());
+
+        conn.contentLength = CONTENT_LENGTH_NOT_SET;
+        conn.responded = false;
+        conn.detached = false;
+        conn.sender = nullptr;
+        conn.handler = nullptr;
+        conn.handlerTime = 0;
+        conn.argCount = 0;
+        conn.body.stage = HB_NONE;
+        conn.body.taken = 0;
+        conn.response.begin();
+        conn.response.measure();
+
+        if (parsed == HP_COMPLETE && !_limiter.take(conn.client.remoteIP(), millis()))
+        {
+            _refuseRequest(conn);
+            return;
+        }
 
-/*
-** Senders
-*/
-void IOTHTTP::sendHeader(const String &name, const String &value, bool first)
-{
-    String headerLine = name;
-    headerLine += ": ";
-    headerLine += value;
-    headerLine += "\r\n";
+        if (parsed == HP_ERROR)
+        {
+            ESP_LOGV(_tag, "Parsing Request Failed!");
+            _closeClient(conn);
+            return;
+        }
 
-    if (first)
-    {
-        _responseHeaders = headerLine + _responseHeaders;
+        conn.status = HC_WAIT_BODY;
+        conn.statusChange = millis();
     }
-    else
+
+    // Take the request once any body it needs whole is here, reading what
+    // has arrived on each pass rather than waiting for the rest.  A body
+    // handed on as it arrives is taken the same way, a pass at a time.
+    if (conn.status == HC_WAIT_BODY)
     {
-        _responseHeaders += headerLine;
-    }
-}
+        size_t held = conn.parser.buffered();
+        size_t taken = conn.body.taken;
+        HTTPParseStatus request = _parseRequest(conn.client);
 
-void IOTHTTP::sendContent(const String &content)
-{
-    const char *footer = "\r\n";
-    size_t len = content.length();
+        if (request == HP_PARTIAL)
+        {
+            if (conn.parser.buffered() != held || conn.body.taken != taken)
+                conn.statusChange = millis();
+            else if (millis() - conn.statusChange > HTTP_MAX_POST_WAIT)
+                _closeClient(conn);
+            return;
+        }
 
-    if (_chunked)
-    {
-        char *chunkSize = (char *)malloc(11);
-        if (chunkSize)
+        if (request == HP_ERROR)
+        {
+            ESP_LOGV(_tag, "Parsing Request Failed!");
+            _abortBody(conn);
+
+            // Let a refusal reach the client before closing
+            if (conn.responded)
+            {
+                conn.keepAlive = false;
+                conn.status = HC_WAIT_SEND;
+                conn.statusChange = millis();
+                _sendClient(conn);
+            }
+            else
+                _closeClient(conn);
+            return;
+        }
+
+        conn.client.setTimeout(HTTP_MAX_SEND_WAIT);
+
+        unsigned long handlerStart = micros();
+
+        _handleRequest();
+        conn.handler = _currentHandler;
+        conn.handlerTime = micros() - handlerStart;
+
+        // A detached connection now belongs to the handler, only let go of it
+        if (conn.detached)
+        {
+            _endResponse(conn);
+            return;
+        }
+
+        // Finish a stream the handler left open
+        if (conn.chunked && !conn.sender)
         {
-            sprintf(chunkSize, "%x%s", len, footer);
-            _currentClient.write(chunkSize, strlen(chunkSize));
-            free(chunkSize);
+            conn.chunked = false;
+            conn.response.lastChunk(conn.client);
         }
+
+        conn.status = HC_WAIT_SEND;
+        conn.statusChange = millis();
+        _sendClient(conn);
+        return;
     }
 
-    _currentClient.write(content.c_str(), len);
+    if (conn.status == HC_WAIT_SEND)
+    {
+        _sendClient(conn);
+        return;
+    }
 
-    if (_chunked)
+    if (conn.status == HC_WAIT_CLOSE)
     {
-        _currentClient.write(footer, 2);
+        uint8_t discard[128];
+
+        // Closing on bytes unread, a body refused with a 413, would reset
+        // the connection and could lose the response
+        for (int burst = 0; burst < HTTP_SEND_BURST && conn.client.available() > 0; burst++)
+            conn.client.read(discard, sizeof(discard));
+
+        if (millis() - conn.statusChange > HTTP_MAX_CLOSE_WAIT)
+            _closeClient(conn);
     }
 }
 
-bool IOTHTTP::send(int code, char *content_type, const String &content)
+/*
+** Send what the socket will take without waiting, asking the sender for
+** more as it drains.  What is left goes on the next pass, so one slow peer
+** holds up no one else.
+*/
+void IOTHTTP::_sendClient(HTTPConnection &conn)
 {
-    return send(code, (const char *)content_type, content);
+    HTTPResponse &response = conn.response;
+    HTTPStream out(conn);
+
+    for (int burst = 0; burst < HTTP_SEND_BURST; burst++)
+    {
+        bool paused = false;
+
+        if (conn.sender && out.room())
+        {
+            size_t held = response.pending();
+
+            if (!conn.sender(out))
+            {
+                conn.sender = nullptr;
+                out.end();
+            }
+            else if (response.pending() == held)
+                paused = true;
+            else
+                conn.statusChange = millis();
+        }
+
+        if (response.pending() && response.drain(conn.client))
+            conn.statusChange = millis();
+
+        if (response.failed())
+        {
+            _closeClient(conn);
+            return;
+        }
+
+        if (response.pending() || !conn.sender || paused)
+            break;
+    }
+
+    if (response.pending())
+    {
+        if (millis() - conn.statusChange > HTTP_MAX_SEND_WAIT)
+        {
+            ESP_LOGD(_tag, "Send stalled, closing: %s:%d", conn.client.remoteIP().toString().c_str(), conn.client.remotePort());
+            _closeClient(conn);
+        }
+        return;
+    }
+
+    if (!conn.sender)
+        _endResponse(conn);
+}
+
+void IOTHTTP::_endResponse(HTTPConnection &conn)
+{
+    if (_metrics)
+    {
+        unsigned long firstByte = (conn.response.sent()) ? conn.response.firstSent() : micros();
+
+        _metrics->record(conn.handler, conn.response.code(), firstByte - conn.requestStart,
+                         conn.handlerTime, conn.response.sent());
+    }
+
+    if (conn.detached || !conn.client.connected())
+    {
+        _closeClient(conn);
+    }
+    else if (conn.keepAlive && conn.responded)
+    {
+        // Keep the connection, any pipelined bytes are parsed next
+        conn.requests++;
+        conn.parser.reset();
+        conn.requestStart = micros();
+        conn.status = HC_WAIT_READ;
+        conn.statusChange = millis();
+    }
+    else
+    {
+        // A FIN tells the peer the response is all, what it still sends is
+        // read off until it closes
+        ::shutdown(conn.client.fd(), SHUT_WR);
+        conn.status = HC_WAIT_CLOSE;
+        conn.statusChange = millis();
+    }
+}
+
+void IOTHTTP::_closeClient(HTTPConnection &conn)
+{
+    _abortBody(conn);
+    conn.client = WiFiClient();
+    conn.sender = nullptr;
+    conn.response.begin();
+    conn.status = HC_NONE;
+    conn.chunked = false;
+    conn.keepAlive = false;
+}
+
+/*
+** Persistent Connections
+*/
+void IOTHTTP::webKeepAlive(unsigned long timeout, uint16_t maxRequests)
+{
+    _keepAliveWait = timeout;
+    _keepAliveMax = maxRequests;
+}
+
+/*
+** Requests per second and burst allowed each address, a rate of zero lifts
+** the limit.  Waiting is how many connections may queue for a free slot.
+*/
+void IOTHTTP::webLimit(uint16_t rate, uint16_t burst, uint8_t waiting)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    _limiter.configure(rate, burst);
+    _waitingMax = (waiting < HTTP_MAX_WAITING) ? waiting : HTTP_MAX_WAITING;
+    xSemaphoreGiveRecursive(_lock);
+}
+
+/*
+** HTTP Handlers
+*/
+void IOTHTTP::webHandler(HTTPHandler *handler)
+{
+    _addRequestHandler(handler);
+}
+
+void IOTHTTP::webRefresh(void)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (HTTPHandler *handler = _firstHandler; handler; handler = handler->nextHandler())
+        handler->httpRefresh();
+    xSemaphoreGiveRecursive(_lock);
+}
+
+void IOTHTTP::_addRequestHandler(HTTPHandler *handler)
+{
+    // A tasked server may be walking the list or the router meanwhile
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+
+    if (!_lastHandler)
+    {
+        _firstHandler = handler;
+        _lastHandler = handler;
+    }
+    else
+    {
+        // TODO: Check we don't already have the handler installed!
+
+        _lastHandler->nextHandler(handler);
+        _lastHandler = handler;
+    }
+
+    _router.add(handler);
+    xSemaphoreGiveRecursive(_lock);
+}
+
+/*
+** Basic HTTP Authentication
+*/
+void IOTHTTP::webAuthenticate()
+{
+    sendHeader("WWW-Authenticate", "Basic realm=\"Login Required\"");
+    send(401);
+}
+
+/*
+** The credentials are encoded once, as the header carries them, null
+** removes them.  Connections that proved the old ones must prove the new.
+*/
+void IOTHTTP::webLogin(const char *username, const char *password)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+
+    _authToken = String();
+    _authPlain = String();
+
+    // Come round again, no connection may keep the epoch it proved
+    if (!++_authEpoch)
+    {
+        for (int c = 0; c < HTTP_MAX_CLIENTS; c++)
+            _clients[c].authEpoch = 0;
+        _authEpoch = 1;
+    }
+
+    if (username && password)
+    {
+        size_t plainLen = strlen(username) + strlen(password) + 1;
+        char *plain = new char[plainLen + 1];
+        char *encoded = new char[base64_encode_expected_len(plainLen) + 1];
+
+        sprintf(plain, "%s:%s", username, password);
+        if (base64_encode_chars(plain, plainLen, encoded) > 0)
+        {
+            _authToken = encoded;
+            _authPlain = plain;
+        }
+        delete[] plain;
+        delete[] encoded;
+    }
+
+    xSemaphoreGiveRecursive(_lock);
+}
+
+/*
+** True if the request carries the credentials given to webLogin()
+*/
+bool IOTHTTP::webAuthorized(void)
+{
+    const HTTPSlice &value = _currentHeaders[HTTP_HEADER_AUTHORIZATION].value;
+
+    if (!_authToken.length() || !value.len)
+        return false;
+
+#if HTTP_AUTH_CACHE
+    if (_current->authEpoch == _authEpoch)
+        return true;
+#endif
+
+    const char *token = _current->parser.str(value);
+    size_t len = value.len;
+
+    if (len < 6 || strncasecmp(token, "Basic ", 6) != 0)
+        return false;
+
+    for (token += 6, len -= 6; len && *token == ' '; token++, len--)
+        ;
+    while (len && token[len - 1] == ' ')
+        len--;
+
+    if (!_secureEquals(token, len, _authToken.c_str(), _authToken.length()))
+        return false;
+
+#if HTTP_AUTH_CACHE
+    _current->authEpoch = _authEpoch;
+#endif
+    return true;
+}
+
+/*
+** Check against the credentials given, only encoding them when they change
+*/
+bool IOTHTTP::webCredentials(const char *username, const char *password)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+
+    const char *held = _authPlain.c_str();
+    size_t userLen = (username) ? strlen(username) : 0;
+    bool same;
+
+    if (!username || !password)
+        same = !_authToken.length();
+    else
+        same = _authToken.length() && strncmp(held, username, userLen) == 0 && held[userLen] == ':' &&
+               strcmp(&held[userLen + 1], password) == 0;
+
+    if (!same)
+        webLogin(username, password);
+
+    xSemaphoreGiveRecursive(_lock);
+    return webAuthorized();
+}
+
+/*
+** On Handlers
+*/
+void IOTHTTP::on(const String &uri, http_callback_t fn)
+{
+    on(uri, HTTP_ANY, fn);
+}
+
+void IOTHTTP::on(const String &uri, HTTPMethod method, http_callback_t fn)
+{
+    on(uri, method, fn, _uploadHandler);
+}
+
+void IOTHTTP::on(const String &uri, HTTPMethod method, http_callback_t fn, http_callback_t ufn)
+{
+    ESP_LOGD(_tag, "On Handler: %s", uri.c_str());
+    _addRequestHandler(new PAGEHandler(fn, ufn, uri, method));
+}
+
+/*
+** Body Handlers, bfn is called as the body arrives with upload() holding
+** each block, then fn once it is complete
+*/
+void IOTHTTP::onBody(const String &uri, HTTPMethod method, http_callback_t fn, http_callback_t bfn)
+{
+    ESP_LOGD(_tag, "On Body Handler: %s", uri.c_str());
+    _addRequestHandler(new PAGEHandler(fn, bfn, uri, method, true));
+}
+
+void IOTHTTP::onFile(const char *uri, FS &fs, const char *path, const char *cache_header)
+{
+    _addRequestHandler(new FILEHandler(fs, path, uri, cache_header));
+}
+
+/*
+** Property Change Events
+*/
+void IOTHTTP::onEvents(const char *uri)
+{
+    const char *headerKeys[] = {LAST_EVENT_ID_HEADER};
+
+    if (_events)
+        return;
+
+    collectHeaders(headerKeys, 1);
+    _events = new HTTPEvents(uri);
+    _addRequestHandler(_events);
+}
+
+void IOTHTTP::onSocket(const char *uri, HTTPSocket::property_t fn)
+{
+    const char *headerKeys[] = {UPGRADE_HEADER, SEC_WEBSOCKET_KEY_HEADER, SEC_WEBSOCKET_VERSION_HEADER};
+
+    if (_socket)
+        return;
+
+    collectHeaders(headerKeys, 3);
+    _socket = new HTTPSocket(uri, fn);
+    _addRequestHandler(_socket);
+}
+
+/*
+** Request Metrics
+*/
+void IOTHTTP::onMetrics(const char *uri)
+{
+    if (_metrics)
+        return;
+
+    _metrics = new HTTPMetrics(uri);
+    _addRequestHandler(_metrics);
+}
+
+/*
+** REST Api over the function tree
+*/
+void IOTHTTP::onApi(const char *uri, HTTPApi::function_t ffn, HTTPApi::property_t pfn)
+{
+    _addRequestHandler(new HTTPApi(uri, ffn, pfn));
+}
+
+/*
+** Property history, looked up by path
+*/
+void IOTHTTP::onHistory(const char *uri, HTTPHistory::lookup_t lookup)
+{
+    _addRequestHandler(new HTTPHistory(uri, lookup));
+}
+
+void IOTHTTP::webEvent(const char *tag, uint8_t index, const char *value, time_t time)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    if (_events)
+        _events->publish(tag, index, value, time);
+    if (_socket)
+        _socket->notify(tag, index, value);
+    xSemaphoreGiveRecursive(_lock);
+}
+
+/*
+** Arguments
+*/
+bool IOTHTTP::hasArg(String name)
+{
+    for (int i = 0; i < _current->argCount; ++i)
+    {
+        if (strcmp(_current->args[i].key, name.c_str()) == 0)
+            return true;
+    }
+    return false;
+}
+
+String IOTHTTP::arg(String name)
+{
+    for (int i = 0; i < _current->argCount; ++i)
+    {
+        if (strcmp(_current->args[i].key, name.c_str()) == 0)
+            return String(_current->args[i].value);
+    }
+    return String();
+}
+
+String IOTHTTP::arg(int i)
+{
+    if (i < _current->argCount)
+        return String(_current->args[i].value);
+    return String();
+}
+
+String IOTHTTP::argName(int i)
+{
+    if (i < _current->argCount)
+        return String(_current->args[i].key);
+    return String();
+}
+
+/*
+** Headers
+*/
+int IOTHTTP::headerId(const char *name)
+{
+    size_t len = strlen(name);
+
+    return _headerFind(name, len, _headerHash(name, len));
+}
+
+const char *IOTHTTP::headerValue(int id)
+{
+    if (id < 0 || id >= _headerKeysCount)
+        return "";
+    return _current->parser.str(_currentHeaders[id].value);
+}
+
+/*
+** Track more request headers, adding to those already collected
+*/
+void IOTHTTP::collectHeaders(const char *headerKeys[], const size_t headerKeysCount)
+{
+    xSemaphoreTakeRecursive(_lock, portMAX_DELAY);
+    for (size_t i = 0; i < headerKeysCount; i++)
+    {
+        if (!_headerTrack(headerKeys[i]))
+            ESP_LOGE(_tag, "Too Many Headers, %s Not Collected", headerKeys[i]);
+    }
+    xSemaphoreGiveRecursive(_lock);
+}
+
+String IOTHTTP::header(int i)
+{
+    if (i >= 0 && i < _headerKeysCount)
+        return String(_current->parser.str(_currentHeaders[i].value));
+    return String();
+}
+
+String IOTHTTP::headerName(int i)
+{
+    if (i >= 0 && i < _headerKeysCount)
+        return _currentHeaders[i].key;
+    return String();
+}
+
+void IOTHTTP::_prepareHeader(int code, const char *content_type, size_t contentLength)
+{
+    // A second response to the same request starts over
+    if (_current->responded)
+        _current->response.begin();
+
+    if (!content_type)
+        content_type = MIME_TYPE_HTML;
+
+    char value[48]; // room for the longest Keep-Alive
+
+    // These never carry a body, so have no type or length to describe
+    bool body = (code != 101 && code != 204 && code != 304);
+
+    if (body)
+        sendHeader("Content-Type", content_type, true);
+
+    if (!body)
+    {
+        // Nothing follows the headers, whatever the length was set to
+    }
+    else if (_current->contentLength == CONTENT_LENGTH_NOT_SET)
+    {
+        snprintf(value, sizeof(value), "%u", (unsigned)contentLength);
+        sendHeader("Content-Length", value);
+    }
+    else if (_current->contentLength != CONTENT_LENGTH_UNKNOWN)
+    {
+        snprintf(value, sizeof(value), "%u", (unsigned)_current->contentLength);
+        sendHeader("Content-Length", value);
+    }
+    else if (_current->contentLength == CONTENT_LENGTH_UNKNOWN && _currentVersion && !_current->detached)
+    { //HTTP/1.1 or above client
+        //let's do chunked
+        _current->chunked = true;
+        sendHeader("Accept-Ranges", "none");
+        sendHeader("Transfer-Encoding", "chunked");
+    }
+    else
+    { //HTTP/1.0 client, the end of the body is marked by closing
+        _current->keepAlive = false;
+    }
+
+    if (code == 101)
+    {
+        // The handler names the protocol being switched to
+    }
+    else if (_current->keepAlive)
+    {
+        snprintf(value, sizeof(value), "timeout=%lu, max=%u",
+                 _keepAliveWait / 1000, (unsigned)(_keepAliveMax - _current->requests - 1));
+        sendHeader("Connection", "keep-alive");
+        sendHeader("Keep-Alive", value);
+    }
+    else
+        sendHeader("Connection", "close");
+
+    _current->responded = true;
+    _current->response.status(_currentVersion, code);
+}
+
+/*
+** Senders
+*/
+void IOTHTTP::sendHeader(const String &name, const String &value, bool first)
+{
+    sendHeader(name.c_str(), value.c_str(), first);
+}
+
+void IOTHTTP::sendHeader(const char *name, const char *value, bool first)
+{
+    if (!_current->response.header(name, value, first))
+        ESP_LOGW(_tag, "Response header dropped: %s", name);
+}
+
+void IOTHTTP::sendContent(const String &content)
+{
+    size_t len = content.length();
+
+    // Held until the buffer fills or the handler returns
+    if (!_current->chunked)
+        _current->response.write(_current->client, content.c_str(), len);
+    else if (len)
+        _current->response.writeChunked(_current->client, content.c_str(), len);
+    else
+    { // Zero length chunk ends the body
+        _current->chunked = false;
+        _current->response.lastChunk(_current->client);
+    }
+}
+
+bool IOTHTTP::send(int code, char *content_type, const String &content)
+{
+    return send(code, (const char *)content_type, content);
 }
 
 bool IOTHTTP::send(int code, const String &content_type, const String &content)
@@ -475,793 +1172,925 @@ bool IOTHTTP::send(int code, const String &content_type, const String &content)
 
 bool IOTHTTP::send(int code, const char *content_type, const String &content)
 {
-    String header;
-
     // Can we asume the following?
-    //if(code == 200 && content.length() == 0 && _contentLength == CONTENT_LENGTH_NOT_SET)
-    //  _contentLength = CONTENT_LENGTH_UNKNOWN;
-    _prepareHeader(header, code, content_type, content.length());
-    _currentClient.write(header.c_str(), header.length());
+    //if(code == 200 && content.length() == 0 && _current->contentLength == CONTENT_LENGTH_NOT_SET)
+    //  _current->contentLength = CONTENT_LENGTH_UNKNOWN;
+    _prepareHeader(code, content_type, content.length());
 
-    if (content.length())
+    // Headers and body leave together when they fit, a longer body is
+    // copied and sent as the socket drains
+    if (content.length() > _current->response.room() && !_current->chunked)
+    {
+        String body(content);
+        size_t done = 0;
+
+        _current->sender = [body, done](HTTPStream &out) mutable {
+            size_t len = body.length() - done;
+
+            if (len > out.room())
+                len = out.room();
+            done += out.write((const uint8_t *)body.c_str() + done, len);
+            return done < body.length();
+        };
+    }
+    else if (content.length())
         sendContent(content);
 
     ESP_LOGD(_tag, "Served (%s %d %s %s): %s:%d",
-             _methodToString(_currentMethod).c_str(), code, _responseCodeToString(code).c_str(),
-             _currentUri.c_str(), _currentClient.remoteIP().toString().c_str(), _currentClient.remotePort());
+             HTTPResponse::methodName(_currentMethod), code, HTTPResponse::statusText(code),
+             _currentUri.c_str(), _current->client.remoteIP().toString().c_str(), _current->client.remotePort());
     
     return true;
 }
 
 /*
-** Internal Handlers
+** File Response, a Range header asks for one or more parts of the file
 */
-void IOTHTTP::_handleRequest()
+size_t IOTHTTP::streamFile(File &file, const String &contentType, const char *etag)
 {
-    bool handled = false;
+    RequestRange ranges[HTTP_MAX_RANGES];
+    size_t size = file.size();
+    int count = 0;
+    char value[64];
+
+    if (String(file.name()).endsWith(".gz") &&
+        contentType != MIME_TYPE_GZIP &&
+        contentType != MIME_TYPE_DATA)
+    {
+        sendHeader("Content-Encoding", "gzip");
+    }
+    if (etag)
+        sendHeader("ETag", etag);
+    sendHeader("Accept-Ranges", "bytes");
 
-    if (!_currentHandler)
+    // A Range made against some other version of the file gets all of this one
+    if (hasHeader(HTTP_HEADER_RANGE) &&
+        (!hasHeader(HTTP_HEADER_IF_RANGE) || (etag && strcmp(headerValue(HTTP_HEADER_IF_RANGE), etag) == 0)))
+        count = _parseRange(headerValue(HTTP_HEADER_RANGE), size, ranges);
+
+    if (count < 0)
     {
-        ESP_LOGV(_tag, "Request handler not found: %s", _currentUri.c_str());
+        snprintf(value, sizeof(value), "bytes */%u", (unsigned)size);
+        sendHeader("Content-Range", value);
+        send(416);
+        return 0;
+    }
+
+    // The parts are sent as the socket drains, each preceded by its own
+    // headers when there are several
+    struct
+    {
+        File file;
+        RequestRange ranges[HTTP_MAX_RANGES];
+        int count;
+        int part;
+        size_t done;
+        bool head;
+        char boundary[20];
+        String type;
+        size_t size;
+    } state;
+    size_t length = 0;
+
+    state.file = file;
+    state.part = 0;
+    state.done = 0;
+    state.head = false;
+    state.boundary[0] = '\0';
+    state.type = contentType;
+    state.size = size;
+
+    if (count == 0)
+    {
+        state.ranges[0] = {0, size};
+        state.count = 1;
+        length = size;
+        setContentLength(length);
+        _prepareHeader(200, contentType.c_str(), 0);
+    }
+    else if (count == 1)
+    {
+        state.ranges[0] = ranges[0];
+        state.count = 1;
+        length = ranges[0].len;
+        snprintf(value, sizeof(value), "bytes %u-%u/%u",
+                 (unsigned)ranges[0].first, (unsigned)(ranges[0].first + ranges[0].len - 1), (unsigned)size);
+        sendHeader("Content-Range", value);
+        setContentLength(length);
+        _prepareHeader(206, contentType.c_str(), 0);
     }
     else
     {
-        handled = _currentHandler->httpHandle(*this, _currentMethod, _currentUri);
-
-        if (!handled)
+        // The length covers every part's headers
+        snprintf(state.boundary, sizeof(state.boundary), "IOTRANGE%08x", esp_random());
+        for (int r = 0; r < count; r++)
         {
-            ESP_LOGV(_tag, "Request handler failed to handle request");
+            state.ranges[r] = ranges[r];
+            length += snprintf(NULL, 0, _partFormat, state.boundary, contentType.c_str(),
+                               (unsigned)ranges[r].first, (unsigned)(ranges[r].first + ranges[r].len - 1), (unsigned)size);
+            length += ranges[r].len;
         }
+        length += snprintf(NULL, 0, _endFormat, state.boundary);
+        state.count = count;
+
+        snprintf(value, sizeof(value), "multipart/byteranges; boundary=%s", state.boundary);
+        setContentLength(length);
+        _prepareHeader(206, value, 0);
     }
 
-    if (!handled)
+    _current->sender = [state](HTTPStream &out) mutable {
+        char part[160];
+        bool multipart = state.boundary[0];
+
+        while (state.part < state.count)
+        {
+            const RequestRange &range = state.ranges[state.part];
+
+            if (multipart && !state.head)
+            {
+                size_t partLen = snprintf(part, sizeof(part), _partFormat, state.boundary, state.type.c_str(),
+                                          (unsigned)range.first, (unsigned)(range.first + range.len - 1), (unsigned)state.size);
+
+                if (out.room() < partLen)
+                    return true;
+                out.write((const uint8_t *)part, partLen);
+                state.head = true;
+            }
+
+            if (state.done < range.len)
+            {
+                if (!out.room())
+                    return true;
+
+                size_t sent = _sendFileRange(out, state.file, range.first + state.done, range.len - state.done);
+
+                // The length promised can't be kept, only a close ends the response now
+                if (!sent)
+                {
+                    state.file.close();
+                    out.close();
+                    return false;
+                }
+                state.done += sent;
+                if (state.done < range.len)
+                    return true;
+            }
+
+            state.part++;
+            state.done = 0;
+            state.head = false;
+        }
+
+        if (multipart)
+        {
+            size_t endLen = snprintf(part, sizeof(part), _endFormat, state.boundary);
+
+            if (out.room() < endLen)
+                return true;
+            out.write((const uint8_t *)part, endLen);
+        }
+        state.file.close();
+        return false;
+    };
+
+    ESP_LOGD(_tag, "Serving (%s %d ranges %u/%u bytes %s): %s:%d",
+             HTTPResponse::methodName(_currentMethod), count, (unsigned)length, (unsigned)size,
+             _currentUri.c_str(), _current->client.remoteIP().toString().c_str(), _current->client.remotePort());
+    return length;
+}
+
+/*
+** As much of a range as fits without waiting, zero if the file fails
+*/
+size_t IOTHTTP::_sendFileRange(HTTPStream &out, File &file, size_t first, size_t len)
+{
+    char buf[HTTP_DOWNLOAD_UNIT_SIZE];
+    size_t want = out.room();
+
+    if (want > len)
+        want = len;
+    if (want > sizeof(buf))
+        want = sizeof(buf);
+
+    if (!want || (file.position() != first && !file.seek(first, SeekSet)))
+        return 0;
+
+    int got = file.read((uint8_t *)buf, want);
+
+    if (got <= 0)
+        return 0;
+    return out.write((const uint8_t *)buf, got);
+}
+
+/*
+** Range: bytes=0-99,200-,-50, returns the number of parts wanted, 0 to
+** ignore the header and -1 when none of the parts lie within the file
+*/
+int IOTHTTP::_parseRange(const char *spec, size_t size, RequestRange *ranges)
+{
+    int count = 0;
+    int parts = 0;
+
+    if (strncmp(spec, "bytes=", 6) != 0)
+        return 0;
+    spec += 6;
+
+    while (*spec)
     {
-        if (_404Handler)
+        unsigned long first, last;
+        char *end;
+
+        while (*spec == ' ')
+            spec++;
+
+        if (*spec == '-')
         {
-            _404Handler(*this);
+            // Suffix, the last so many bytes
+            unsigned long suffix = strtoul(spec + 1, &end, 10);
+
+            if (end == spec + 1)
+                return 0;
+            first = (!suffix) ? size : (suffix < size) ? size - suffix : 0;
+            last = size - 1;
         }
         else
         {
-            send(404, MIME_TYPE_TEXT, String("Not found: ") + _currentUri);
+            first = strtoul(spec, &end, 10);
+            if (end == spec || *end != '-')
+                return 0;
+            spec = end + 1;
+            last = strtoul(spec, &end, 10);
+            if (end == spec)
+                last = size - 1;
+            else if (last < first)
+                return 0;
         }
-    }
 
-    _currentUri = String();
-}
-
-String IOTHTTP::_methodToString(int method)
-{
-    switch (method)
-    {
-    case HTTP_POST:
-        return "POST";
-    case HTTP_GET:
-        return "GET";
-    case HTTP_PUT:
-        return "PUT";
-    case HTTP_PATCH:
-        return "PATCH";
-    case HTTP_DELETE:
-        return "DELETE";
-    case HTTP_OPTIONS:
-        return "OPTIONS";
-    default:
-        return "unknown";
-    }
-}
-
-String IOTHTTP::_responseCodeToString(int code)
-{
-    switch (code)
-    {
-    case 100:
-        return F("Continue");
-    case 101:
-        return F("Switching Protocols");
-    case 200:
-        return F("OK");
-    case 201:
-        return F("Created");
-    case 202:
-        return F("Accepted");
-    case 203:
-        return F("Non-Authoritative Information");
-    case 204:
-        return F("No Content");
-    case 205:
-        return F("Reset Content");
-    case 206:
-        return F("Partial Content");
-    case 300:
-        return F("Multiple Choices");
-    case 301:
-        return F("Moved Permanently");
-    case 302:
-        return F("Found");
-    case 303:
-        return F("See Other");
-    case 304:
-        return F("Not Modified");
-    case 305:
-        return F("Use Proxy");
-    case 307:
-        return F("Temporary Redirect");
-    case 400:
-        return F("Bad Request");
-    case 401:
-        return F("Unauthorized");
-    case 402:
-        return F("Payment Required");
-    case 403:
-        return F("Forbidden");
-    case 404:
-        return F("Not Found");
-    case 405:
-        return F("Method Not Allowed");
-    case 406:
-        return F("Not Acceptable");
-    case 407:
-        return F("Proxy Authentication Required");
-    case 408:
-        return F("Request Time-out");
-    case 409:
-        return F("Conflict");
-    case 410:
-        return F("Gone");
-    case 411:
-        return F("Length Required");
-    case 412:
-        return F("Precondition Failed");
-    case 413:
-        return F("Request Entity Too Large");
-    case 414:
-        return F("Request-URI Too Large");
-    case 415:
-        return F("Unsupported Media Type");
-    case 416:
-        return F("Requested range not satisfiable");
-    case 417:
-        return F("Expectation Failed");
-    case 500:
-        return F("Internal Server Error");
-    case 501:
-        return F("Not Implemented");
-    case 502:
-        return F("Bad Gateway");
-    case 503:
-        return F("Service Unavailable");
-    case 504:
-        return F("Gateway Time-out");
-    case 505:
-        return F("HTTP Version not supported");
-    default:
-        return "";
+        spec = end;
+        while (*spec == ' ')
+            spec++;
+        if (*spec == ',')
+            spec++;
+        else if (*spec)
+            return 0;
+        parts++;
+
+        if (first >= size)
+            continue;
+        if (last >= size)
+            last = size - 1;
+
+        // Too many parts is more likely abuse than a resume, send the lot
+        if (count == HTTP_MAX_RANGES)
+            return 0;
+        ranges[count++] = {first, last - first + 1};
     }
+
+    if (!parts)
+        return 0;
+    return (count) ? count : -1;
 }
 
 /*
-** Parsers
+** Hand the connection over to the handler, after the headers for a body
+** that runs until it is closed
 */
-static char *readBytesWithTimeout(WiFiClient &client, size_t maxLength, size_t &dataLength, int timeout_ms)
+WiFiClient IOTHTTP::sendDetached(int code, const char *content_type)
 {
-    char *buf = nullptr;
-    dataLength = 0;
-    while (dataLength < maxLength)
+    _current->detached = true;
+    _current->contentLength = CONTENT_LENGTH_UNKNOWN;
+    _prepareHeader(code, content_type, 0);
+    _current->response.flush(_current->client);
+
+    ESP_LOGD(_tag, "Detached (%s %d %s %s): %s:%d",
+             HTTPResponse::methodName(_currentMethod), code, HTTPResponse::statusText(code),
+             _currentUri.c_str(), _current->client.remoteIP().toString().c_str(), _current->client.remotePort());
+
+    return _current->client;
+}
+
+/*
+** Streamed Response, the headers wait to leave with the first chunk
+*/
+HTTPStream IOTHTTP::sendStream(int code, const char *content_type)
+{
+    _current->contentLength = CONTENT_LENGTH_UNKNOWN;
+    _prepareHeader(code, content_type, 0);
+
+    ESP_LOGD(_tag, "Streaming (%s %d %s %s): %s:%d",
+             HTTPResponse::methodName(_currentMethod), code, HTTPResponse::statusText(code),
+             _currentUri.c_str(), _current->client.remoteIP().toString().c_str(), _current->client.remotePort());
+
+    return HTTPStream(*_current);
+}
+
+/*
+** Streamed Response, the sender is called for more as the socket drains
+*/
+void IOTHTTP::sendStream(int code, const char *content_type, HTTPSender sender)
+{
+    _current->contentLength = CONTENT_LENGTH_UNKNOWN;
+    _prepareHeader(code, content_type, 0);
+    _current->sender = sender;
+
+    ESP_LOGD(_tag, "Streaming (%s %d %s %s): %s:%d",
+             HTTPResponse::methodName(_currentMethod), code, HTTPResponse::statusText(code),
+             _currentUri.c_str(), _current->client.remoteIP().toString().c_str(), _current->client.remotePort());
+}
+
+/*
+** Internal Handlers
+*/
+void IOTHTTP::_handleRequest()
+{
+    bool handled = false;
+
+    if (!_currentHandler)
     {
-        int tries = timeout_ms;
-        size_t newLength;
-        while (!(newLength = client.available()) && tries--)
-            delay(1);
+        ESP_LOGV(_tag, "Request handler not found: %s", _currentUri.c_str());
+    }
+    else
+    {
+        handled = _currentHandler->httpHandle(*this, _currentMethod, _currentUri);
 
-        if (!newLength)
+        if (!handled)
         {
-            break;
+            ESP_LOGV(_tag, "Request handler failed to handle request");
         }
-        if (!buf)
+    }
+
+    if (!handled)
+    {
+        if (_404Handler)
         {
-            buf = (char *)malloc(newLength + 1);
-            if (!buf)
-            {
-                return nullptr;
-            }
+            _404Handler(*this);
         }
         else
-        {
-            char *newBuf = (char *)realloc(buf, dataLength + newLength + 1);
-            if (!newBuf)
-            {
-                free(buf);
-                return nullptr;
-            }
-            buf = newBuf;
+        {
+            send(404, MIME_TYPE_TEXT, String("Not found: ") + _currentUri);
         }
-        client.readBytes(buf + dataLength, newLength);
-        dataLength += newLength;
-        buf[dataLength] = '\0';
     }
-    return buf;
+
 }
 
-bool IOTHTTP::_parseRequest(WiFiClient &client)
+/*
+** Parsers, a request whose body is still arriving is partial and is parsed
+** again on the next pass.  Nothing before the body is read changes the
+** arena, so doing it twice is harmless.
+*/
+HTTPParseStatus IOTHTTP::_parseRequest(WiFiClient &client)
 {
-    // Read the first line of HTTP request
-    // Handle bad apps who only send LF!
-    String req = client.readStringUntil('\n');
-    if (req[req.length() - 1] == '\r')
-    {
-        req.trim();
-    }
+    HTTPBodyStream body(_current->parser, client);
 
     // reset header value
     for (int i = 0; i < _headerKeysCount; ++i)
     {
-        _currentHeaders[i].value = String();
-    }
-
-    // First line of HTTP request looks like "GET /path HTTP/1.1"
-    // Retrieve the "/path" part by finding the spaces
-    int addr_start = req.indexOf(' ');
-    int addr_end = req.indexOf(' ', addr_start + 1);
-
-    if (addr_start == -1 || addr_end == -1)
-    {
-        ESP_LOGD(_tag, "Invalid Request: %s", req.c_str());
-        return false;
+        _currentHeaders[i].value = {0, 0};
     }
 
-    String methodStr = req.substring(0, addr_start);
-    String url = req.substring(addr_start + 1, addr_end);
-    String versionEnd = req.substring(addr_end + 8);
-    _currentVersion = atoi(versionEnd.c_str());
-    String searchStr = "";
-    int hasSearch = url.indexOf('?');
+    // Request line was split by the parser, "GET /path?search HTTP/1.1"
+    const HTTPSlice &version = _current->parser.version();
 
-    if (hasSearch != -1)
+    if (version.len < 8 || strncmp(_current->parser.str(version), "HTTP/1.", 7) != 0)
     {
-        searchStr = urlDecode(url.substring(hasSearch + 1));
-        url = url.substring(0, hasSearch);
+        ESP_LOGD(_tag, "Invalid Request: %s %s", _current->parser.str(_current->parser.method()), _current->parser.str(_current->parser.uri()));
+        return HP_ERROR;
     }
 
-    _currentUri = url;
-    _chunked = false;
+    _currentVersion = atoi(_current->parser.str(version) + 7);
+    _currentUri = _current->parser.str(_current->parser.uri());
+    _current->chunked = false;
 
     HTTPMethod method = HTTP_GET;
-    if (methodStr == "POST")
-    {
-        method = HTTP_POST;
-    }
-    else if (methodStr == "DELETE")
-    {
-        method = HTTP_DELETE;
-    }
-    else if (methodStr == "OPTIONS")
+    for (int m = HTTP_GET; m <= HTTP_OPTIONS; m++)
     {
-        method = HTTP_OPTIONS;
-    }
-    else if (methodStr == "PUT")
-    {
-        method = HTTP_PUT;
-    }
-    else if (methodStr == "PATCH")
-    {
-        method = HTTP_PATCH;
+        if (_current->parser.equals(_current->parser.method(), HTTPResponse::methodName(m)))
+        {
+            method = (HTTPMethod)m;
+            break;
+        }
     }
     _currentMethod = method;
 
-    ESP_LOGD(_tag, "Method: %s URL: %s Search: %s", methodStr.c_str(), url.c_str(), searchStr.c_str());
-
     // Attach handler
-    HTTPHandler *handler;
+    _currentHandler = _router.find(_currentMethod, _currentUri);
 
-    for (handler = _firstHandler; handler; handler = handler->nextHandler())
+    uint32_t contentLength = 0;
+    bool keepAlive = (_currentVersion > 0);
+
+    // Headers were split by the parser, keep those tracked by their ID
+    for (uint8_t h = 0; h < _current->parser.headers(); h++)
     {
-        if (handler->httpCanHandle(_currentMethod, _currentUri))
-            break;
-    }
-    _currentHandler = handler;
+        const HTTPHeaderSlice &hdr = _current->parser.header(h);
+        const char *headerName = _current->parser.str(hdr.name);
+        int id = _headerFind(headerName, hdr.name.len, _headerHash(headerName, hdr.name.len));
 
-    String formData;
+        ESP_LOGV(_tag, "Header: %s = %s", headerName, _current->parser.str(hdr.value));
 
-    // Below is needed only when POST type request
-    if (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE)
-    {
-        String boundaryStr;
-        String headerName;
-        String headerValue;
-        bool isForm = false;
-        bool isEncoded = false;
-        uint32_t contentLength = 0;
+        if (id < 0)
+            continue;
+        _currentHeaders[id].value = hdr.value;
 
-        // Parse headers
-        while (1)
+        if (id == HTTP_HEADER_CONTENT_LENGTH)
         {
-            // Handle bad apps who only send LF!
-            String req = client.readStringUntil('\n');
-            if (req[req.length() - 1] == '\r')
-            {
-                req.trim();
-            }
-
-            if (req == "")
-                break; //no more headers
+            contentLength = strtoul(_current->parser.str(hdr.value), NULL, 10);
+        }
+        else if (id == HTTP_HEADER_CONNECTION)
+        {
+            const char *value = _current->parser.str(hdr.value);
 
-            int headerDiv = req.indexOf(':');
+            if (strncasecmp(value, "close", 5) == 0)
+                keepAlive = false;
+            else if (strncasecmp(value, "keep-alive", 10) == 0)
+                keepAlive = true;
+        }
+    }
 
-            if (headerDiv == -1)
-            {
-                break;
-            }
+    // A length that may have been dropped, or framing not read here, would
+    // leave the body to be taken as the next request, so refuse and close
+    if (_current->parser.overflowed())
+    {
+        ESP_LOGW(_tag, "Too many headers: %s", _currentUri.c_str());
+        _current->keepAlive = false;
+        send(431, MIME_TYPE_TEXT, "Too many headers");
+        return HP_ERROR;
+    }
 
-            headerName = req.substring(0, headerDiv);
-            headerValue = req.substring(headerDiv + 1);
-            headerValue.trim();
-            _collectHeader(headerName.c_str(), headerValue.c_str());
+    if (_currentHeaders[HTTP_HEADER_TRANSFER_ENCODING].value.len)
+    {
+        ESP_LOGW(_tag, "Transfer-Encoding not supported: %s", headerValue(HTTP_HEADER_TRANSFER_ENCODING));
+        _current->keepAlive = false;
+        send(501, MIME_TYPE_TEXT, "Transfer-Encoding not supported");
+        return HP_ERROR;
+    }
 
-            ESP_LOGV(_tag, "Header: %s = %s", headerName.c_str(), headerValue.c_str());
+    const char *contentType = headerValue(HTTP_HEADER_CONTENT_TYPE);
 
-            if (headerName.equalsIgnoreCase("Content-Type"))
-            {
-                if (headerValue.startsWith("text/plain"))
-                {
-                    isForm = false;
-                }
-                else if (headerValue.startsWith("application/x-www-form-urlencoded"))
-                {
-                    isForm = false;
-                    isEncoded = true;
-                }
-                else if (headerValue.startsWith("multipart/"))
-                {
-                    boundaryStr = headerValue.substring(headerValue.indexOf('=') + 1);
-                    isForm = true;
-                }
-            }
-            else if (headerName.equalsIgnoreCase("Content-Length"))
-            {
-                contentLength = headerValue.toInt();
-            }
-            else if (headerName.equalsIgnoreCase("Host"))
-            {
-                _hostHeader = headerValue;
-            }
-        }
+    // HTTP/1.1 clients persist unless they ask otherwise, HTTP/1.0 must ask
+    _current->keepAlive = keepAlive && _keepAliveWait && (_current->requests + 1 < _keepAliveMax);
 
-        if (!isForm)
+    // Below is needed only when POST type request
+    bool hasBody = (method == HTTP_POST || method == HTTP_PUT || method == HTTP_PATCH || method == HTTP_DELETE);
+    bool isForm = hasBody && strncmp(contentType, "multipart/", 10) == 0;
+    bool isEncoded = hasBody && strncmp(contentType, "application/x-www-form-urlencoded", 33) == 0;
+    bool isStream = hasBody && !isForm && _currentHandler && _currentHandler->httpCanStream(_currentUri);
+    bool isPlain = hasBody && !isForm && !isStream;
+
+    // A body held whole is read as it arrives, the slot waits for the rest
+    if (isPlain)
+    {
+        if (contentLength > HTTP_MAX_BODY_SIZE)
         {
-            size_t plainLength;
-            char *plainBuf = readBytesWithTimeout(client, contentLength, plainLength, HTTP_MAX_POST_WAIT);
+            ESP_LOGW(_tag, "Request body too large: %u", contentLength);
+            _current->keepAlive = false;
+            send(413, MIME_TYPE_TEXT, "Request body too large");
+            return HP_ERROR;
+        }
 
-            if (plainLength < contentLength)
-            {
-                free(plainBuf);
-                return false;
-            }
+        HTTPParseStatus read = _current->parser.fillBody(client, contentLength);
 
-            if (contentLength > 0)
-            {
-                if (searchStr != "")
-                    searchStr += '&';
-                if (isEncoded)
-                {
-                    //url encoded form
-                    String decoded = urlDecode(plainBuf);
-                    size_t decodedLen = decoded.length();
-                    memcpy(plainBuf, decoded.c_str(), decodedLen);
-                    plainBuf[decodedLen] = 0;
-                    searchStr += plainBuf;
-                }
+        if (read != HP_COMPLETE)
+            return read;
+    }
 
-                _parseArguments(searchStr);
+    // Arguments are split and decoded where they lie in the arena, once
+    // however many passes the body takes
+    if (_current->body.stage == HB_NONE)
+    {
+        const HTTPSlice &query = _current->parser.query();
 
-                if (!isEncoded)
-                {
-                    //plain post json or other data
-                    RequestArgument &arg = _currentArgs[_currentArgCount++];
-                    arg.key = "plain";
-                    arg.value = String(plainBuf);
-                }
+        ESP_LOGD(_tag, "Method: %s URL: %s Search: %s", _current->parser.str(_current->parser.method()), _currentUri.c_str(), _current->parser.str(query));
 
-                ESP_LOGV(_tag, "Plain: %s", plainBuf);
+        _current->argCount = 0;
+        if (query.len)
+            _parseArguments(const_cast<char *>(_current->parser.str(query)));
+    }
 
-                free(plainBuf);
-            }
-        }
+    if (isStream)
+    {
+        HTTPParseStatus read = _streamBody(body, contentType, contentLength);
 
-        if (isForm)
-        {
-            _parseArguments(searchStr);
-            if (!_parseForm(client, boundaryStr, contentLength))
-            {
-                return false;
-            }
-        }
+        if (read != HP_COMPLETE)
+            return read;
     }
-    else
+    else if (isPlain)
     {
-        String headerName;
-        String headerValue;
+        char *plain = _current->parser.takeBody(contentLength);
 
-        // Parse headers
-        while (1)
-        {
-            // Handle bad apps who only send LF!
-            String req = client.readStringUntil('\n');
-            if (req[req.length() - 1] == '\r')
-            {
-                req.trim();
-            }
+        if (!plain)
+            return HP_ERROR;
 
-            if (req == "")
-                break; //no moar headers
+        if (contentLength > 0)
+        {
+            ESP_LOGV(_tag, "Plain: %s", plain);
 
-            int headerDiv = req.indexOf(':');
-            if (headerDiv == -1)
+            if (isEncoded)
             {
-                break;
+                //url encoded form
+                _parseArguments(plain);
             }
-
-            headerName = req.substring(0, headerDiv);
-            headerValue = req.substring(headerDiv + 2);
-            _collectHeader(headerName.c_str(), headerValue.c_str());
-
-            ESP_LOGV(_tag, "Header: %s = %s", headerName.c_str(), headerValue.c_str());
-
-            if (headerName.equalsIgnoreCase("Host"))
+            else if (_current->argCount < HTTP_MAX_ARGS)
             {
-                _hostHeader = headerValue;
+                //plain post json or other data
+                HTTPArgument &arg = _current->args[_current->argCount++];
+                arg.key = "plain";
+                arg.value = plain;
             }
         }
-        _parseArguments(searchStr);
     }
+    else if (isForm)
+    {
+        HTTPParseStatus read = _parseForm(client, contentType, contentLength);
 
-    client.flush();
+        if (read != HP_COMPLETE)
+            return read;
+    }
 
     //ESP_LOGV(_tag, "Request: %s Args: %s", url.c_str(), searchStr.c_str());
 
-    return true;
+    return HP_COMPLETE;
 }
 
-bool IOTHTTP::_collectHeader(const char *headerName, const char *headerValue)
+/*
+** Header lookup, open addressing over the hashes of the tracked names
+*/
+int IOTHTTP::_headerFind(const char *name, size_t len, uint32_t hash)
 {
-    for (int i = 0; i < _headerKeysCount; i++)
+    for (uint8_t probe = 0; probe < HTTP_HEADER_TABLE; probe++)
     {
-        if (_currentHeaders[i].key.equalsIgnoreCase(headerName))
-        {
-            _currentHeaders[i].value = headerValue;
-            return true;
-        }
+        int id = _headerTable[(hash + probe) & (HTTP_HEADER_TABLE - 1)];
+
+        if (id < 0)
+            break;
+
+        const RequestHeader &hdr = _currentHeaders[id];
+
+        if (hdr.hash == hash && hdr.key.length() == len && strncasecmp(hdr.key.c_str(), name, len) == 0)
+            return id;
     }
-    return false;
+    return -1;
 }
 
-void IOTHTTP::_parseArguments(String data)
+bool IOTHTTP::_headerTrack(const char *name)
 {
-    ESP_LOGV(_tag, "Args: %s", data.c_str());
+    size_t len = strlen(name);
+    uint32_t hash = _headerHash(name, len);
 
-    if (_currentArgs)
-        delete[] _currentArgs;
-    _currentArgs = 0;
+    if (_headerFind(name, len, hash) >= 0)
+        return true;
+    if (_headerKeysCount == HTTP_MAX_HEADER_KEYS)
+        return false;
 
-    if (data.length() == 0)
-    {
-        _currentArgCount = 0;
-        _currentArgs = new RequestArgument[1];
-        return;
-    }
-    _currentArgCount = 1;
+    uint8_t slot = hash & (HTTP_HEADER_TABLE - 1);
 
-    for (int i = 0; i < (int)data.length();)
-    {
-        i = data.indexOf('&', i);
-        if (i == -1)
-            break;
-        ++i;
-        ++_currentArgCount;
-    }
+    while (_headerTable[slot] >= 0)
+        slot = (slot + 1) & (HTTP_HEADER_TABLE - 1);
 
-    ESP_LOGV(_tag, "Args Count: %d", _currentArgCount);
+    RequestHeader &hdr = _currentHeaders[_headerKeysCount];
 
-    _currentArgs = new RequestArgument[_currentArgCount + 1];
+    hdr.key = name;
+    hdr.hash = hash;
+    hdr.value = {0, 0};
+    _headerTable[slot] = _headerKeysCount++;
+    return true;
+}
 
-    int pos = 0;
-    int iarg;
+void IOTHTTP::_parseArguments(char *data)
+{
+    ESP_LOGV(_tag, "Args: %s", data);
 
-    for (iarg = 0; iarg < _currentArgCount;)
+    while (data && *data)
     {
-        int equal_sign_index = data.indexOf('=', pos);
-        int next_arg_index = data.indexOf('&', pos);
+        char *next = strchr(data, '&');
+        char *value = strchr(data, '=');
 
-        ESP_LOGV(_tag, "Pos: %d =@: %d &@: %d", pos, equal_sign_index, next_arg_index);
+        if (next)
+            *next++ = '\0';
 
-        if ((equal_sign_index == -1) || ((equal_sign_index > next_arg_index) && (next_arg_index != -1)))
+        if (!value || (next && value >= next))
         {
-            ESP_LOGV(_tag, "Arg: %d Missing Value", iarg);
-
-            if (next_arg_index == -1)
-                break;
-            pos = next_arg_index + 1;
-            continue;
+            ESP_LOGV(_tag, "Arg: %d Missing Value", _current->argCount);
         }
+        else if (_current->argCount == HTTP_MAX_ARGS)
+        {
+            ESP_LOGW(_tag, "Too many arguments, ignoring: %s", data);
+            break;
+        }
+        else
+        {
+            *value++ = '\0';
 
-        RequestArgument &arg = _currentArgs[iarg];
-        arg.key = data.substring(pos, equal_sign_index);
-        arg.value = data.substring(equal_sign_index + 1, next_arg_index);
-
-        ESP_LOGV(_tag, "Arg: %d Key: %s = %s", iarg, arg.key.c_str(), arg.value.c_str());
+            HTTPArgument &arg = _current->args[_current->argCount++];
+            arg.key = _urlDecode(data);
+            arg.value = _urlDecode(value);
 
-        ++iarg;
-        if (next_arg_index == -1)
-            break;
-        pos = next_arg_index + 1;
+            ESP_LOGV(_tag, "Arg: %d Key: %s = %s", _current->argCount - 1, arg.key, arg.value);
+        }
+        data = next;
     }
 
-    _currentArgCount = iarg;
-    ESP_LOGV(_tag, "Args Count: %d", _currentArgCount);
+    ESP_LOGV(_tag, "Args Count: %d", _current->argCount);
+}
+
+/*
+** Boyer-Moore-Horspool search for the part delimiter
+*/
+static void _delimiterSkip(const uint8_t *needle, size_t len, uint8_t *skip)
+{
+    memset(skip, len, 256);
+    for (size_t i = 0; i + 1 < len; i++)
+        skip[needle[i]] = len - 1 - i;
 }
 
-void IOTHTTP::_uploadWriteByte(uint8_t b)
+static int _delimiterFind(const uint8_t *data, size_t size, const uint8_t *needle, size_t len, const uint8_t *skip)
 {
-    if (_currentUpload.currentSize == HTTP_UPLOAD_BUFLEN)
+    size_t i = 0;
+
+    while (i + len <= size)
     {
-        if (_currentHandler && _currentHandler->httpCanUpload(_currentUri))
-            _currentHandler->httpUpload(*this, _currentUri, _currentUpload);
-        _currentUpload.totalSize += _currentUpload.currentSize;
-        _currentUpload.currentSize = 0;
+        size_t j = len - 1;
+
+        while (data[i + j] == needle[j])
+        {
+            if (j == 0)
+                return i;
+            j--;
+        }
+        i += skip[data[i + len - 1]];
     }
-    _currentUpload.buf[_currentUpload.currentSize++] = b;
+    return -1;
 }
 
-uint8_t IOTHTTP::_uploadReadByte(WiFiClient &client)
+/*
+** A parameter of a part header, as name in: form-data; name="field"
+*/
+static const char *_partParam(const char *line, const char *param, size_t &valueLen)
 {
-    int res = client.read();
-    if (res == -1)
+    size_t len = strlen(param);
+
+    for (const char *at = strchr(line, ';'); at; at = strchr(at, ';'))
     {
-        while (!client.available() && client.connected())
-            yield();
-        res = client.read();
+        for (at++; *at == ' ' || *at == '\t'; at++)
+            ;
+        if (strncasecmp(at, param, len) != 0 || at[len] != '=')
+            continue;
+
+        const char *value = at + len + 1;
+
+        if (*value == '"')
+            valueLen = strcspn(++value, "\"");
+        else
+            valueLen = strcspn(value, "; \t");
+        return value;
     }
-    return (uint8_t)res;
+    return nullptr;
 }
 
-bool IOTHTTP::_parseForm(WiFiClient &client, String boundary, uint32_t len)
+/*
+** Keep what a part header says of the part, in place behind the headers
+*/
+void IOTHTTP::_parsePartHeader(char *line)
 {
-    (void)len;
+    HTTPBodyState &state = _current->body;
+    HTTPParser &parser = _current->parser;
 
-    ESP_LOGV(_tag, "Parse Form, Boundary: %s Len: %s", boundary.c_str(), len);
+    if (strncasecmp(line, "Content-Disposition:", 20) == 0)
+    {
+        size_t nameLen = 0;
+        size_t fileLen = 0;
+        const char *name = _partParam(line, "name", nameLen);
+        const char *filename = _partParam(line, "filename", fileLen);
+
+        // Kept in the order they lie, so neither is moved over the other
+        if (name && (!filename || name < filename))
+            state.name = parser.bodyKeep(name, nameLen);
+        if (filename)
+            state.filename = parser.bodyKeep(filename, fileLen);
+        if (name && !state.name)
+            state.name = parser.bodyKeep(name, nameLen);
+
+        // Use GET to set the filename if uploading using blob
+        for (int i = 0; state.filename && strcmp(state.filename, "blob") == 0 && i < _current->argCount; i++)
+        {
+            if (strcmp(_current->args[i].key, "filename") == 0)
+                state.filename = _current->args[i].value;
+        }
 
-    String line;
-    int retry = 0;
-    do
+        ESP_LOGV(_tag, "POST Arg, Name: %s File: %s", (state.name) ? state.name : "", (state.filename) ? state.filename : "");
+    }
+    else if (strncasecmp(line, "Content-Type:", 13) == 0)
     {
-        line = client.readStringUntil('\r');
-        ++retry;
-    } while (line.length() == 0 && retry < 3);
+        for (line += 13; *line == ' ' || *line == '\t'; line++)
+            ;
+        state.type = parser.bodyKeep(line, strlen(line));
+        ESP_LOGV(_tag, "POST Arg, Type: %s", state.type);
+    }
+}
+
+/*
+** Take a multipart form a pass at a time.  What has arrived is read into the
+** arena behind the headers and scanned where it lies: a field is held until
+** its delimiter and kept there as an argument, a file is handed on as it
+** arrives less any tail which could start the delimiter.
+*/
+HTTPParseStatus IOTHTTP::_parseForm(WiFiClient &client, const char *contentType, uint32_t len)
+{
+    HTTPBodyState &state = _current->body;
+    HTTPParser &parser = _current->parser;
+    const char *boundary = strchr(contentType, '=');
+    char delimiter[4 + HTTP_BOUNDARY_MAX + 1] = "\r\n--";
+    uint8_t skip[256];
+    size_t boundaryLen;
+
+    boundary = (boundary) ? boundary + 1 : contentType;
+    if (*boundary == '"')
+        boundary++;
+    boundaryLen = strcspn(boundary, "\"; \t");
+    if (!boundaryLen || boundaryLen > HTTP_BOUNDARY_MAX)
+        return HP_ERROR;
+
+    memcpy(&delimiter[4], boundary, boundaryLen);
+    delimiter[4 + boundaryLen] = '\0';
+
+    const uint8_t *needle = (const uint8_t *)delimiter;
+    size_t needleLen = 4 + boundaryLen;
 
-    client.readStringUntil('\n');
+    _delimiterSkip(needle, needleLen, skip);
 
-    // Start reading the form
-    if (line == ("--" + boundary))
+    if (state.stage == HB_NONE)
     {
-        RequestArgument *postArgs = new RequestArgument[32];
-        int postArgsLen = 0;
-        while (1)
+        ESP_LOGV(_tag, "Parse Form, Boundary: %s Len: %u", &delimiter[4], (unsigned)len);
+        _current->handler = _currentHandler;
+        state.stage = HB_PREAMBLE;
+        state.blank = 0;
+    }
+
+    for (int burst = 0; burst < HTTP_BODY_BURST;)
+    {
+        size_t held = parser.bodyAvailable();
+
+        if (held > len - state.taken)
+            held = len - state.taken;
+
+        char *data = parser.bodyData();
+        char *eol = (char *)memchr(data, '\n', held);
+        size_t used = 0;
+        int at;
+
+        switch (state.stage)
         {
-            String argName;
-            String argValue;
-            String argType;
-            String argFilename;
-            bool argIsFile = false;
-
-            line = client.readStringUntil('\r');
-            client.readStringUntil('\n');
-            if (line.length() > 19 && line.substring(0, 19).equalsIgnoreCase("Content-Disposition"))
+        case HB_PREAMBLE:
+        case HB_HEADERS:
+            if (!eol)
+                break;
+
+            used = eol + 1 - data;
+            if (eol > data && eol[-1] == '\r')
+                eol--;
+            *eol = '\0';
+
+            if (state.stage == HB_PREAMBLE)
             {
-                int nameStart = line.indexOf('=');
-                if (nameStart != -1)
+                if (!*data && state.blank < 2)
+                    state.blank++;
+                else if (strcmp(data, &delimiter[2]) == 0)
+                {
+                    state.stage = HB_HEADERS;
+                    state.name = state.filename = nullptr;
+                    state.type = MIME_TYPE_TEXT;
+                }
+                else
                 {
-                    argName = line.substring(nameStart + 2);
-                    nameStart = argName.indexOf('=');
-                    if (nameStart == -1)
-                    {
-                        argName = argName.substring(0, argName.length() - 1);
-                    }
-                    else
-                    {
-                        argFilename = argName.substring(nameStart + 2, argName.length() - 1);
-                        argName = argName.substring(0, argName.indexOf('"'));
-                        argIsFile = true;
-
-                        ESP_LOGV(_tag, "POST Arg, File: %s", argFilename.c_str());
-
-                        // Use GET to set the filename if uploading using blob
-                        if (argFilename == "blob" && hasArg("filename"))
-                            argFilename = arg("filename");
-                    }
-
-                    ESP_LOGV(_tag, "POST Arg, Name: %s", argName.c_str());
-
-                    argType = MIME_TYPE_TEXT;
-                    line = client.readStringUntil('\r');
-                    client.readStringUntil('\n');
-                    if (line.length() > 12 && line.substring(0, 12).equalsIgnoreCase("Content-Type"))
-                    {
-                        argType = line.substring(line.indexOf(':') + 2);
-
-                        // Skip next line
-                        client.readStringUntil('\r');
-                        client.readStringUntil('\n');
-                    }
-
-                    ESP_LOGV(_tag, "POST Arg, Type: %s", argType.c_str());
-
-                    if (!argIsFile)
-                    {
-                        while (1)
-                        {
-                            line = client.readStringUntil('\r');
-                            client.readStringUntil('\n');
-                            if (line.startsWith("--" + boundary))
-                                break;
-                            if (argValue.length() > 0)
-                                argValue += "\n";
-                            argValue += line;
-                        }
-
-                        ESP_LOGV(_tag, "POST Arg, Value: %s", argValue.c_str());
-
-                        RequestArgument &arg = postArgs[postArgsLen++];
-                        arg.key = argName;
-                        arg.value = argValue;
-
-                        if (line == ("--" + boundary + "--"))
-                        {
-                            ESP_LOGV(_tag, "POST: Parsing Done");
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        _currentUpload.status = UPLOAD_FILE_START;
-                        _currentUpload.name = argName;
-                        _currentUpload.filename = argFilename;
-                        _currentUpload.type = argType;
-                        _currentUpload.totalSize = 0;
-                        _currentUpload.currentSize = 0;
-
-                        ESP_LOGV(_tag, "Start File: %s Type: %s", _currentUpload.filename.c_str(), _currentUpload.type.c_str());
-
-                        if (_currentHandler && _currentHandler->httpCanUpload(_currentUri))
-                            _currentHandler->httpUpload(*this, _currentUri, _currentUpload);
-
-                        _currentUpload.status = UPLOAD_FILE_WRITE;
-                        uint8_t argByte = _uploadReadByte(client);
-
-                    readfile:
-                        while (argByte != 0x0D)
-                        {
-                            if (!client.connected())
-                                return _parseFormUploadAborted();
-                            _uploadWriteByte(argByte);
-                            argByte = _uploadReadByte(client);
-                        }
-
-                        argByte = _uploadReadByte(client);
-
-                        if (!client.connected())
-                            return _parseFormUploadAborted();
-
-                        if (argByte == 0x0A)
-                        {
-                            argByte = _uploadReadByte(client);
-
-                            if (!client.connected())
-                                return _parseFormUploadAborted();
-
-                            if ((char)argByte != '-')
-                            {
-                                //continue reading the file
-                                _uploadWriteByte(0x0D);
-                                _uploadWriteByte(0x0A);
-                                goto readfile;
-                            }
-                            else
-                            {
-                                argByte = _uploadReadByte(client);
-                                if (!client.connected())
-                                    return _parseFormUploadAborted();
-                                if ((char)argByte != '-')
-                                {
-                                    //continue reading the file
-                                    _uploadWriteByte(0x0D);
-                                    _uploadWriteByte(0x0A);
-                                    _uploadWriteByte((uint8_t)('-'));
-                                    goto readfile;
-                                }
-                            }
-
-                            uint8_t endBuf[boundary.length()];
-                            client.readBytes(endBuf, boundary.length());
-
-                            if (strstr((const char *)endBuf, boundary.c_str()) != NULL)
-                            {
-                                if (_currentHandler && _currentHandler->httpCanUpload(_currentUri))
-                                    _currentHandler->httpUpload(*this, _currentUri, _currentUpload);
-
-                                _currentUpload.totalSize += _currentUpload.currentSize;
-                                _currentUpload.status = UPLOAD_FILE_END;
-
-                                if (_currentHandler && _currentHandler->httpCanUpload(_currentUri))
-                                    _currentHandler->httpUpload(*this, _currentUri, _currentUpload);
-
-                                ESP_LOGV(_tag, "End File: %s Type: %s Size: %d",
-                                         _currentUpload.filename.c_str(), _currentUpload.type.c_str(), _currentUpload.totalSize);
-
-                                line = client.readStringUntil(0x0D);
-                                client.readStringUntil(0x0A);
-                                if (line == "--")
-                                {
-                                    ESP_LOGV(_tag, "POST: Parsing Done");
-                                    break;
-                                }
-                                continue;
-                            }
-                            else
-                            {
-                                _uploadWriteByte(0x0D);
-                                _uploadWriteByte(0x0A);
-                                _uploadWriteByte((uint8_t)('-'));
-                                _uploadWriteByte((uint8_t)('-'));
-                                uint32_t i = 0;
-                                while (i < boundary.length())
-                                {
-                                    _uploadWriteByte(endBuf[i++]);
-                                }
-                                argByte = _uploadReadByte(client);
-                                goto readfile;
-                            }
-                        }
-                        else
-                        {
-                            _uploadWriteByte(0x0D);
-                            goto readfile;
-                        }
-                        break;
-                    }
+                    ESP_LOGV(_tag, "ERROR-Line: %s", data);
+                    return HP_ERROR;
                 }
             }
-        }
+            else if (*data)
+                _parsePartHeader(data);
+            else if (state.filename)
+            {
+                ESP_LOGV(_tag, "Start File: %s Type: %s", state.filename, state.type);
+                state.part = 0;
+                state.stage = HB_FILE;
+                _uploadCall(UPLOAD_FILE_START, 0, 0);
+            }
+            else
+                state.stage = HB_FIELD;
+            break;
 
-        int iarg;
-        int totalArgs = ((32 - postArgsLen) < _currentArgCount) ? (32 - postArgsLen) : _currentArgCount;
+        case HB_FIELD:
+            if ((at = _delimiterFind((const uint8_t *)data, held, needle, needleLen, skip)) < 0)
+                break;
 
-        for (iarg = 0; iarg < totalArgs; iarg++)
-        {
-            RequestArgument &arg = postArgs[postArgsLen++];
-            arg.key = _currentArgs[iarg].key;
-            arg.value = _currentArgs[iarg].value;
+            // Field values live in the arena with the query arguments
+            if (_current->argCount < HTTP_MAX_ARGS)
+            {
+                HTTPArgument &arg = _current->args[_current->argCount++];
+
+                arg.key = (state.name) ? state.name : "";
+                arg.value = parser.bodyKeep(data, at);
+                ESP_LOGV(_tag, "POST Arg, Value: %s", arg.value);
+            }
+            else
+                ESP_LOGW(_tag, "POST Arg dropped: %s", (state.name) ? state.name : "");
+            used = at + needleLen;
+            state.stage = HB_NEXT;
+            break;
+
+        case HB_FILE:
+            at = _delimiterFind((const uint8_t *)data, held, needle, needleLen, skip);
+            used = (at >= 0) ? at : held;
+
+            // Hold back from a CR near the end, it may start the delimiter
+            for (size_t i = (held >= needleLen) ? held - needleLen + 1 : 0; at < 0 && i < held; i++)
+            {
+                if (data[i] == '\r')
+                {
+                    used = i;
+                    break;
+                }
+            }
+
+            for (size_t sent = 0; sent < used;)
+            {
+                size_t block = (used - sent < HTTP_UPLOAD_BUFLEN) ? used - sent : HTTP_UPLOAD_BUFLEN;
+
+                memcpy(_currentUpload.buf, &data[sent], block);
+                _uploadCall(UPLOAD_FILE_WRITE, state.part, block);
+                state.part += block;
+                sent += block;
+            }
+
+            if (at >= 0)
+            {
+                ESP_LOGV(_tag, "End File: %s Type: %s Size: %u", state.filename, state.type, (unsigned)state.part);
+                _uploadCall(UPLOAD_FILE_END, state.part, 0);
+                used += needleLen;
+                state.stage = HB_NEXT;
+            }
+            break;
+
+        case HB_NEXT:
+            if (held >= 2 && data[0] == '-' && data[1] == '-')
+            {
+                ESP_LOGV(_tag, "POST: Parsing Done");
+                used = 2;
+                state.stage = HB_EPILOGUE;
+            }
+            else if (eol)
+            {
+                used = eol + 1 - data;
+                state.stage = HB_HEADERS;
+                state.name = state.filename = nullptr;
+                state.type = MIME_TYPE_TEXT;
+            }
+            break;
+
+        case HB_EPILOGUE:
+            // Skip it, so a pipelined request starts cleanly
+            used = held;
+            if (state.taken + used == len)
+            {
+                parser.bodySkip(used);
+                state.taken = len;
+                state.stage = HB_DONE;
+                return HP_COMPLETE;
+            }
+            break;
         }
 
-        if (_currentArgs)
-            delete[] _currentArgs;
-        _currentArgs = new RequestArgument[postArgsLen];
+        if (used)
+        {
+            parser.bodySkip(used);
+            state.taken += used;
+            continue;
+        }
 
-        for (iarg = 0; iarg < postArgsLen; iarg++)
+        // Nothing more can be taken from what is held, read on behind it
+        if (state.taken + held >= len)
         {
-            RequestArgument &arg = _currentArgs[iarg];
-            arg.key = postArgs[iarg].key;
-            arg.value = postArgs[iarg].value;
+            ESP_LOGD(_tag, "Form cut short: %u of %u", (unsigned)state.taken, (unsigned)len);
+            return HP_ERROR;
         }
 
-        _currentArgCount = iarg;
-        if (postArgs)
-            delete[] postArgs;
+        parser.bodyCompact();
+        if (parser.full())
+        {
+            if (state.stage != HB_FIELD)
+                return HP_ERROR;
+            _current->keepAlive = false;
+            send(413, MIME_TYPE_TEXT, "Form field too large");
+            return HP_ERROR;
+        }
 
-        return true;
+        if (!parser.fill(client))
+            break;
+        burst++;
     }
 
-    ESP_LOGV(_tag, "ERROR-Line: %s", line.c_str());
-
-    return false;
+    if (!client.connected() && !client.available())
+        return HP_ERROR;
+    return HP_PARTIAL;
 }
 
 String IOTHTTP::urlDecode(const String &text)
@@ -1297,11 +2126,116 @@ String IOTHTTP::urlDecode(const String &text)
     return decoded;
 }
 
-bool IOTHTTP::_parseFormUploadAborted()
+/*
+** Decode in place, the result is never longer than the text
+*/
+char *IOTHTTP::_urlDecode(char *text)
+{
+    char *in = text;
+    char *out = text;
+
+    while (*in)
+    {
+        if (*in == '%' && isxdigit(in[1]) && isxdigit(in[2]))
+        {
+            char hex[3] = {in[1], in[2], '\0'};
+
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 3;
+        }
+        else if (*in == '+')
+        {
+            *out++ = ' ';
+            in++;
+        }
+        else
+            *out++ = *in++;
+    }
+    *out = '\0';
+    return text;
+}
+
+/*
+** Hand the body to the handler in blocks as it arrives, whatever has come
+** on each pass, so its size is bounded only by what the handler does with it
+*/
+HTTPParseStatus IOTHTTP::_streamBody(HTTPBodyStream &body, const char *contentType, uint32_t len)
+{
+    HTTPBodyState &state = _current->body;
+
+    if (state.stage == HB_NONE)
+    {
+        _current->handler = _currentHandler;
+        state.stage = HB_STREAM;
+        state.name = state.filename = nullptr;
+        state.type = contentType;
+        _uploadCall(UPLOAD_FILE_START, 0, 0);
+    }
+
+    for (int burst = 0; burst < HTTP_BODY_BURST && state.taken < len; burst++)
+    {
+        size_t want = len - state.taken;
+
+        if (want > HTTP_UPLOAD_BUFLEN)
+            want = HTTP_UPLOAD_BUFLEN;
+
+        size_t got = body.readBlock(_currentUpload.buf, want);
+
+        if (!got)
+            break;
+
+        _uploadCall(UPLOAD_FILE_WRITE, state.taken, got);
+        state.taken += got;
+    }
+
+    if (state.taken < len)
+    {
+        if (_current->client.connected())
+            return HP_PARTIAL;
+
+        ESP_LOGD(_tag, "Body cut short: %u of %u", (unsigned)state.taken, (unsigned)len);
+        return HP_ERROR;
+    }
+
+    _uploadCall(UPLOAD_FILE_END, state.taken, 0);
+    state.stage = HB_DONE;
+    return HP_COMPLETE;
+}
+
+/*
+** Hand the handler what is in the upload buffer, named from the connection.
+** A streamed body goes to its handler whatever httpCanUpload() says.
+*/
+void IOTHTTP::_uploadCall(HTTPUploadStatus status, size_t total, size_t len)
 {
-    _currentUpload.status = UPLOAD_FILE_ABORTED;
-    if (_currentHandler && _currentHandler->httpCanUpload(_currentUri))
+    const HTTPBodyState &state = _current->body;
+
+    _currentUpload.status = status;
+    _currentUpload.name = (state.name) ? state.name : "";
+    _currentUpload.filename = (state.filename) ? state.filename : "";
+    _currentUpload.type = (state.type) ? state.type : "";
+    _currentUpload.totalSize = total;
+    _currentUpload.currentSize = len;
+
+    if (_currentHandler && (state.stage == HB_STREAM || _currentHandler->httpCanUpload(_currentUri)))
         _currentHandler->httpUpload(*this, _currentUri, _currentUpload);
-    return false;
+}
+
+/*
+** Tell the handler a body it was being handed will not be finished
+*/
+void IOTHTTP::_abortBody(HTTPConnection &conn)
+{
+    if ((conn.body.stage != HB_STREAM && conn.body.stage != HB_FILE) || !conn.handler)
+        return;
+
+    HTTPConnection *current = _current;
+
+    _current = &conn;
+    _currentUri = conn.parser.str(conn.parser.uri());
+    _currentHandler = conn.handler;
+    _uploadCall(UPLOAD_FILE_ABORTED, (conn.body.stage == HB_STREAM) ? conn.body.taken : conn.body.part, 0);
+    conn.body.stage = HB_DONE;
+    _current = current;
 }
 /******************************************************************************/
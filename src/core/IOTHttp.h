@@ -24,6 +24,10 @@
 #include <WiFiClient.h>
 #include <WiFiServer.h>
 #include <ESPmDNS.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
 
 /*
 ** Equates and Defintions
@@ -39,6 +43,68 @@
 #define HTTP_MAX_SEND_WAIT 5000  //ms to wait for data chunk to be ACKed
 #define HTTP_MAX_CLOSE_WAIT 2000 //ms to wait for the client to close the connection
 
+#ifndef HTTP_MAX_CLIENTS
+#define HTTP_MAX_CLIENTS 4 // connections serviced concurrently
+#endif
+
+#ifndef HTTP_MAX_WAITING
+#define HTTP_MAX_WAITING 4 // connections held for a free slot, any more are refused with 503
+#endif
+
+#ifndef HTTP_AUTH_CACHE
+#define HTTP_AUTH_CACHE 0 // 1 trusts a connection for its life once it has authenticated
+#endif
+
+#define HTTP_RECLAIM_IDLE 250 //ms a persistent connection is idle before a new one may take its slot
+
+#define HTTP_BOUNDARY_MAX 70 // longest multipart boundary, as RFC 2046 allows
+
+#ifndef HTTP_FILE_CHECK_WAIT
+#define HTTP_FILE_CHECK_WAIT 2000 //ms a static file's index entry is trusted before the file is checked again
+#endif
+
+#ifndef HTTP_MAX_ARGS
+#define HTTP_MAX_ARGS 32 // query and form arguments kept per request
+#endif
+
+#ifndef HTTP_KEEPALIVE_WAIT
+#define HTTP_KEEPALIVE_WAIT 5000 //ms an idle persistent connection is held open, 0 disables
+#endif
+
+#ifndef HTTP_KEEPALIVE_MAX
+#define HTTP_KEEPALIVE_MAX 32 // requests served on one persistent connection
+#endif
+
+#ifndef HTTP_TASK_CORE
+#define HTTP_TASK_CORE -1 // core the server task is pinned to, -1 services it from loop()
+#endif
+
+#ifndef HTTP_TASK_STACK
+#define HTTP_TASK_STACK 8192 // bytes of stack for the server task
+#endif
+
+#ifndef HTTP_TASK_PRIORITY
+#define HTTP_TASK_PRIORITY 1
+#endif
+
+#ifndef HTTP_MAX_HEADER_KEYS
+#define HTTP_MAX_HEADER_KEYS 16 // request headers tracked, including those the server needs
+#endif
+
+#define HTTP_HEADER_TABLE 32 // hash slots for the tracked header names, a power of two
+
+#ifndef HTTP_MAX_RANGES
+#define HTTP_MAX_RANGES 8 // parts served from one Range header, more and the whole file is sent
+#endif
+
+#ifndef HTTP_SEND_BURST
+#define HTTP_SEND_BURST 4 // response buffers sent to one connection per service pass
+#endif
+
+#ifndef HTTP_BODY_BURST
+#define HTTP_BODY_BURST 4 // body blocks handed on for one connection per service pass
+#endif
+
 #define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
 #define CONTENT_LENGTH_NOT_SET ((size_t)-2)
 
@@ -59,6 +125,21 @@ enum HTTPMethod
     HTTP_OPTIONS
 };
 
+// Tracked by every server, in this order, ahead of those collected
+enum HTTPHeaderId
+{
+    HTTP_HEADER_AUTHORIZATION,
+    HTTP_HEADER_IF_NONE_MATCH,
+    HTTP_HEADER_RANGE,
+    HTTP_HEADER_IF_RANGE,
+    HTTP_HEADER_CONTENT_TYPE,
+    HTTP_HEADER_CONTENT_LENGTH,
+    HTTP_HEADER_HOST,
+    HTTP_HEADER_CONNECTION,
+    HTTP_HEADER_TRANSFER_ENCODING,
+    HTTP_HEADER_BUILTIN
+};
+
 enum HTTPUploadStatus
 {
     UPLOAD_FILE_START,
@@ -71,6 +152,8 @@ enum HTTPClientStatus
 {
     HC_NONE,
     HC_WAIT_READ,
+    HC_WAIT_BODY, // headers parsed, the body may still be arriving
+    HC_WAIT_SEND,
     HC_WAIT_CLOSE
 };
 
@@ -81,6 +164,15 @@ class IOTHTTP;
 class IOTFunction;
 #include <FS.h>
 
+extern const char *AUTHORIZATION_HEADER;
+extern const char *IF_NONE_MATCH_HEADER;
+extern const char *RANGE_HEADER;
+extern const char *IF_RANGE_HEADER;
+extern const char *LAST_EVENT_ID_HEADER;
+extern const char *UPGRADE_HEADER;
+extern const char *SEC_WEBSOCKET_KEY_HEADER;
+extern const char *SEC_WEBSOCKET_VERSION_HEADER;
+
 /*
 ** Upload Information
 */
@@ -95,7 +187,85 @@ typedef struct
     uint8_t buf[HTTP_UPLOAD_BUFLEN];
 } HTTPUpload;
 
+// Both point into the connection's request arena
+typedef struct
+{
+    const char *key;
+    const char *value;
+} HTTPArgument;
+
+enum HTTPBodyStage
+{
+    HB_NONE,     // not yet begun, the query arguments still to be taken
+    HB_STREAM,   // handing a body to the handler as it arrives
+    HB_PREAMBLE, // a form's first delimiter line still to come
+    HB_HEADERS,  // the headers of a form part
+    HB_FIELD,    // a field's value, held until its delimiter
+    HB_FILE,     // a file's content, handed on as it arrives
+    HB_NEXT,     // behind a delimiter, another part or the end
+    HB_EPILOGUE, // behind the last delimiter, skipped
+    HB_DONE      // taken whole, nothing left to abort
+};
+
+/*
+** How far a body taken over several passes has got
+*/
+typedef struct
+{
+    uint8_t stage;
+    uint8_t blank;        // blank lines passed ahead of a form's first delimiter
+    size_t taken;         // body bytes read so far
+    size_t part;          // bytes of the file part handed on so far
+    const char *name;     // the part's names, in the request arena
+    const char *filename;
+    const char *type;
+} HTTPBodyState;
+
 #include "http/HTTPHandler.h"
+#include "http/HTTPRouter.h"
+#include "http/HTTPParser.h"
+#include "http/HTTPResponse.h"
+#include "http/HTTPLimiter.h"
+#include "http/HTTPForm.h"
+#include "http/HTTPJson.h"
+
+class HTTPStream;
+
+// Writes the next part of a body, returning false once it is complete
+typedef std::function<bool(HTTPStream &out)> HTTPSender;
+
+/*
+** Connection Slot
+*/
+typedef struct
+{
+    WiFiClient client;
+    HTTPParser parser;
+    HTTPResponse response;
+    HTTPSender sender;
+    HTTPHandler *handler;
+    uint32_t handlerTime; // micros() the handler took, for the metrics
+    HTTPClientStatus status;
+    unsigned long statusChange;
+    unsigned long requestStart; // micros() as the request's first bytes arrived
+    uint16_t requests;
+    uint8_t authEpoch; // credentials the connection proved, with HTTP_AUTH_CACHE
+    size_t contentLength;
+    HTTPArgument args[HTTP_MAX_ARGS];
+    uint8_t argCount;
+    HTTPBodyState body;
+    bool chunked;
+    bool keepAlive;
+    bool responded;
+    bool detached;
+} HTTPConnection;
+
+#include "http/HTTPStream.h"
+#include "http/HTTPEvents.h"
+#include "http/HTTPSocket.h"
+#include "http/HTTPMetrics.h"
+#include "http/HTTPApi.h"
+#include "http/HTTPHistory.h"
 
 /*
 ** Simple Web Server Class
@@ -118,109 +288,165 @@ class IOTHTTP : protected WiFiServer
     void webStartup(void);
     void webShutdown(void);
     void webService(void);
-    uint16_t webPort(void) { return _port; }   
+    void webTask(int8_t core, uint32_t stack = HTTP_TASK_STACK);
+    bool webTasked(void) const { return _task != nullptr; }
+    void webSync(std::function<void(void)> fn);
+    void webDispatch(void);
+    uint16_t webPort(void) { return _port; }
+    void webKeepAlive(unsigned long timeout, uint16_t maxRequests = HTTP_KEEPALIVE_MAX);
+    void webLimit(uint16_t rate, uint16_t burst = HTTP_RATE_BURST, uint8_t waiting = HTTP_MAX_WAITING);
+    const HTTPLimiter &webLimiter(void) const { return _limiter; }
     void webHandler(HTTPHandler *handler);
+    void webRefresh(void);
     void webAuthenticate(void);
+    void webLogin(const char *username, const char *password);
+    bool webAuthorized(void);
+    bool webProtected(void) const { return _authToken.length() != 0; }
     bool webCredentials(const char *username, const char *password);
     
     void on(const String &uri, http_callback_t fn);
     void on(const String &uri, HTTPMethod method, http_callback_t fn);
     void on(const String &uri, HTTPMethod method, http_callback_t fn, http_callback_t ufn);
+    void onBody(const String &uri, HTTPMethod method, http_callback_t fn, http_callback_t bfn);
     void onFile(const char* uri, FS& fs, const char* path, const char* cache_header);
     void on404(http_callback_t fn) { _404Handler = fn; }
     void onUpload(http_callback_t fn) { _uploadHandler = fn; }
+    void onEvents(const char *uri = "/events");
+    void onSocket(const char *uri, HTTPSocket::property_t fn);
+    void onMetrics(const char *uri = "/metrics");
+    void onApi(const char *uri, HTTPApi::function_t ffn, HTTPApi::property_t pfn);
+    void onHistory(const char *uri, HTTPHistory::lookup_t lookup);
+
+    bool hasEvents(void) const { return _events != nullptr || _socket != nullptr; }
+    void webEvent(const char *tag, uint8_t index, const char *value, time_t time);
 
     String uri(void) { return _currentUri; }
     HTTPMethod method(void) { return _currentMethod; }
-    WiFiClient client(void) { return _currentClient; }
+    WiFiClient client(void) { return _current->client; }
     HTTPUpload &upload(void) { return _currentUpload; }
 
-    int args(void) { return _currentArgCount; }
+    int args(void) { return _current->argCount; }
     bool hasArg(String name);
     String arg(String name);
     String arg(int i);
     String argName(int i);
 
     int headers(void) { return _headerKeysCount; }
-    bool hasHeader(String name);
+    int headerId(const char *name);
+    bool hasHeader(int id) { return id >= 0 && id < _headerKeysCount && _currentHeaders[id].value.len > 0; }
+    bool hasHeader(const char *name) { return hasHeader(headerId(name)); }
+    bool hasHeader(const String &name) { return hasHeader(headerId(name.c_str())); }
     void collectHeaders(const char *headerKeys[], const size_t headerKeysCount);
-    String hostHeader(void) { return _hostHeader; }   
-    String header(String name);
+    String hostHeader(void) { return String(headerValue(HTTP_HEADER_HOST)); }
+    const char *headerValue(int id);
+    String header(const char *name) { return header(headerId(name)); }
+    String header(const String &name) { return header(headerId(name.c_str())); }
     String header(int i);
     String headerName(int i);
 
     void sendHeader(const String &name, const String &value, bool first = false);
+    void sendHeader(const char *name, const char *value, bool first = false);
     void sendContent(const String &content);
 
     bool send(int code, const char *content_type = NULL, const String &content = String(""));
     bool send(int code, char *content_type, const String &content);
     bool send(int code, const String &content_type, const String &content);
+    HTTPStream sendStream(int code, const char *content_type = NULL);
+    void sendStream(int code, const char *content_type, HTTPSender sender);
+    WiFiClient sendDetached(int code, const char *content_type = NULL);
 
-    void setContentLength(size_t contentLength) { _contentLength = contentLength; }    
+    void setContentLength(size_t contentLength) { _current->contentLength = contentLength; }
     static String urlDecode(const String &text);
 
-    template <typename T>
-    size_t streamFile(T &file, const String &contentType)
-    {
-        setContentLength(file.size());
-
-        if (String(file.name()).endsWith(".gz") &&
-            contentType != MIME_TYPE_GZIP &&
-            contentType != MIME_TYPE_DATA)
-        {
-            sendHeader("Content-Encoding", "gzip");
-        }
-        
-        send(200, contentType, "");
-        return _currentClient.write(file);
-    }
+    // The file is read as the socket drains and closed once sent, the caller must not close it
+    size_t streamFile(File &file, const String &contentType, const char *etag = NULL);
 
 private:
-    struct RequestArgument
+    // Values point into the connection's request arena
+    struct RequestHeader
     {
         String key;
-        String value;
+        uint32_t hash;
+        HTTPSlice value;
+    };
+
+    struct RequestRange
+    {
+        size_t first;
+        size_t len;
     };
 
     void _addRequestHandler(HTTPHandler *handler);
-    bool _collectHeader(const char *headerName, const char *headerValue);
-    void _prepareHeader(String &response, int code, const char *content_type, size_t contentLength);
-    void _handleRequest(void); 
-       
-    String _methodToString(int method);    
-    String _responseCodeToString(int code);
-
-    bool _parseRequest(WiFiClient &client);
-    void _parseArguments(String data);
-    bool _parseForm(WiFiClient &client, String boundary, uint32_t len);
-    bool _parseFormUploadAborted();
-    void _uploadWriteByte(uint8_t b);
-    uint8_t _uploadReadByte(WiFiClient &client);
+    int _headerFind(const char *name, size_t len, uint32_t hash);
+    bool _headerTrack(const char *name);
+    void _prepareHeader(int code, const char *content_type, size_t contentLength);
+    int _parseRange(const char *spec, size_t size, RequestRange *ranges);
+    static size_t _sendFileRange(HTTPStream &out, File &file, size_t first, size_t len);
+    void _handleRequest(void);
+    void _admitClients(void);
+    HTTPConnection *_freeClient(void);
+    void _openClient(HTTPConnection &conn, WiFiClient &client);
+    void _refuseClient(WiFiClient &client, int code);
+    void _refuseRequest(HTTPConnection &conn);
+    void _serviceClient(HTTPConnection &conn);
+    void _sendClient(HTTPConnection &conn);
+    void _endResponse(HTTPConnection &conn);
+    void _closeClient(HTTPConnection &conn);
+    static void _taskMain(void *server);
+
+    HTTPParseStatus _parseRequest(WiFiClient &client);
+    void _parseArguments(char *data);
+    static char *_urlDecode(char *text);
+    HTTPParseStatus _parseForm(WiFiClient &client, const char *contentType, uint32_t len);
+    void _parsePartHeader(char *line);
+    HTTPParseStatus _streamBody(HTTPBodyStream &body, const char *contentType, uint32_t len);
+    void _uploadCall(HTTPUploadStatus status, size_t total, size_t len);
+    void _abortBody(HTTPConnection &conn);
 
     HTTPHandler *_currentHandler;
     HTTPHandler *_firstHandler;
     HTTPHandler *_lastHandler;
+    HTTPRouter _router;
+    HTTPEvents *_events;
+    HTTPSocket *_socket;
+    HTTPMetrics *_metrics;
     http_callback_t _404Handler;
     http_callback_t _uploadHandler;
 
-    WiFiClient _currentClient;
+    HTTPConnection _clients[HTTP_MAX_CLIENTS];
+    HTTPConnection *_current;
+    uint8_t _nextClient;
+
+    HTTPLimiter _limiter;
+    WiFiClient _waiting[HTTP_MAX_WAITING];
+    unsigned long _waitingSince[HTTP_MAX_WAITING];
+    uint8_t _waitingCount;
+    uint8_t _waitingMax;
+
     HTTPMethod _currentMethod;
     String _currentUri;
     uint8_t _currentVersion;
-    HTTPClientStatus _currentStatus;
-    unsigned long _statusChange;
 
-    int _currentArgCount;
-    RequestArgument *_currentArgs;
     HTTPUpload _currentUpload;
 
     int _headerKeysCount;
-    RequestArgument *_currentHeaders;
-    size_t _contentLength;
-    String _responseHeaders;
-
-    String _hostHeader;
-    bool _chunked;
+    RequestHeader _currentHeaders[HTTP_MAX_HEADER_KEYS];
+    int8_t _headerTable[HTTP_HEADER_TABLE];
+
+    String _authToken;
+    String _authPlain; // "username:password" as given, to notice a change
+    uint8_t _authEpoch;
+
+    unsigned long _keepAliveWait;
+    uint16_t _keepAliveMax;
+
+    TaskHandle_t _task;
+    int8_t _taskCore;
+    uint32_t _taskStack;
+    volatile bool _taskStop;
+    SemaphoreHandle_t _lock;
+    SemaphoreHandle_t _syncDone;
+    QueueHandle_t _syncQueue;
 
     const char *_tag;
     uint8_t _state;
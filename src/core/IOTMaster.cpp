@@ -43,6 +43,8 @@ RTC_DATA_ATTR static int iotStatus = 0;
 IOTMaster::IOTMaster(const char *ssid, const char *pass, uint16_t port, bool lockWiFi)
     : IOTFunction("iot", 3),
       _webServer(nullptr),
+      _events(nullptr),
+      _registry(nullptr),
       _needReboot(false),
       _chipID(0)
 {
@@ -55,7 +57,7 @@ IOTMaster::IOTMaster(const char *ssid, const char *pass, uint16_t port, bool loc
         flags |= IOT_FLAG_READONLY;
 
     _Properties[0] = new IOTPropertyString(this, flags, ssid, IOT_MAX_SSID, PROPERTY_CLASS::GENERIC);
-    _Properties[1] = new IOTPropertyString(this, flags, pass, IOT_MAX_PASS, PROPERTY_CLASS::GENERIC);
+    _Properties[1] = new IOTPropertyString(this, flags | IOT_FLAG_SECRET, pass, IOT_MAX_PASS, PROPERTY_CLASS::GENERIC);
     _Properties[2] = new IOTPropertyString(this, flags, strNull, IOT_MAX_HOST, PROPERTY_CLASS::IPHOST);
 
     /*
@@ -69,11 +71,53 @@ IOTMaster::IOTMaster(const char *ssid, const char *pass, uint16_t port, bool loc
     _Properties[8] = new IP4AddressProperty(this, INADDR_NONE, true, "DNS #2");
     */
 
+    if ((_events = new IOTEvents()) == NULL)
+        ESP_LOGE(_tag, "ERROR: failed to create event bus.");
+    else
+    {
+        // Keep the history of properties that asked for one
+        _events->subscribe([](const IOTEvent &event) {
+            IOTHistory *history = event.property->_history;
+            IOTCodecValue value;
+
+            if (history != NULL && IOTCodec::decode(event.value, event.len, value))
+                history->add((uint32_t)event.time, value);
+        });
+    }
+
+    if ((_registry = new IOTRegistry()) == NULL)
+        ESP_LOGE(_tag, "ERROR: failed to create registry.");
+    _register(this);
+
     if ((_webServer = new IOTHTTP(_tag, port)) == NULL)
     {
         ESP_LOGE(_tag, "ERROR: failed to create web service.");
         iotReboot();
     }
+    else
+    {
+        _webServer->onEvents();
+        _webServer->onMetrics();
+        _webServer->onHistory("/history", [this](const char *path) {
+            IOTProperty *prop = Resolve(path);
+
+            return (prop != NULL) ? prop->_history : NULL;
+        });
+
+        // Push changes to anyone listening for events, secrets never leave
+        if (_events != NULL)
+        {
+            _events->subscribe([this](const IOTEvent &event) {
+                if (_webServer->hasEvents() && !(event.property->_dataFlags & IOT_FLAG_SECRET))
+                {
+                    char value[IOTPROPERTY_MAX_TEXT + 1];
+
+                    event.property->toChars(value, sizeof(value));
+                    _webServer->webEvent(event.function->iotTag(), event.index, value, event.time);
+                }
+            });
+        }
+    }
 }
 
 /*
@@ -86,6 +130,18 @@ IOTMaster::~IOTMaster()
         delete _webServer;
         _webServer = NULL;
     }
+
+    if (_events != NULL)
+    {
+        delete _events;
+        _events = NULL;
+    }
+
+    if (_registry != NULL)
+    {
+        delete _registry;
+        _registry = NULL;
+    }
 }
 
 const char *IOTMaster::iotVersion(void)
@@ -268,8 +324,17 @@ void IOTMaster::iotService(void)
     if (_state != IOT_RUNNING)
         return;
 
+    // A server running in its own task only needs its sync calls answered
     if (_webServer != nullptr)
-        _webServer->webService();
+    {
+        if (_webServer->webTasked())
+            _webServer->webDispatch();
+        else
+            _webServer->webService();
+    }
+
+    if (_events != nullptr)
+        _events->dispatch();
 
     IOTFunction *func = listHead();
 
@@ -368,6 +433,148 @@ IOTHTTP *IOTMaster::Server(void) const
     return _webServer;
 }
 
+IOTEvents *IOTMaster::Events(void) const
+{
+    return _events;
+}
+
+IOTRegistry *IOTMaster::Registry(void) const
+{
+    return _registry;
+}
+
+/*
+** Serve properties over a WebSocket, left to the sketch as it writes them
+*/
+void IOTMaster::iotSocket(const char *uri)
+{
+    if (_webServer != NULL)
+    {
+        _webServer->onSocket(uri, [this](const char *tag, uint8_t index, const char *value, String &result) {
+            return _socketProperty(tag, index, value, result);
+        });
+    }
+}
+
+/*
+** Serve properties as JSON, left to the sketch as it writes them
+*/
+void IOTMaster::iotApi(const char *uri)
+{
+    if (_webServer != NULL)
+    {
+        _webServer->onApi(uri, [this](uint8_t function, uint8_t &properties, const char *&label) {
+            return _apiFunction(function, properties, label);
+        }, [this](uint8_t function, uint8_t index, const char *value, HTTPJson *json) {
+            return _apiProperty(function, index, value, json);
+        });
+    }
+}
+
+/*
+** WebSocket Property Access, run by loop() when the server has its own task
+*/
+bool IOTMaster::_socketProperty(const char *tag, uint8_t index, const char *value, String &result)
+{
+    bool found = false;
+
+    _webServer->webSync([&]() {
+        IOTFunction *func = Function(tag);
+
+        if (func == nullptr || func->_Properties == nullptr || index >= func->_propCount || func->_Properties[index] == nullptr)
+            return;
+
+        IOTProperty *prop = func->_Properties[index];
+
+        if (prop->_dataFlags & IOT_FLAG_SECRET)
+            result = "secret";
+        else if (value != nullptr && prop->isReadOnly())
+            result = "readonly";
+        else if (value != nullptr && !prop->isValid(value, strlen(value)))
+            result = "invalid";
+        else
+        {
+            if (value != nullptr)
+                prop->setData(value);
+            result = prop->getData();
+            found = true;
+        }
+    });
+    return found;
+}
+
+/*
+** REST Api Access, the server syncs with loop() around these
+*/
+static constexpr const char *_typeNames[] = {"string", "number", "vector", "enum", "dnum",
+                                             "color", "json", "date", "bool", "stream"};
+
+// Position zero is the master, then each function in the order added
+IOTFunction *IOTMaster::_apiLookup(uint8_t function)
+{
+    IOTFunction *func = (function == 0) ? this : listHead();
+
+    while (func != nullptr && func != this && --function)
+        func = func->_listNext;
+    return func;
+}
+
+const char *IOTMaster::_apiFunction(uint8_t function, uint8_t &properties, const char *&label)
+{
+    IOTFunction *func = _apiLookup(function);
+
+    if (func == nullptr)
+        return nullptr;
+
+    properties = (func->_Properties != nullptr) ? func->_propCount : 0;
+    label = func->getLabel();
+    return func->_tag;
+}
+
+int IOTMaster::_apiProperty(uint8_t function, uint8_t index, const char *value, HTTPJson *json)
+{
+    IOTFunction *func = _apiLookup(function);
+    IOTProperty *prop;
+
+    if (func == nullptr || func->_Properties == nullptr || index >= func->_propCount || (prop = func->_Properties[index]) == nullptr)
+        return 404;
+
+    if (value != nullptr)
+    {
+        if (prop->isReadOnly() || (prop->_dataFlags & IOT_FLAG_SECRET))
+            return 403;
+        if (!prop->isValid(value, strlen(value)))
+            return 400;
+        prop->setData(value);
+    }
+
+    if (json == nullptr)
+        return 200;
+
+    uint8_t type = (uint8_t)prop->_dataType;
+
+    json->object()
+        .number("index", index)
+        .string("label", prop->_dataLabel)
+        .string("type", (type < sizeof(_typeNames) / sizeof(_typeNames[0])) ? _typeNames[type] : nullptr)
+        .number("class", (unsigned)prop->_dataClass)
+        .boolean("readonly", prop->isReadOnly())
+        .string("prefix", prop->_dataPrefix)
+        .string("suffix", prop->_dataSuffix)
+        .number("time", (long)prop->_dataTime);
+
+    if (prop->_dataFlags & IOT_FLAG_SECRET)
+        json->null("value");
+    else
+    {
+        json->quote("value");
+        prop->printData(*json);
+        json->unquote();
+    }
+    json->end();
+    return 200;
+}
+
 /*
 ** Add new function
 */
@@ -382,11 +589,48 @@ void IOTMaster::addFunction(IOTFunction *func)
         ESP_LOGV(_tag, "addFunction(%s)", func->_tag);
         func->_iotMaster = this;
         listAppend(func);
+        _register(func);
     }
     else
         ESP_LOGE(_tag, "addFunction(%s) - Error, duplicate tag", func->_tag);
 }
 
+/*
+** Register a function by its tag and its labelled properties by path,
+** labels changed later are registered again by the property
+*/
+void IOTMaster::_register(IOTFunction *func)
+{
+    if (_registry == nullptr)
+        return;
+
+    if (!_registry->add(func, func->_tag))
+        ESP_LOGE(_tag, "Register(%s) - Error, tag not added", func->_tag);
+
+    for (uint8_t p = 0; func->_Properties != nullptr && p < func->_propCount; p++)
+    {
+        IOTProperty *prop = func->_Properties[p];
+
+        if (prop != nullptr && prop->_dataLabel != nullptr && !_registry->add(func, prop, func->_tag, prop->_dataLabel))
+            ESP_LOGW(_tag, "Register(%s/%s) - Duplicate path, use its index", func->_tag, prop->_dataLabel);
+    }
+}
+
+void IOTMaster::_unregister(IOTFunction *func)
+{
+    if (_registry == nullptr)
+        return;
+
+    for (uint8_t p = 0; func->_Properties != nullptr && p < func->_propCount; p++)
+    {
+        IOTProperty *prop = func->_Properties[p];
+
+        if (prop != nullptr && prop->_dataLabel != nullptr)
+            _registry->remove(func, prop, func->_tag, prop->_dataLabel);
+    }
+    _registry->remove(func, nullptr, func->_tag, nullptr);
+}
+
 /*
 ** List Handlers
 */
@@ -436,9 +680,12 @@ void IOTMaster::listAppend(IOTFunction *func)
 void IOTMaster::listRemove(IOTFunction *func)
 {
     /* base case */
-    if (!func || listHead() == nullptr)
+    if (!func || func->_iotMaster != this || listHead() == nullptr)
         return;
 
+    /* Its tag and paths go with it */
+    _unregister(func);
+
     /* If node to be deleted is head node */
     if (listHead() == func)
         listHead(func->_listNext);
@@ -454,6 +701,10 @@ void IOTMaster::listRemove(IOTFunction *func)
     /* Change prev only if node to be deleted is NOT the first node */
     if (func->_listPrev != nullptr)
         func->_listPrev->_listNext = func->_listNext;
+
+    func->_listNext = nullptr;
+    func->_listPrev = nullptr;
+    func->_iotMaster = nullptr;
 }
 
 /*
@@ -25,7 +25,8 @@ IOTProperty::IOTProperty(IOTFunction *IOTFunction, uint16_t flags, size_t dataLe
     _dataPrefix(prefix), 
     _dataSuffix(suffix), 
     _dataLabel(NULL),
-    _dataTime(0)
+    _dataTime(0),
+    _history(NULL)
 {
     if (prefix == NULL && suffix == NULL)
         _setClass(pClass);
@@ -33,45 +34,168 @@ IOTProperty::IOTProperty(IOTFunction *IOTFunction, uint16_t flags, size_t dataLe
     _dataFlags = flags;
 }
 
+// The label leaves the registry before it is freed, the history goes too
+IOTProperty::~IOTProperty()
+{
+    IOTRegistry *registry = (_IOTFunction != NULL) ? _IOTFunction->Registry() : NULL;
+
+    if (_dataLabel != NULL)
+    {
+        if (registry != NULL)
+            registry->remove(_IOTFunction, this, _IOTFunction->_tag, _dataLabel);
+        free(_dataLabel);
+    }
+    delete _history;
+}
+
 /*
-** Value Getter
+** Value Getters, text is written to the stack and copied only when asked
 */
-char *IOTProperty::getData(char *buf, size_t len)
+String IOTProperty::getData(void)
 {
-    String value = getData();
-    snprintf(buf, len, value.c_str());
+    char buf[IOTPROPERTY_MAX_TEXT + 1];
+
+    toChars(buf, sizeof(buf));
+    return String(buf);
+}
+
+char *IOTProperty::getData(char *buf, size_t max)
+{
+    toChars(buf, max);
     return buf;
 }
 
+size_t IOTProperty::printData(Print &out)
+{
+    char buf[IOTPROPERTY_MAX_TEXT + 1];
+    size_t len = toChars(buf, sizeof(buf));
+
+    return out.write((const uint8_t *)buf, len);
+}
+
+size_t IOTProperty::toBinary(uint8_t *buf, size_t max)
+{
+    char text[IOTPROPERTY_MAX_TEXT + 1];
+    size_t len = toChars(text, sizeof(text));
+
+    return IOTCodec::encode(buf, max, text, len);
+}
+
 /*
-** Value Setter
+** Value Setters
 */
 bool IOTProperty::setData(const char *newVal, bool urgent)
 {
-    String nv(newVal);
-
-    return setData(nv, urgent); 
+    return fromChars(newVal, (newVal) ? strlen(newVal) : 0, urgent);
 }
 
 bool IOTProperty::setData(String &newVal, bool urgent)
 {
+    return fromChars(newVal.c_str(), newVal.length(), urgent);
+}
+
+bool IOTProperty::fromChars(const char *text, size_t len, bool urgent)
+{
+    return !isReadOnly() && _changed(_setChars(text, len), urgent);
+}
+
+bool IOTProperty::fromBinary(const uint8_t *buf, size_t len, bool urgent)
+{
+    IOTCodecValue value;
     bool changed = false;
 
-    if (!(_dataFlags & IOT_FLAG_READONLY))
+    if (isReadOnly() || !IOTCodec::decode(buf, len, value))
+        return false;
+
+    switch (value.tag)
     {
-        if ((changed = _dataSet(newVal)))      
-            time(&_dataTime);
-    
-        if (changed && _IOTFunction != NULL)
-        {
-            if (_IOTFunction->_propUpdate(this))
-                _IOTFunction->_postUpdate(this, urgent);
-        }
+    case IOT_CODEC_FALSE:
+    case IOT_CODEC_TRUE:
+    case IOT_CODEC_SINT:
+        changed = _setNumber(value.sint);
+        break;
+    case IOT_CODEC_UINT:
+        changed = (value.uint > INT64_MAX) ? _setNumber((double)value.uint) : _setNumber((int64_t)value.uint);
+        break;
+    case IOT_CODEC_FLOAT:
+    case IOT_CODEC_DOUBLE:
+        changed = _setNumber(value.real);
+        break;
+    case IOT_CODEC_TEXT:
+        changed = _setChars(value.text, value.len);
+        break;
+    }
+
+    return _changed(changed, urgent);
+}
+
+// Stamp a change and pass it to the function
+bool IOTProperty::_changed(bool changed, bool urgent)
+{
+    if (changed)
+    {
+        time(&_dataTime);
+
+        if (_IOTFunction != NULL && _IOTFunction->_propUpdate(this))
+            _IOTFunction->_postUpdate(this, urgent);
     }
 
     return changed;
 }
 
+/*
+** History, fed from the event bus by the master.  Text that is not a
+** number is left out, so any property may keep one.
+*/
+IOTHistory *IOTProperty::keepHistory(uint8_t places, bool psram)
+{
+    if (_history != NULL)
+        return _history;
+
+    if ((_history = new IOTHistory(places, psram)) == NULL || !_history->ready())
+    {
+        ESP_LOGE((_IOTFunction != NULL) ? _IOTFunction->iotTag() : "iot", "ERROR: failed to create property history.");
+        delete _history;
+        _history = NULL;
+    }
+    return _history;
+}
+
+/*
+** Numbers, for properties that hold text
+*/
+bool IOTProperty::_getNumber(int64_t &value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    size_t len = toChars(buf, sizeof(buf));
+
+    return IOTCodec::fromChars(buf, len, value);
+}
+
+bool IOTProperty::_getNumber(double &value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    size_t len = toChars(buf, sizeof(buf));
+
+    return IOTCodec::fromChars(buf, len, value);
+}
+
+bool IOTProperty::_setNumber(int64_t value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    size_t len = IOTCodec::toChars(buf, sizeof(buf), value);
+
+    return _setChars(buf, len);
+}
+
+bool IOTProperty::_setNumber(double value)
+{
+    char buf[IOT_CODEC_NUMBER];
+    size_t len = IOTCodec::toChars(buf, sizeof(buf), value);
+
+    return _setChars(buf, len);
+}
+
 /*
 ** Property Class
 */
@@ -149,8 +273,13 @@ void IOTProperty::setDataLabel(const char *s, bool lock)
     if (_dataFlags & IOT_FLAG_LOCK_LABEL)
         return;
 
+    // The registry points at the label, so it goes before the label is freed
+    IOTRegistry *registry = (_IOTFunction != NULL) ? _IOTFunction->Registry() : NULL;
+
     if (_dataLabel != NULL)
     {
+        if (registry != NULL)
+            registry->remove(_IOTFunction, this, _IOTFunction->_tag, _dataLabel);
         free(_dataLabel);
         _dataLabel = NULL;
     }
@@ -187,6 +316,9 @@ void IOTProperty::setDataLabel(const char *s, bool lock)
         }
     }
 
+    if (registry != NULL && _dataLabel != NULL)
+        (void)registry->add(_IOTFunction, this, _IOTFunction->_tag, _dataLabel);
+
     if (lock)
         _dataFlags |= IOT_FLAG_LOCK_LABEL;
 }
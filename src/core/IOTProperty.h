@@ -18,6 +18,9 @@
 #include <time.h>
 #include <sys/time.h>
 #include <esp_log.h>
+#include <type_traits>
+#include "core/IOTCodec.h"
+#include "core/IOTHistory.h"
 #include "core/IOTStrings.h"
 #include "core/IOTTimer.h"
 
@@ -53,6 +56,7 @@ class IOTMaster;
 #define IOTPROPERTY_MAX_LABEL 48
 #define IOTPROPERTY_MAX_PREFIX 32
 #define IOTPROPERTY_MAX_SUFFIX 32
+#define IOTPROPERTY_MAX_TEXT 256 // longest value as text, and a string property's limit
 
 /*
 ** Flags (check iotPIN class for special usage)
@@ -62,6 +66,7 @@ class IOTMaster;
 #define IOT_FLAG_CONTROL 0x0002
 #define IOT_FLAG_READONLY 0x0008
 #define IOT_FLAG_VOLATILE 0x0010
+#define IOT_FLAG_SECRET 0x0020      // Can be set, never reported
 #define IOT_FLAG_INVERT 0x0100      // Used by IOTPIN
 #define IOT_FLAG_SYSTEM 0x0200
 #define IOT_FLAG_CONFIG 0x0400
@@ -144,6 +149,9 @@ class IOTProperty
 public:
   friend class IOTFunction;
   friend class IOTMaster;
+  friend class IOTEvents;
+
+  virtual ~IOTProperty();
   
   inline bool isReadOnly() { return _dataFlags & IOT_FLAG_READONLY; }
   inline time_t timeStamp() { return _dataTime; }
@@ -159,18 +167,60 @@ public:
   void getDataLabel(char *s);
   void setDataLabel(const char *s, bool lock = false);
 
-  virtual String getData(void) = 0;
-  char *getData(char *, size_t max);
-  bool setData(const char *newVal, bool urgent = false); 
+  // Value as text in the buffer given, and from text of a length
+  virtual size_t toChars(char *buf, size_t max) = 0;
+  bool fromChars(const char *text, size_t len, bool urgent = false);
+
+  // Whether text would be taken, as a set that changes nothing also returns false
+  virtual bool isValid(const char *, size_t) { return true; }
+
+  // Value in the tagged binary form of IOTCodec, taken in any of its encodings
+  virtual size_t toBinary(uint8_t *buf, size_t max);
+  bool fromBinary(const uint8_t *buf, size_t len, bool urgent = false);
+
+  // Value as a number of any type, without text between
+  template <typename _V>
+  _V get(void)
+  {
+    typename std::conditional<std::is_floating_point<_V>::value, double, int64_t>::type value = 0;
+
+    (void)_getNumber(value);
+    return (_V)value;
+  }
+
+  template <typename _V>
+  bool set(_V value, bool urgent = false)
+  {
+    typename std::conditional<std::is_floating_point<_V>::value, double, int64_t>::type nv = value;
+
+    return !isReadOnly() && _changed(_setNumber(nv), urgent);
+  }
+
+  virtual String getData(void);
+  virtual size_t printData(Print &out);
+  char *getData(char *buf, size_t max);
+  bool setData(const char *newVal, bool urgent = false);
   bool setData(String &newVal, bool urgent = false);
 
+  // Recent values of a numeric property, kept from each change once asked
+  IOTHistory *keepHistory(uint8_t places = 2, bool psram = false);
+  inline IOTHistory *history(void) { return _history; }
+
 protected:
   IOTProperty(IOTFunction *IOTFunction, uint16_t flags, size_t dataLen, PROPERTY_TYPE pType,
               PROPERTY_CLASS pClass, const char *prefix = NULL, const char *suffix = NULL, const char *label = NULL);
 
   virtual void _setClass(PROPERTY_CLASS pClass);
   virtual void *_dataPtr(void) = 0;
-  virtual bool _dataSet(String &newVal) = 0;
+  virtual bool _setChars(const char *text, size_t len) = 0;
+
+  // Numbers go through the text unless a property holds one
+  virtual bool _getNumber(int64_t &value);
+  virtual bool _getNumber(double &value);
+  virtual bool _setNumber(int64_t value);
+  virtual bool _setNumber(double value);
+
+  bool _changed(bool changed, bool urgent);
 
   IOTFunction *_IOTFunction;
   PROPERTY_TYPE _dataType;
@@ -181,6 +231,7 @@ protected:
   size_t _dataLen;
   uint16_t _dataFlags;
   time_t _dataTime;
+  IOTHistory *_history;
 };
 
 /*
@@ -216,35 +267,35 @@ public:
                     const char *prefix = NULL, const char *suffix = NULL, const char *label = NULL)
       : IOTProperty(IOTFunction, flags, maxLen, PROPERTY_TYPE::STRING, pClass, prefix, suffix, label)
   {    
-    _dataLen = min(maxLen, 256L);
-    _dataVal = (char *)malloc(maxLen + 1);   
-    (void)_dataSet((char *)defVal);   
+    _dataLen = min(maxLen, (size_t)IOTPROPERTY_MAX_TEXT);
+    if ((_dataVal = (char *)malloc(_dataLen + 1)) != NULL)
+      _dataVal[0] = '\0';
+    (void)_setChars(defVal, (defVal) ? strlen(defVal) : 0);
   }
+  ~IOTPropertyString() { free(_dataVal); }
 
   String getData(void) { return String(_dataVal); }
-  
+  size_t printData(Print &out) { return out.print(_dataVal); }
+  size_t toChars(char *buf, size_t max) { return IOTCodec::toChars(buf, max, _dataVal, (_dataVal) ? strlen(_dataVal) : 0); }
+  size_t toBinary(uint8_t *buf, size_t max) { return IOTCodec::encode(buf, max, _dataVal, (_dataVal) ? strlen(_dataVal) : 0); }
+
 protected:
   void *_dataPtr(void) { return (void *)_dataVal; }
-  bool _dataSet(String &newVal) { return _dataSet((char *)newVal.c_str()); }
 
-  bool _dataSet(char *newVal)
+  // Cut to fit, changed only if the text differs
+  bool _setChars(const char *text, size_t len)
   {
-    bool changed = false;
+    if (_dataVal == NULL)
+      return false;
+    if (text == NULL || len > _dataLen)
+      len = (text == NULL) ? 0 : _dataLen;
 
-    if (_dataVal != NULL)
-    {
-      _dataVal[_dataLen] = '\0';
-
-      if (newVal == NULL)
-      {
-        if ((changed = strncmp(_dataVal, strNull, _dataLen)))
-          memset(_dataVal, 0, _dataLen);
-      }
-      else if ((changed = strncmp(_dataVal, (const char *)newVal, _dataLen)))
-        strncpy(_dataVal, (const char *)newVal, _dataLen);
-    }
+    if (strlen(_dataVal) == len && memcmp(_dataVal, text, len) == 0)
+      return false;
 
-    return changed;
+    memcpy(_dataVal, text, len);
+    _dataVal[len] = '\0';
+    return true;
   }
 
   char *_dataVal;
@@ -267,23 +318,32 @@ public:
   {
   }
 
-  String getData(void) { return _stringify(_dataRef); }
-  
+  size_t toChars(char *buf, size_t max) { return _chars(buf, max, _dataRef); }
+  size_t toBinary(uint8_t *buf, size_t max) { return _encode(buf, max, _dataRef); }
+  bool isValid(const char *text, size_t len) { return _valid(text, len, (_T *)NULL); }
+
 protected:
   void *_dataPtr(void) { return (void *)&_dataRef; }
 
-  virtual bool _dataSet(String &newVal)
+  // Text that is not wholly a number is refused, not taken as zero
+  bool _setChars(const char *text, size_t len) { return _parse(text, len, (_T *)NULL); }
+
+  bool _getNumber(int64_t &value) { value = (int64_t)_dataRef; return true; }
+  bool _getNumber(double &value) { value = (double)_dataRef; return true; }
+  bool _setNumber(int64_t value) { return _setLimited(value); }
+  bool _setNumber(double value) { return value == value && _setLimited(value); }
+
+  // Held to the limits before the value is narrowed to _T
+  template <typename _V>
+  bool _setLimited(_V value)
   {
-    _T nv = _T(0);
+    _T nv = (value > _dataMax) ? _dataMax : (value < _dataMin) ? _dataMin : (_T)value;
 
-    _destring(newVal, &nv);
     return _dataSet(nv);
   }
 
   bool _dataSet(_T &newVal)
   {
-    bool changed = false;
-
     if (newVal > _dataMax)
       newVal = _dataMax;
     if (newVal < _dataMin)
@@ -302,25 +362,55 @@ protected:
   _T _dataMax;
 
 private:
-  void _destring(String &val, bool *nv) { *nv = (bool)(val.toInt() & 0x01L); }
-  void _destring(String &val, int8_t *nv) { *nv = (int8_t)val.toInt(); }
-  void _destring(String &val, uint8_t *nv) { *nv = (uint8_t)val.toInt(); }
-  void _destring(String &val, int16_t *nv) { *nv = (int16_t)val.toInt(); }
-  void _destring(String &val, uint16_t *nv) { *nv = (uint16_t)val.toInt(); }
-  void _destring(String &val, int32_t *nv) { *nv = (int32_t)val.toInt(); }
-  void _destring(String &val, uint32_t *nv) { *nv = (uint32_t)val.toInt(); }
-  void _destring(String &val, float *nv) { *nv = val.toFloat(); }
-  void _destring(String &val, double *nv) { *nv = (double)val.toInt(); }
-
-  String _stringify(bool t) { return String((t) ? "1" : "0"); }
-  String _stringify(int8_t t) { return String(t); }
-  String _stringify(int16_t t) { return String(t); }
-  String _stringify(int32_t t) { return String(t); }
-  String _stringify(uint8_t t) { return String(t); }
-  String _stringify(uint16_t t) { return String(t); }
-  String _stringify(uint32_t t) { return String(t); }
-  String _stringify(float t) { return String(t, 2); }
-  String _stringify(double t) { return String(t, 4); }
+  bool _valid(const char *text, size_t len, bool *)
+  {
+    bool nv;
+
+    return IOTCodec::fromChars(text, len, nv);
+  }
+
+  template <typename _V>
+  bool _valid(const char *text, size_t len, _V *)
+  {
+    double nv;
+
+    return IOTCodec::fromChars(text, len, nv);
+  }
+
+  bool _parse(const char *text, size_t len, bool *)
+  {
+    bool nv;
+
+    return IOTCodec::fromChars(text, len, nv) && _setNumber((int64_t)nv);
+  }
+
+  template <typename _V>
+  bool _parse(const char *text, size_t len, _V *)
+  {
+    double nv;
+
+    return IOTCodec::fromChars(text, len, nv) && _setNumber(nv);
+  }
+
+  size_t _chars(char *buf, size_t max, bool t) { return IOTCodec::toChars(buf, max, (t) ? "1" : "0", 1); }
+  size_t _chars(char *buf, size_t max, int8_t t) { return IOTCodec::toChars(buf, max, (int64_t)t); }
+  size_t _chars(char *buf, size_t max, int16_t t) { return IOTCodec::toChars(buf, max, (int64_t)t); }
+  size_t _chars(char *buf, size_t max, int32_t t) { return IOTCodec::toChars(buf, max, (int64_t)t); }
+  size_t _chars(char *buf, size_t max, uint8_t t) { return IOTCodec::toChars(buf, max, (uint64_t)t); }
+  size_t _chars(char *buf, size_t max, uint16_t t) { return IOTCodec::toChars(buf, max, (uint64_t)t); }
+  size_t _chars(char *buf, size_t max, uint32_t t) { return IOTCodec::toChars(buf, max, (uint64_t)t); }
+  size_t _chars(char *buf, size_t max, float t) { return IOTCodec::toChars(buf, max, (double)t, 2); }
+  size_t _chars(char *buf, size_t max, double t) { return IOTCodec::toChars(buf, max, t); }
+
+  size_t _encode(uint8_t *buf, size_t max, bool t) { return IOTCodec::encode(buf, max, t); }
+  size_t _encode(uint8_t *buf, size_t max, int8_t t) { return IOTCodec::encode(buf, max, (int64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, int16_t t) { return IOTCodec::encode(buf, max, (int64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, int32_t t) { return IOTCodec::encode(buf, max, (int64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, uint8_t t) { return IOTCodec::encode(buf, max, (uint64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, uint16_t t) { return IOTCodec::encode(buf, max, (uint64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, uint32_t t) { return IOTCodec::encode(buf, max, (uint64_t)t); }
+  size_t _encode(uint8_t *buf, size_t max, float t) { return IOTCodec::encode(buf, max, t); }
+  size_t _encode(uint8_t *buf, size_t max, double t) { return IOTCodec::encode(buf, max, t); }
 };
 
 // TODO: Add logic inversion flag
@@ -335,21 +425,25 @@ public:
     _dataType = PROPERTY_TYPE::BOOL;
   }
 
-  String getData(void)
+  size_t toChars(char *buf, size_t max)
+  {
+    const char *text = _dataText();
+
+    return IOTCodec::toChars(buf, max, text, strlen(text));
+  }
+
+private:
+  const char *_dataText(void)
   {
     switch (_dataClass) {
-      case PROPERTY_CLASS::LOGIC: return String((_dataRef) ? strHigh : strLow);       
+      case PROPERTY_CLASS::LOGIC: return (_dataRef) ? strHigh : strLow;
       case PROPERTY_CLASS::LIGHT:
-      case PROPERTY_CLASS::SWITCH: return String((_dataRef) ? strOn : strOff); 
-      case PROPERTY_CLASS::MOTION:
-      case PROPERTY_CLASS::BOOLEAN: String((_dataRef) ? strTrue : strFalse);
-      case PROPERTY_CLASS::RELAY: String((_dataRef) ? strClosed : strOpen);
-      case PROPERTY_CLASS::VALVE: String((_dataRef) ? strOpen : strClosed);
+      case PROPERTY_CLASS::SWITCH: return (_dataRef) ? strOn : strOff;
       default:
         break;
     }
 
-    return String((_dataRef) ? "1" : "0");
+    return (_dataRef) ? "1" : "0";
   }
 };
 
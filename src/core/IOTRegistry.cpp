@@ -0,0 +1,239 @@
+/*
+** EasyIOT - Function and Property Registry
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "IOTRegistry.h"
+
+#define FNV_OFFSET 2166136261UL
+#define FNV_PRIME 16777619UL
+
+IOTRegistry::~IOTRegistry()
+{
+    if (_slots != nullptr)
+    {
+        free(_slots);
+        _slots = nullptr;
+    }
+}
+
+/*
+** Add and Remove, a key already held is not added again
+*/
+bool IOTRegistry::add(IOTFunction *function, const char *tag)
+{
+    if (function == nullptr || tag == nullptr)
+        return false;
+
+    return _add({_hash(tag, nullptr), tag, nullptr, function, nullptr});
+}
+
+bool IOTRegistry::add(IOTFunction *function, IOTProperty *property, const char *tag, const char *label)
+{
+    if (property == nullptr || tag == nullptr || label == nullptr || !*label)
+        return false;
+
+    return _add({_hash(tag, label), tag, label, function, property});
+}
+
+bool IOTRegistry::_add(const Slot &slot)
+{
+    char path[IOT_REGISTRY_PATH + 1];
+    int len;
+
+    // The key as a path, to test for it as a search would
+    if (slot.label != nullptr)
+        len = snprintf(path, sizeof(path), "%s/%s", slot.tag, slot.label);
+    else
+        len = snprintf(path, sizeof(path), "%s", slot.tag);
+
+    if (len < 0 || len > IOT_REGISTRY_PATH || _find(path, len, slot.hash) != nullptr)
+        return false;
+
+    if ((_count + 1) * 4 > _size * 3 && !_grow())
+        return false;
+
+    size_t mask = _size - 1;
+    size_t at = slot.hash & mask;
+
+    while (_slots[at].tag != nullptr)
+        at = (at + 1) & mask;
+
+    _slots[at] = slot;
+    _count++;
+    return true;
+}
+
+void IOTRegistry::remove(IOTFunction *function, IOTProperty *property, const char *tag, const char *label)
+{
+    if (_slots == nullptr || tag == nullptr)
+        return;
+
+    size_t mask = _size - 1;
+    uint32_t hash = _hash(tag, label);
+    size_t hole = hash & mask;
+
+    while (_slots[hole].tag != nullptr &&
+           (_slots[hole].function != function || _slots[hole].property != property || _slots[hole].hash != hash))
+        hole = (hole + 1) & mask;
+
+    if (_slots[hole].tag == nullptr)
+        return;
+
+    // Shift back each that follows and may sit in the hole, as it is
+    // no further from its home there
+    for (size_t at = (hole + 1) & mask; _slots[at].tag != nullptr; at = (at + 1) & mask)
+    {
+        size_t home = _slots[at].hash & mask;
+
+        if (((at - home) & mask) >= ((at - hole) & mask))
+        {
+            _slots[hole] = _slots[at];
+            hole = at;
+        }
+    }
+
+    _slots[hole] = {};
+    _count--;
+}
+
+bool IOTRegistry::_grow(void)
+{
+    size_t size = (_size) ? _size * 2 : IOT_REGISTRY_SLOTS;
+    Slot *slots = (Slot *)calloc(size, sizeof(Slot));
+
+    if (slots == nullptr)
+        return false;
+
+    Slot *old = _slots;
+    size_t oldSize = _size;
+
+    _slots = slots;
+    _size = size;
+
+    for (size_t s = 0; s < oldSize; s++)
+    {
+        if (old[s].tag != nullptr)
+        {
+            size_t at = old[s].hash & (size - 1);
+
+            while (_slots[at].tag != nullptr)
+                at = (at + 1) & (size - 1);
+            _slots[at] = old[s];
+        }
+    }
+
+    if (old != nullptr)
+        free(old);
+    return true;
+}
+
+/*
+** Lookups
+*/
+IOTFunction *IOTRegistry::function(const char *path, size_t len)
+{
+    Slot *slot = _find(path, len, _hash(FNV_OFFSET, path, len));
+
+    return (slot != nullptr && slot->label == nullptr) ? slot->function : nullptr;
+}
+
+IOTProperty *IOTRegistry::property(const char *path, size_t len)
+{
+    Slot *slot = _find(path, len, _hash(FNV_OFFSET, path, len));
+
+    return (slot != nullptr) ? slot->property : nullptr;
+}
+
+IOTProperty *IOTRegistry::resolve(const char *path, IOTFunction *&function, uint8_t &index)
+{
+    IOTProperty *property;
+
+    function = nullptr;
+    index = 0;
+    if (path == nullptr)
+        return nullptr;
+
+    size_t len = strlen(path);
+
+    if ((property = this->property(path, len)) != nullptr)
+        return property;
+
+    // Else the path ends with the property's place in its function
+    const char *slash = strrchr(path, '/');
+    char *end;
+
+    if (slash == nullptr || !isdigit((unsigned char)slash[1]))
+        return nullptr;
+
+    unsigned long p = strtoul(&slash[1], &end, 10);
+
+    if (*end || p > 0xFF)
+        return nullptr;
+
+    function = this->function(path, slash - path);
+    index = (uint8_t)p;
+    return nullptr;
+}
+
+IOTRegistry::Slot *IOTRegistry::_find(const char *path, size_t len, uint32_t hash)
+{
+    if (_slots == nullptr || path == nullptr)
+        return nullptr;
+
+    size_t mask = _size - 1;
+
+    for (size_t at = hash & mask; _slots[at].tag != nullptr; at = (at + 1) & mask)
+    {
+        if (_slots[at].hash == hash && _match(_slots[at], path, len))
+            return &_slots[at];
+    }
+    return nullptr;
+}
+
+/*
+** FNV-1a over the path, as the tag, a slash and the label
+*/
+uint32_t IOTRegistry::_hash(const char *tag, const char *label)
+{
+    uint32_t hash = _hash(FNV_OFFSET, tag, strlen(tag));
+
+    if (label != nullptr)
+    {
+        hash = _hash(hash, "/", 1);
+        hash = _hash(hash, label, strlen(label));
+    }
+    return hash;
+}
+
+uint32_t IOTRegistry::_hash(uint32_t hash, const char *text, size_t len)
+{
+    while (len--)
+        hash = (hash ^ (uint8_t)*text++) * FNV_PRIME;
+    return hash;
+}
+
+bool IOTRegistry::_match(const Slot &slot, const char *path, size_t len)
+{
+    size_t tagLen = strlen(slot.tag);
+
+    if (tagLen > len || memcmp(slot.tag, path, tagLen) != 0)
+        return false;
+    if (slot.label == nullptr)
+        return tagLen == len;
+
+    size_t labelLen = len - tagLen - 1;
+
+    return tagLen < len && path[tagLen] == '/' && strlen(slot.label) == labelLen &&
+           memcmp(slot.label, &path[tagLen + 1], labelLen) == 0;
+}
+
+/******************************************************************************/
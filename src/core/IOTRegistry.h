@@ -0,0 +1,88 @@
+/*
+** EasyIOT - Function and Property Registry
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_REGISTRY_H
+#define _IOT_REGISTRY_H
+
+#include <Arduino.h>
+
+/*
+** Forward References
+*/
+class IOTFunction;
+class IOTProperty;
+
+/*
+** Equates and Defintions
+*/
+#ifndef IOT_REGISTRY_SLOTS
+#define IOT_REGISTRY_SLOTS 32 // slots to begin with, doubled as the table fills
+#endif
+
+#define IOT_REGISTRY_PATH 64 // longest "tag/label" held
+
+/*
+** Function and Property Registry Class
+**
+** Finds a function by its tag, and a property by "tag/label", in a hash
+** table kept by the master.  Keys are not copied: a slot points at the
+** tag and label it was added with, so a label is removed before it is
+** changed and added again after.  Slots are probed in turn from the key's
+** hash, and a removal shifts back those that follow, so no marker is left
+** to slow later searches.
+**
+** A path is taken with a length, so a function can be found from the
+** front of a longer path without a copy.  resolve() takes a property's
+** whole path, "tag/label" or "tag/index"; for an index it gives the
+** function and the index, as only the function knows its properties.
+*/
+class IOTRegistry
+{
+public:
+  IOTRegistry() : _slots(nullptr), _size(0), _count(0) {}
+  ~IOTRegistry();
+
+  bool add(IOTFunction *function, const char *tag);
+  bool add(IOTFunction *function, IOTProperty *property, const char *tag, const char *label);
+  void remove(IOTFunction *function, IOTProperty *property, const char *tag, const char *label);
+
+  IOTFunction *function(const char *path, size_t len);
+  IOTProperty *property(const char *path, size_t len);
+  IOTProperty *resolve(const char *path, IOTFunction *&function, uint8_t &index);
+
+  size_t count(void) const { return _count; }
+
+private:
+  typedef struct
+  {
+    uint32_t hash;
+    const char *tag; // NULL when the slot is free
+    const char *label;
+    IOTFunction *function;
+    IOTProperty *property;
+  } Slot;
+
+  bool _add(const Slot &slot);
+  bool _grow(void);
+  Slot *_find(const char *path, size_t len, uint32_t hash);
+  static uint32_t _hash(const char *tag, const char *label);
+  static uint32_t _hash(uint32_t hash, const char *text, size_t len);
+  static bool _match(const Slot &slot, const char *path, size_t len);
+
+  Slot *_slots;
+  size_t _size;
+  size_t _count;
+};
+
+#endif // _IOT_REGISTRY_H
+/******************************************************************************/
@@ -0,0 +1,302 @@
+/*
+** EasyIOT - (HTTP) Static File Handler
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+#include "FILEHandler.h"
+
+/*
+** Mime Type Table
+*/
+static constexpr struct
+{
+    const char *ext;
+    const char *mime;
+} _mimeTypes[] = {
+    {"html", MIME_TYPE_HTML},
+    {"htm", MIME_TYPE_HTML},
+    {"css", MIME_TYPE_CSS},
+    {"txt", MIME_TYPE_TEXT},
+    {"js", MIME_TYPE_JAVA},
+    {"json", MIME_TYPE_JSON},
+    {"png", MIME_TYPE_PNG},
+    {"gif", MIME_TYPE_GIF},
+    {"jpg", MIME_TYPE_JPG},
+    {"ico", MIME_TYPE_ICO},
+    {"svg", MIME_TYPE_SVG},
+    {"ttf", "application/x-font-ttf"},
+    {"otf", "application/x-font-opentype"},
+    {"woff", "application/font-woff"},
+    {"woff2", "application/font-woff2"},
+    {"eot", "application/vnd.ms-fontobject"},
+    {"sfnt", "application/font-sfnt"},
+    {"xml", MIME_TYPE_XML},
+    {"pdf", "application/pdf"},
+    {"zip", "application/zip"},
+    {"gz", MIME_TYPE_GZIP},
+    {"appcache", "text/cache-manifest"}};
+
+const char *FILEHandler::mimeType(const char *path)
+{
+    const char *ext = strrchr(path, '.');
+
+    if (!ext || strchr(ext, '/'))
+        return MIME_TYPE_DATA;
+
+    ext++;
+    for (size_t m = 0; m < sizeof(_mimeTypes) / sizeof(_mimeTypes[0]); m++)
+    {
+        if (strcmp(_mimeTypes[m].ext, ext) == 0)
+            return _mimeTypes[m].mime;
+    }
+    return MIME_TYPE_DATA;
+}
+
+/*
+** Serve a file from the index
+*/
+bool FILEHandler::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    (void)requestMethod;
+    ESP_LOGD(server.iotTag(), "FILEHandler: request=%s _uri=%s\r\n", requestUri.c_str(), _uri.c_str());
+
+    String name;
+
+    if (!_isFile)
+    {
+        // Whatever follows the base URI names the file, a directory its index
+        name = requestUri.substring(_baseUriLength);
+        if (requestUri.endsWith("/"))
+            name += "index.htm";
+    }
+
+    FileEntry *entry = _find(name);
+    const char *match = server.headerValue(HTTP_HEADER_IF_NONE_MATCH);
+    char etag[FILE_ETAG_LEN];
+    File f;
+
+    if (!entry)
+        entry = _probe(name);
+
+    // A tag matching an entry checked lately needs nothing from the filesystem
+    bool held = entry && millis() - entry->checked < HTTP_FILE_CHECK_WAIT && _tagMatch(*entry, match, etag);
+
+    // Drop an entry the filesystem no longer agrees with and look again
+    for (int attempt = 0; !held && entry && attempt < 2; attempt++)
+    {
+        f = _fs.open(_filePath(*entry), "r");
+        if (f && f.size() == entry->size && f.getLastWrite() == entry->modified)
+        {
+            entry->checked = millis();
+            break;
+        }
+
+        if (f)
+            f.close();
+        _remove(entry);
+        entry = (attempt == 0) ? _probe(name) : nullptr;
+    }
+
+    if (!entry)
+        return false;
+
+    if (_cache_header.length() != 0)
+        server.sendHeader("Cache-Control", _cache_header);
+
+    if (held || _tagMatch(*entry, match, etag))
+    {
+        if (f)
+            f.close();
+        server.sendHeader("ETag", etag);
+        server.send(304);
+        return true;
+    }
+
+    // The sender holds the file from here and closes it once sent
+    server.streamFile(f, entry->mime, (entry->modified) ? etag : NULL);
+    return true;
+}
+
+/*
+** Form the entry's ETag, true if the browser already holds it
+*/
+bool FILEHandler::_tagMatch(const FileEntry &entry, const char *match, char *etag)
+{
+    snprintf(etag, FILE_ETAG_LEN, "\"%lx-%lx\"", (unsigned long)entry.modified, (unsigned long)entry.size);
+    return entry.modified && *match && (strcmp(match, "*") == 0 || strstr(match, etag));
+}
+
+/*
+** Rebuild the index from the filesystem
+*/
+void FILEHandler::httpRefresh(void)
+{
+    _indexCount = 0;
+
+    if (_isFile)
+    {
+        File f = _fs.open(_path, "r");
+
+        if (f)
+            _insert(String(), false, f);
+        return;
+    }
+
+    File dir = _fs.open(_path);
+
+    if (dir && dir.isDirectory())
+        _scan(dir);
+
+    ESP_LOGV("HTTP", "FILEHandler: indexed %u files below %s", _indexCount, _path.c_str());
+}
+
+void FILEHandler::_scan(File &dir)
+{
+    String base(dir.name());
+
+    if (!base.endsWith("/"))
+        base += "/";
+
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile())
+    {
+        if (f.isDirectory())
+        {
+            _scan(f);
+            continue;
+        }
+
+        // Older cores give the full path, newer ones the name alone
+        String path(f.name());
+
+        if (!path.startsWith("/"))
+            path = base + path;
+
+        if (!path.startsWith(_path))
+            continue;
+
+        String name = path.substring(_path.length());
+
+        _insert(name, false, f);
+        if (name.endsWith(".gz"))
+            _insert(name.substring(0, name.length() - 3), true, f);
+    }
+}
+
+/*
+** Look for a file the index hasn't seen, as the handler always did
+*/
+FILEHandler::FileEntry *FILEHandler::_probe(const String &name)
+{
+    String path = (_isFile) ? _path : _path + name;
+    bool gzip = false;
+
+    if (!_fs.exists(path))
+    {
+        if (path.endsWith(".gz") || !_fs.exists(path + ".gz"))
+            return nullptr;
+        path += ".gz";
+        gzip = true;
+    }
+
+    File f = _fs.open(path, "r");
+
+    if (!f || f.isDirectory())
+        return nullptr;
+
+    return _insert(name, gzip, f);
+}
+
+/*
+** Index Entries
+*/
+String FILEHandler::_filePath(const FileEntry &entry)
+{
+    String path = (_isFile) ? _path : _path + entry.name;
+
+    if (entry.gzip)
+        path += ".gz";
+    return path;
+}
+
+FILEHandler::FileEntry *FILEHandler::_find(const String &name)
+{
+    int lo = 0, hi = _indexCount - 1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        int cmp = strcmp(_index[mid].name.c_str(), name.c_str());
+
+        if (cmp == 0)
+            return &_index[mid];
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    return nullptr;
+}
+
+FILEHandler::FileEntry *FILEHandler::_insert(const String &name, bool gzip, File &f)
+{
+    FileEntry *entry = _find(name);
+
+    if (entry)
+    {
+        // A plain file wins over the gzip variant of the same name
+        if (gzip && !entry->gzip)
+            return entry;
+    }
+    else
+    {
+        if (_indexCount == _indexSize)
+        {
+            uint16_t grow = (_indexSize) ? _indexSize * 2 : 8;
+            FileEntry *index = new FileEntry[grow];
+
+            for (uint16_t e = 0; e < _indexCount; e++)
+                index[e] = _index[e];
+            delete[] _index;
+            _index = index;
+            _indexSize = grow;
+        }
+
+        uint16_t at = _indexCount;
+
+        while (at > 0 && strcmp(_index[at - 1].name.c_str(), name.c_str()) > 0)
+        {
+            _index[at] = _index[at - 1];
+            at--;
+        }
+        _indexCount++;
+        entry = &_index[at];
+        entry->name = name;
+    }
+
+    entry->mime = mimeType((_isFile) ? _path.c_str() : name.c_str());
+    entry->size = f.size();
+    entry->modified = f.getLastWrite();
+    entry->checked = millis();
+    entry->gzip = gzip;
+    return entry;
+}
+
+void FILEHandler::_remove(FileEntry *entry)
+{
+    uint16_t at = entry - _index;
+
+    for (; at + 1 < _indexCount; at++)
+        _index[at] = _index[at + 1];
+    _indexCount--;
+}
+
+/******************************************************************************/
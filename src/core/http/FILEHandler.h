@@ -17,16 +17,51 @@
 #ifndef _IOT_FILE_HANDLER_H
 #define _IOT_FILE_HANDLER_H
 
+#define FILE_ETAG_LEN 32 // "time-size" in hex, quoted
+
+/*
+** Static File Handler Class
+**
+** The files below the path are indexed as the handler is created, each
+** entry holding the file to open, whether it is a gzip variant, its MIME type,
+** size and time last written.  A request then costs a lookup rather than
+** exists() probes, and the time and size give an ETag so a browser holding
+** the file is answered with a 304 and no body.  A filesystem that keeps no
+** times gets no ETag, the file is always sent.
+**
+** The ETag is the time and size, not a hash of the content, so it is only as
+** good as the filesystem's clock: a file rewritten at the same size within
+** the same second keeps its tag.
+**
+** A miss probes the filesystem and adds what it finds.  An entry checked in
+** the last HTTP_FILE_CHECK_WAIT answers a 304 from the index alone, opening
+** nothing; otherwise the file is opened and an entry whose file has gone or
+** changed size or time is dropped and probed again.  httpRefresh() makes a
+** file just written visible at once.
+*/
 class FILEHandler : public HTTPHandler
 {
   public:
     FILEHandler(FS &fs, const char *path, const char *uri, const char *cache_header)
-        : _fs(fs), _uri(uri), _path(path), _cache_header(cache_header)
+        : _fs(fs), _uri(uri), _path(path), _cache_header(cache_header),
+          _index(nullptr), _indexCount(0), _indexSize(0)
     {
-        _isFile = fs.exists(path);
+        File f = fs.open(path, "r");
+
+        _isFile = f && !f.isDirectory();
         
         ESP_LOGV("HTTP", "FILEHandler: path=%s uri=%s isFile=%d, cache_header=%s\r\n", path, uri, _isFile, cache_header);
         _baseUriLength = _uri.length();
+        httpRefresh();
+    }
+
+    ~FILEHandler() { delete[] _index; }
+
+    bool httpRoute(HTTPRouter &router) override
+    {
+        // A directory serves everything below its URI
+        router.route(_uri.c_str(), HTTP_GET, this, !_isFile);
+        return true;
     }
 
     bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override
@@ -40,107 +75,42 @@ class FILEHandler : public HTTPHandler
         return true;
     }
 
-    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override
-    {
-        if (!httpCanHandle(requestMethod, requestUri))
-            return false;
-
-        ESP_LOGD(server.iotTag(), "FILEHandler: request=%s _uri=%s\r\n", requestUri.c_str(), _uri.c_str());
-
-        String path(_path);
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    void httpRefresh(void) override;
+    const char *httpName(void) override { return _uri.c_str(); }
 
-        if (!_isFile)
-        {
-            // Base URI doesn't point to a file.
-            // If a directory is requested, look for index file.
-            if (requestUri.endsWith("/"))
-                requestUri += "index.htm";
+    static const char *mimeType(const char *path);
+    static String getContentType(const String &path) { return mimeType(path.c_str()); }
 
-            // Append whatever follows this URI in request to get the file path.
-            path += requestUri.substring(_baseUriLength);
-        }
-
-        ESP_LOGD(server.iotTag(), "FILEHandler: path=%s, isFile=%d\r\n", path.c_str(), _isFile);
-
-        String contentType = getContentType(path);
-
-        // look for gz file, only if the original specified path is not a gz.  So part only works to send gzip via content encoding when a non compressed is asked for
-        // if you point the the path to gzip you will serve the gzip as content type "application/x-gzip", not text or javascript etc...
-        if (!path.endsWith(".gz") && !_fs.exists(path))
-        {
-            String pathWithGz = path + ".gz";
-            if (_fs.exists(pathWithGz))
-                path += ".gz";
-        }
-
-        File f = _fs.open(path, "r");
-        
-        if (!f)
-            return false;
-
-        if (_cache_header.length() != 0)
-            server.sendHeader("Cache-Control", _cache_header);
-
-        server.streamFile(f, contentType);
-        return true;
-    }
-
-    static String getContentType(const String &path)
+  protected:
+    typedef struct
     {
-        if (path.endsWith(".html"))
-            return MIME_TYPE_HTML;
-        else if (path.endsWith(".htm"))
-            return MIME_TYPE_HTML;
-        else if (path.endsWith(".css"))
-            return MIME_TYPE_CSS;
-        else if (path.endsWith(".txt"))
-            return MIME_TYPE_TEXT;
-        else if (path.endsWith(".js"))
-            return MIME_TYPE_JAVA;
-        else if (path.endsWith(".json"))
-            return MIME_TYPE_JSON;
-        else if (path.endsWith(".png"))
-            return MIME_TYPE_PNG;
-        else if (path.endsWith(".gif"))
-            return MIME_TYPE_GIF;
-        else if (path.endsWith(".jpg"))
-            return MIME_TYPE_JPG;
-        else if (path.endsWith(".ico"))
-            return MIME_TYPE_ICO;
-        else if (path.endsWith(".svg"))
-            return MIME_TYPE_SVG;
-        else if (path.endsWith(".ttf"))
-            return "application/x-font-ttf";
-        else if (path.endsWith(".otf"))
-            return "application/x-font-opentype";
-        else if (path.endsWith(".woff"))
-            return "application/font-woff";
-        else if (path.endsWith(".woff2"))
-            return "application/font-woff2";
-        else if (path.endsWith(".eot"))
-            return "application/vnd.ms-fontobject";
-        else if (path.endsWith(".sfnt"))
-            return "application/font-sfnt";
-        else if (path.endsWith(".xml"))
-            return MIME_TYPE_XML;
-        else if (path.endsWith(".pdf"))
-            return "application/pdf";
-        else if (path.endsWith(".zip"))
-            return "application/zip";
-        else if (path.endsWith(".gz"))
-            return "application/x-gzip";
-        else if (path.endsWith(".appcache"))
-            return "text/cache-manifest";
-        return MIME_TYPE_DATA;
-    }
+        String name; // request path below the URI
+        const char *mime;
+        uint32_t size;
+        time_t modified;  // 0 where the filesystem keeps no times
+        uint32_t checked; // millis() the file last agreed with the entry
+        bool gzip;        // served from name + ".gz"
+    } FileEntry;
+
+    String _filePath(const FileEntry &entry);
+    bool _tagMatch(const FileEntry &entry, const char *match, char *etag);
+    FileEntry *_find(const String &name);
+    FileEntry *_insert(const String &name, bool gzip, File &f);
+    FileEntry *_probe(const String &name);
+    void _remove(FileEntry *entry);
+    void _scan(File &dir);
 
-  protected:
     FS _fs;
     String _uri;
     String _path;
     String _cache_header;
     bool _isFile;
     size_t _baseUriLength;
+
+    FileEntry *_index; // sorted by name
+    uint16_t _indexCount;
+    uint16_t _indexSize;
 };
 
 #endif // _IOT_FILE_HANDLER_H
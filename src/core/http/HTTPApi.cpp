@@ -0,0 +1,324 @@
+/*
+** EasyIOT - (HTTP) REST Api Handler
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+static constexpr HTTPMethod _apiMethods[] = {HTTP_GET, HTTP_PUT, HTTP_PATCH};
+
+/*
+** Counts what is printed, keeping it too when given a String
+*/
+class _ApiMeasure : public Print
+{
+  public:
+    _ApiMeasure(String *text = nullptr) : len(0), _text(text) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        if (_text)
+            _text->concat((const char *)buf, size);
+        len += size;
+        return size;
+    }
+    using Print::write;
+
+    size_t len;
+
+  private:
+    String *_text;
+};
+
+bool HTTPApi::httpRoute(HTTPRouter &router)
+{
+    String prefix = _uri + "/";
+
+    for (HTTPMethod method : _apiMethods)
+    {
+        router.route(_uri.c_str(), method, this);
+        router.route(prefix.c_str(), method, this, true);
+    }
+    return true;
+}
+
+bool HTTPApi::httpCanHandle(HTTPMethod requestMethod, String requestUri)
+{
+    if (requestMethod != HTTP_GET && requestMethod != HTTP_PUT && requestMethod != HTTP_PATCH)
+        return false;
+
+    return requestUri == _uri || (requestUri.startsWith(_uri) && requestUri[_uri.length()] == '/');
+}
+
+bool HTTPApi::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    bool update = requestMethod != HTTP_GET;
+    char value[HTTP_API_VALUE + 1];
+    char tag[HTTP_API_TAG + 1];
+    int index = -1;
+    int code = 200;
+    Cursor at = {};
+
+    if (!_path(requestUri, tag, index))
+    {
+        server.send(404, MIME_TYPE_TEXT, "Not found");
+        return true;
+    }
+
+    // Anyone may look, only those with the credentials may change
+    if (update && server.webProtected() && !server.webAuthorized())
+    {
+        server.webAuthenticate();
+        return true;
+    }
+
+    if (update && index < 0)
+    {
+        server.sendHeader("Allow", "GET");
+        server.send(405, MIME_TYPE_TEXT, "Only a property can be set");
+        return true;
+    }
+
+    if (update && !_value(server, value, sizeof(value)))
+    {
+        server.send(400, MIME_TYPE_TEXT, "No value given");
+        return true;
+    }
+
+    // Find what was asked for, setting it now if it is to change
+    server.webSync([&]() {
+        int function = (tag[0]) ? _find(tag) : 0;
+
+        if (function < 0)
+            code = 404;
+        else if (index >= 0)
+            code = _pfn(function, index, (update) ? value : nullptr, nullptr);
+        at.function = (function < 0) ? 0 : function;
+    });
+
+    if (code != 200)
+    {
+        server.send(code, MIME_TYPE_TEXT, HTTPResponse::statusText(code));
+        return true;
+    }
+
+    at.all = !tag[0];
+    at.stage = (at.all) ? API_OPEN : (index < 0) ? API_FUNCTION : API_SINGLE;
+    at.index = (index < 0) ? 0 : index;
+
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendStream(200, MIME_TYPE_JSON, [this, at, &server](HTTPStream &out) mutable {
+        bool more = true;
+
+        server.webSync([&]() { more = _send(out, at); });
+        return more;
+    });
+    return true;
+}
+
+/*
+** Split the path below the URI into a tag and a property index
+*/
+bool HTTPApi::_path(const String &uri, char *tag, int &index)
+{
+    const char *at = uri.c_str() + _uri.length();
+    size_t len = 0;
+
+    tag[0] = '\0';
+    index = -1;
+
+    if (*at == '/')
+        at++;
+    while (*at && *at != '/')
+    {
+        if (len == HTTP_API_TAG)
+            return false;
+        tag[len++] = *at++;
+    }
+    tag[len] = '\0';
+
+    if (*at == '/')
+        at++;
+    if (!*at)
+        return true;
+
+    char *end;
+    unsigned long p = strtoul(at, &end, 10);
+
+    if (!len || !isdigit((unsigned char)*at) || p > 255 || (*end && strcmp(end, "/") != 0))
+        return false;
+
+    index = (int)p;
+    return true;
+}
+
+/*
+** The value to set, as an argument or the body
+*/
+bool HTTPApi::_value(IOTHTTP &server, char *value, size_t max)
+{
+    if (server.hasArg("value"))
+    {
+        snprintf(value, max, "%s", server.arg("value").c_str());
+        return true;
+    }
+
+    if (!server.hasArg("plain"))
+        return false;
+
+    String body = server.arg("plain");
+
+    body.trim();
+    if (body[0] == '{')
+        return HTTPJson::member(body.c_str(), "value", value, max);
+    if (body[0] == '"')
+        return HTTPJson::scalar(body.c_str(), value, max);
+
+    snprintf(value, max, "%s", body.c_str());
+    return true;
+}
+
+int HTTPApi::_find(const char *tag)
+{
+    const char *name;
+    const char *label;
+    uint8_t count;
+
+    for (int function = 0; function < 256 && (name = _ffn(function, count, label)); function++)
+    {
+        if (strcmp(name, tag) == 0)
+            return function;
+    }
+    return -1;
+}
+
+/*
+** Write while there is room, false once the document is complete.  A
+** function or property gone since the request began is left out, or is
+** null when it was the one asked for.
+*/
+bool HTTPApi::_send(HTTPStream &out, Cursor &at)
+{
+    HTTPJson &json = at.json;
+
+    json.attach(out);
+    while (_held(out, at) && out.room() >= HTTP_API_ROOM)
+    {
+        const char *label = nullptr;
+        const char *tag;
+
+        switch (at.stage)
+        {
+        case API_OPEN:
+            json.array();
+            at.stage = API_FUNCTION;
+            break;
+
+        case API_FUNCTION:
+            if (!(tag = _ffn(at.function, at.count, label)))
+            {
+                if (at.all)
+                    json.end();
+                else
+                    json.null(nullptr);
+                return false;
+            }
+            json.object().string("tag", tag).string("label", label).array("properties");
+            at.index = 0;
+            at.stage = API_PROPERTY;
+            break;
+
+        case API_PROPERTY:
+            if (at.index < at.count)
+            {
+                if (!_property(out, at))
+                    return true;
+                at.index++;
+                break;
+            }
+
+            json.end().end();
+            if (!at.all)
+                return false;
+            if (at.function++ == 255)
+            {
+                json.end();
+                return false;
+            }
+            at.stage = API_FUNCTION;
+            break;
+
+        case API_SINGLE:
+            if (!_property(out, at))
+                return true;
+            at.stage = API_DONE;
+            break;
+
+        case API_DONE:
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+** One property at the cursor, false to wait for room.  It is written first
+** to a copy of the writer only to be measured, which leaves the document as
+** it was.
+*/
+bool HTTPApi::_property(HTTPStream &out, Cursor &at)
+{
+    HTTPJson probe = at.json;
+    _ApiMeasure measure;
+
+    probe.attach(measure);
+    if (_pfn(at.function, at.index, nullptr, &probe) != 200)
+    {
+        if (at.stage == API_SINGLE)
+            at.json.null(nullptr);
+        return true;
+    }
+
+    if (measure.len <= out.room())
+        _pfn(at.function, at.index, nullptr, &at.json);
+    else if (measure.len <= out.capacity())
+        return false;
+    else
+    {
+        _ApiMeasure text(&at.held);
+
+        at.json.attach(text);
+        _pfn(at.function, at.index, nullptr, &at.json);
+        at.json.attach(out);
+        at.sent = 0;
+        (void)_held(out, at);
+    }
+    return true;
+}
+
+// What is left of a property rendered aside, true once it has all gone
+bool HTTPApi::_held(HTTPStream &out, Cursor &at)
+{
+    if (!at.held.length())
+        return true;
+
+    size_t len = std::min(out.room(), at.held.length() - at.sent);
+
+    at.sent += out.write((const uint8_t *)at.held.c_str() + at.sent, len);
+    if (at.sent < at.held.length())
+        return false;
+
+    at.held = String();
+    return true;
+}
+
+/******************************************************************************/
@@ -0,0 +1,107 @@
+/*
+** EasyIOT - (HTTP) REST Api Handler
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_API_H
+#define _IOT_HTTP_API_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_API_ROOM
+#define HTTP_API_ROOM 384 // room wanted before writing the next member, a property is measured first
+#endif
+
+#ifndef HTTP_API_VALUE
+#define HTTP_API_VALUE 256 // longest value taken from a request
+#endif
+
+#define HTTP_API_TAG 16 // longest function tag in a path
+
+/*
+** REST Api Handler Class
+**
+** Serves the function and property tree as JSON below its URI:
+**
+**   GET <uri>                    every function, an array
+**   GET <uri>/<tag>              one function and its properties
+**   GET <uri>/<tag>/<index>      one property
+**   PUT|PATCH <uri>/<tag>/<index> set a property, answered with it
+**
+** A value is set from a "value" argument, a JSON object with a "value"
+** member, a JSON string or the plain body as sent.  Once the server has
+** credentials from webLogin() a value is only set for a request carrying
+** them, while reads stay open.
+**
+** Functions are reached through the callbacks given, by their position in
+** the device's list, as positions are cheap to hold between writes.  The
+** function callback names the function at a position, NULL past the last.
+** The property callback writes one property as an object to the writer, or
+** sets it from the value when one is given, returning an HTTP status.
+**
+** Documents are written by a sender, as many properties at a time as the
+** response buffer has room for, so a dump of any size needs no more heap
+** than one property.  Each pass reaches the callbacks through webSync().
+** A property is measured before it is written and one that does not fit
+** waits for the next pass, while one longer than the buffer itself is
+** rendered aside and sent as there is room, so no pass waits on the socket.
+*/
+class HTTPApi : public HTTPHandler
+{
+  public:
+    typedef std::function<const char *(uint8_t function, uint8_t &properties, const char *&label)> function_t;
+    typedef std::function<int(uint8_t function, uint8_t index, const char *value, HTTPJson *json)> property_t;
+
+    HTTPApi(const char *uri, function_t ffn, property_t pfn) : _uri(uri), _ffn(ffn), _pfn(pfn) {}
+
+    bool httpRoute(HTTPRouter &router) override;
+    bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override;
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    const char *httpName(void) override { return _uri.c_str(); }
+
+  private:
+    enum Stage
+    {
+        API_OPEN,     // the array of every function
+        API_FUNCTION, // a function's own members
+        API_PROPERTY, // its properties, one at a time
+        API_SINGLE,   // the one property asked for
+        API_DONE      // all of it, once anything held has gone
+    };
+
+    typedef struct
+    {
+        HTTPJson json;
+        Stage stage;
+        uint8_t function;
+        uint8_t index;
+        uint8_t count;
+        bool all;
+        String held; // a property longer than the buffer, going out as there is room
+        size_t sent;
+    } Cursor;
+
+    bool _path(const String &uri, char *tag, int &index);
+    bool _value(IOTHTTP &server, char *value, size_t max);
+    int _find(const char *tag);
+    bool _send(HTTPStream &out, Cursor &at);
+    bool _property(HTTPStream &out, Cursor &at);
+    bool _held(HTTPStream &out, Cursor &at);
+
+    String _uri;
+    function_t _ffn;
+    property_t _pfn;
+};
+
+#endif // _IOT_HTTP_API_H
+
+/******************************************************************************/
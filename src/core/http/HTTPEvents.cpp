@@ -0,0 +1,205 @@
+/*
+** EasyIOT - (HTTP) Server-Sent Events
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+
+static_assert((HTTP_EVENT_BACKLOG & (HTTP_EVENT_BACKLOG - 1)) == 0, "HTTP_EVENT_BACKLOG must be a power of two");
+
+const char *LAST_EVENT_ID_HEADER = "Last-Event-ID";
+
+/*
+** Take a new listener, starting from the event after the last it saw if
+** that is still held, otherwise from the next one published
+*/
+bool HTTPEvents::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    (void)requestMethod;
+    (void)requestUri;
+
+    Listener *listener = nullptr;
+
+    for (int l = 0; l < HTTP_EVENT_CLIENTS && !listener; l++)
+    {
+        if (!_listeners[l].client)
+            listener = &_listeners[l];
+    }
+
+    if (!listener)
+    {
+        server.send(503, MIME_TYPE_TEXT, "Too many listeners");
+        return true;
+    }
+
+    int id = server.headerId(LAST_EVENT_ID_HEADER);
+
+    listener->next = _nextId;
+    if (server.hasHeader(id))
+    {
+        uint32_t oldest = (_nextId > HTTP_EVENT_BACKLOG) ? _nextId - HTTP_EVENT_BACKLOG : 1;
+        uint32_t last = strtoul(server.headerValue(id), NULL, 10);
+
+        if (last + 1 >= oldest && last < _nextId)
+            listener->next = last + 1;
+    }
+
+    server.sendHeader("Cache-Control", "no-cache");
+    listener->client = server.sendDetached(200, "text/event-stream");
+    listener->held = 0;
+    _send(*listener, "retry: 3000\n\n", 13);
+    return true;
+}
+
+/*
+** Keep a change, listeners are written to as the server is serviced
+*/
+void HTTPEvents::publish(const char *tag, uint8_t index, const char *value, time_t time)
+{
+    Event &event = _ring[_nextId & (HTTP_EVENT_BACKLOG - 1)];
+
+    event.id = _nextId++;
+    event.time = time;
+    event.tag = tag;
+    event.index = index;
+    strncpy(event.value, value, HTTP_EVENT_VALUE - 1);
+    event.value[HTTP_EVENT_VALUE - 1] = '\0';
+}
+
+void HTTPEvents::service(void)
+{
+    for (int l = 0; l < HTTP_EVENT_CLIENTS; l++)
+    {
+        Listener &listener = _listeners[l];
+
+        if (!listener.client)
+            continue;
+
+        if (!listener.client.connected())
+        {
+            listener.client = WiFiClient();
+            continue;
+        }
+
+        // The rest of an event goes before any other
+        if (!_flush(listener))
+            continue;
+
+        // Lapped by the ring, skip to the oldest event still held
+        if (_nextId - listener.next > HTTP_EVENT_BACKLOG)
+        {
+            char text[40];
+            uint32_t lost = _nextId - HTTP_EVENT_BACKLOG - listener.next;
+
+            if (!_send(listener, text, snprintf(text, sizeof(text), "event: dropped\ndata: %lu\n\n", (unsigned long)lost)))
+                continue;
+            listener.next += lost;
+        }
+
+        for (int burst = 0; burst < HTTP_EVENT_BURST && listener.next != _nextId && !listener.held; burst++)
+        {
+            if (!_sendEvent(listener, _ring[listener.next & (HTTP_EVENT_BACKLOG - 1)]))
+                break;
+            listener.next++;
+        }
+
+        if (listener.client && !listener.held && millis() - listener.lastSend > HTTP_EVENT_HEARTBEAT)
+            _send(listener, ": ping\n\n", 8);
+    }
+}
+
+void HTTPEvents::close(void)
+{
+    for (int l = 0; l < HTTP_EVENT_CLIENTS; l++)
+        _listeners[l].client = WiFiClient();
+}
+
+uint8_t HTTPEvents::listening(void) const
+{
+    uint8_t count = 0;
+
+    for (int l = 0; l < HTTP_EVENT_CLIENTS; l++)
+    {
+        if (_listeners[l].client)
+            count++;
+    }
+    return count;
+}
+
+/*
+** Writers, true once the text is taken, whole or with the rest held.  A
+** listener whose socket fails is dropped.
+*/
+bool HTTPEvents::_flush(Listener &listener)
+{
+    if (!listener.held)
+        return true;
+
+    int sent = ::send(listener.client.fd(), listener.rest, listener.held, MSG_DONTWAIT);
+
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            listener.client = WiFiClient();
+        return false;
+    }
+
+    listener.held -= sent;
+    memmove(listener.rest, &listener.rest[sent], listener.held);
+    listener.lastSend = millis();
+    return !listener.held;
+}
+
+bool HTTPEvents::_send(Listener &listener, const char *text, size_t len)
+{
+    int sent = ::send(listener.client.fd(), text, len, MSG_DONTWAIT);
+
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            listener.client = WiFiClient();
+        return false;
+    }
+
+    if ((size_t)sent < len)
+    {
+        listener.held = len - sent;
+        memcpy(listener.rest, &text[sent], listener.held);
+    }
+
+    listener.lastSend = millis();
+    return true;
+}
+
+bool HTTPEvents::_sendEvent(Listener &listener, const Event &event)
+{
+    char text[HTTP_EVENT_TEXT];
+    char value[HTTP_EVENT_VALUE * 2];
+    size_t v = 0;
+
+    // The value goes out as a JSON string
+    for (const char *c = event.value; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            value[v++] = '\\';
+        value[v++] = ((uint8_t)*c < 0x20) ? ' ' : *c;
+    }
+    value[v] = '\0';
+
+    int len = snprintf(text, sizeof(text), "id: %lu\nevent: update\ndata: {\"f\":\"%s\",\"p\":%u,\"v\":\"%s\",\"t\":%ld}\n\n",
+                       (unsigned long)event.id, event.tag, event.index, value, (long)event.time);
+
+    return _send(listener, text, std::min((size_t)len, sizeof(text) - 1));
+}
+
+/******************************************************************************/
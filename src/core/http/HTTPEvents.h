@@ -0,0 +1,110 @@
+/*
+** EasyIOT - (HTTP) Server-Sent Events
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_EVENTS_H
+#define _IOT_HTTP_EVENTS_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_EVENT_CLIENTS
+#define HTTP_EVENT_CLIENTS 4 // event streams held open at once
+#endif
+
+#ifndef HTTP_EVENT_BACKLOG
+#define HTTP_EVENT_BACKLOG 32 // events kept for a client that falls behind, a power of two
+#endif
+
+#ifndef HTTP_EVENT_VALUE
+#define HTTP_EVENT_VALUE 32 // longest property value carried by an event
+#endif
+
+#ifndef HTTP_EVENT_HEARTBEAT
+#define HTTP_EVENT_HEARTBEAT 15000 //ms of quiet before a comment keeps the stream alive
+#endif
+
+#define HTTP_EVENT_BURST 4                            // events written to one client per service pass
+#define HTTP_EVENT_TEXT (128 + HTTP_EVENT_VALUE * 2) // longest event as written
+
+/*
+** Event Stream Handler Class
+**
+** Serves a text/event-stream at its URI, each committed property change
+** being pushed as a small JSON event to every client listening.  Events are
+** kept in one ring and each client follows it with its own cursor, so the
+** backlog a slow client can build is bounded by the ring.  A client the ring
+** laps loses the oldest events and is told how many with a "dropped" event.
+** An event ID goes with each, a browser reconnecting with Last-Event-ID
+** resumes from the ring when it can.
+**
+** Writes never wait on the socket.  An event the socket takes only part of
+** has the rest held with its listener and sent before anything else, one
+** that it takes none of is tried again on the next pass.
+*/
+class HTTPEvents : public HTTPHandler
+{
+  public:
+    HTTPEvents(const char *uri) : _uri(uri), _nextId(1) {}
+    ~HTTPEvents() { close(); }
+
+    bool httpRoute(HTTPRouter &router) override
+    {
+        router.route(_uri.c_str(), HTTP_GET, this);
+        return true;
+    }
+
+    bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override
+    {
+        return requestMethod == HTTP_GET && requestUri == _uri;
+    }
+
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    const char *httpName(void) override { return _uri.c_str(); }
+
+    void publish(const char *tag, uint8_t index, const char *value, time_t time);
+    void service(void);
+    void close(void);
+    uint8_t listening(void) const;
+
+  private:
+    typedef struct
+    {
+        uint32_t id;
+        time_t time;
+        const char *tag;
+        uint8_t index;
+        char value[HTTP_EVENT_VALUE];
+    } Event;
+
+    typedef struct
+    {
+        WiFiClient client;
+        uint32_t next; // ID of the next event to send
+        unsigned long lastSend;
+        uint16_t held; // bytes of a part written event still to send
+        char rest[HTTP_EVENT_TEXT];
+    } Listener;
+
+    bool _flush(Listener &listener);
+    bool _send(Listener &listener, const char *text, size_t len);
+    bool _sendEvent(Listener &listener, const Event &event);
+
+    String _uri;
+    Event _ring[HTTP_EVENT_BACKLOG];
+    uint32_t _nextId;
+    Listener _listeners[HTTP_EVENT_CLIENTS];
+};
+
+#endif // _IOT_HTTP_EVENTS_H
+
+/******************************************************************************/
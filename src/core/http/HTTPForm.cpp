@@ -0,0 +1,128 @@
+/*
+** EasyIOT - (HTTP) Form Decoder
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+static int _hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void HTTPFormDecoder::reset(void)
+{
+    _keyLen = 0;
+    _valueLen = 0;
+    _escaped = 0;
+    _inValue = false;
+}
+
+void HTTPFormDecoder::feed(const uint8_t *data, size_t len)
+{
+    while (len--)
+        _byte((char)*data++);
+}
+
+/*
+** The body is done, pass on the field it ended in
+*/
+void HTTPFormDecoder::end(void)
+{
+    _unescape();
+    _field();
+    reset();
+}
+
+void HTTPFormDecoder::_byte(char c)
+{
+    // Collect the two digits of an escape, a broken one is kept as it was
+    if (_escaped)
+    {
+        if (_hexValue(c) >= 0)
+        {
+            _escape[_escaped++ - 1] = c;
+            if (_escaped == 3)
+            {
+                _escaped = 0;
+                _put((char)((_hexValue(_escape[0]) << 4) | _hexValue(_escape[1])));
+            }
+            return;
+        }
+        _unescape();
+    }
+
+    if (c == '&')
+    {
+        _field();
+        reset();
+    }
+    else if (c == '=' && !_inValue)
+        _inValue = true;
+    else if (c == '%')
+        _escaped = 1;
+    else
+        _put((c == '+') ? ' ' : c);
+}
+
+/*
+** An escape cut short by the next byte, or the end, stands for itself
+*/
+void HTTPFormDecoder::_unescape(void)
+{
+    if (!_escaped)
+        return;
+
+    uint8_t seen = _escaped - 1;
+
+    _escaped = 0;
+    _put('%');
+    for (uint8_t d = 0; d < seen; d++)
+        _put(_escape[d]);
+}
+
+void HTTPFormDecoder::_put(char c)
+{
+    if (!_inValue)
+    {
+        if (_keyLen < HTTP_FORM_KEYLEN)
+            _key[_keyLen++] = c;
+        return;
+    }
+
+    // A full buffer goes on as a piece, the value continues in the next
+    if (_valueLen == HTTP_FORM_VALUELEN)
+    {
+        _key[_keyLen] = '\0';
+        _value[_valueLen] = '\0';
+        _fn(_key, _value, _valueLen, false);
+        _valueLen = 0;
+    }
+    _value[_valueLen++] = c;
+}
+
+void HTTPFormDecoder::_field(void)
+{
+    if (!_inValue)
+        return;
+
+    _key[_keyLen] = '\0';
+    _value[_valueLen] = '\0';
+    _fn(_key, _value, _valueLen, true);
+}
+
+/******************************************************************************/
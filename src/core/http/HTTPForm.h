@@ -0,0 +1,67 @@
+/*
+** EasyIOT - (HTTP) Form Decoder
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_FORM_H
+#define _IOT_HTTP_FORM_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_FORM_KEYLEN
+#define HTTP_FORM_KEYLEN 32 // longest field name kept, the rest of a longer one is dropped
+#endif
+
+#ifndef HTTP_FORM_VALUELEN
+#define HTTP_FORM_VALUELEN 128 // value bytes held, a longer value is passed on in pieces
+#endif
+
+/*
+** Form Decoder Class
+**
+** Tokenizes an application/x-www-form-urlencoded body fed to it in blocks
+** of any size, as a streaming handler receives them, decoding escapes that
+** straddle two blocks.  Only the current field is held; each value goes to
+** the callback once complete, or in pieces if it outgrows the buffer, the
+** last with final set.  Fields without an '=' are skipped, as they are for
+** the query string.
+*/
+class HTTPFormDecoder
+{
+  public:
+    typedef std::function<void(const char *key, const char *value, size_t len, bool final)> field_t;
+
+    HTTPFormDecoder(field_t fn) : _fn(fn) { reset(); }
+
+    void reset(void);
+    void feed(const uint8_t *data, size_t len);
+    void end(void);
+
+  private:
+    void _byte(char c);
+    void _put(char c);
+    void _unescape(void);
+    void _field(void);
+
+    field_t _fn;
+    char _key[HTTP_FORM_KEYLEN + 1];
+    char _value[HTTP_FORM_VALUELEN + 1];
+    char _escape[2]; // hex digits seen since a '%'
+    uint8_t _escaped;
+    uint8_t _keyLen;
+    uint16_t _valueLen;
+    bool _inValue;
+};
+
+#endif // _IOT_HTTP_FORM_H
+
+/******************************************************************************/
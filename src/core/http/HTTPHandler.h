@@ -37,6 +37,8 @@
 #define MIME_TYPE_JS MIME_TYPE_JAVA
 #define MIME_TYPE_JPEG MIME_TYPE_JPG
 
+class HTTPRouter;
+
 /*
 ** HTTP Handler (Abstract) Class
 */
@@ -51,6 +53,16 @@ class HTTPHandler
         // httpUploadable
         // httpUpload
 
+    // Register the URIs served with the router, return false to be asked
+    // through httpCanHandle for every request instead
+    virtual bool httpRoute(HTTPRouter &router)
+    {
+        (void)router;
+        return false;
+    }
+
+    // The URI is passed by value as it always has been, so a handler written
+    // against these signatures still overrides them
     virtual bool httpCanHandle(HTTPMethod method, String uri)
     {
         (void)method;
@@ -72,6 +84,15 @@ class HTTPHandler
         return false;
     }
 
+    // Take a body other than a multipart form through httpUpload, a block at
+    // a time as it arrives, rather than held whole as the "plain" argument.
+    // A block is whatever came since the last, of any size up to the buffer.
+    virtual bool httpCanStream(const String &uri)
+    {
+        (void)uri;
+        return false;
+    }
+
     virtual void httpUpload(IOTHTTP &server, String requestUri, HTTPUpload &upload)
     {
         (void)server;
@@ -79,6 +100,12 @@ class HTTPHandler
         (void)upload;
     }
 
+    // Forget anything cached about the filesystem or other backing store
+    virtual void httpRefresh(void) {}
+
+    // Name the route in metrics, usually the URI it was registered with
+    virtual const char *httpName(void) { return nullptr; }
+
     HTTPHandler *nextHandler() { return _httpNext; }
     void nextHandler(HTTPHandler *r) { _httpNext = r; }
 
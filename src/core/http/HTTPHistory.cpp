@@ -0,0 +1,163 @@
+/*
+** EasyIOT - (HTTP) Property History Handler
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+static constexpr struct
+{
+    const char *name;
+    HISTORY_TIER tier;
+} _historyTiers[] = {
+    {"raw", HISTORY_TIER::RAW},
+    {"1m", HISTORY_TIER::MINUTE},
+    {"15m", HISTORY_TIER::QUARTER},
+};
+
+bool HTTPHistory::httpRoute(HTTPRouter &router)
+{
+    String prefix = _uri + "/";
+
+    router.route(prefix.c_str(), HTTP_GET, this, true);
+    return true;
+}
+
+bool HTTPHistory::httpCanHandle(HTTPMethod requestMethod, String requestUri)
+{
+    if (requestMethod != HTTP_GET)
+        return false;
+
+    return requestUri.startsWith(_uri) && requestUri[_uri.length()] == '/';
+}
+
+bool HTTPHistory::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    (void)requestMethod;
+
+    const char *path = requestUri.c_str() + _uri.length() + 1;
+    bool found = false;
+    Query query = {};
+
+    if (!*path || strlen(path) > HTTP_HISTORY_PATH)
+    {
+        server.send(404, MIME_TYPE_TEXT, "Not found");
+        return true;
+    }
+
+    if (!_tier(server.arg("res"), query.tier))
+    {
+        server.send(400, MIME_TYPE_TEXT, "Resolution is raw, 1m or 15m");
+        return true;
+    }
+
+    strcpy(query.path, path);
+    query.from = (server.hasArg("from")) ? strtoul(server.arg("from").c_str(), nullptr, 10) : 0;
+    query.to = (server.hasArg("to")) ? strtoul(server.arg("to").c_str(), nullptr, 10) : UINT32_MAX;
+
+    server.webSync([&]() { found = _lookup(query.path) != nullptr; });
+
+    if (!found)
+    {
+        server.send(404, MIME_TYPE_TEXT, "No history kept");
+        return true;
+    }
+
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendStream(200, MIME_TYPE_JSON, [this, query, &server](HTTPStream &out) mutable {
+        bool more = true;
+
+        server.webSync([&]() { more = _send(out, query); });
+        return more;
+    });
+    return true;
+}
+
+// No resolution asked for is raw
+bool HTTPHistory::_tier(const String &res, HISTORY_TIER &tier)
+{
+    tier = HISTORY_TIER::RAW;
+    if (!res.length())
+        return true;
+
+    for (const auto &named : _historyTiers)
+    {
+        if (res == named.name)
+        {
+            tier = named.tier;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+** Write while there is room, false once the document is complete.  The
+** history is found again on each pass, a property gone since the request
+** began ending its samples where they stand.
+*/
+bool HTTPHistory::_send(HTTPStream &out, Query &query)
+{
+    IOTHistory *history = _lookup(query.path);
+    HTTPJson &json = query.json;
+    char value[IOT_CODEC_NUMBER];
+    bool more = history != nullptr;
+
+    json.attach(out);
+    if (!query.opened)
+    {
+        json.object().string("path", query.path);
+        json.string("resolution", _historyTiers[(int)query.tier].name);
+        json.number("places", (unsigned long)((history) ? history->places() : 0));
+        json.array("samples");
+        query.opened = true;
+    }
+
+    while (more && out.room() >= HTTP_HISTORY_ROOM)
+    {
+        uint8_t places = history->places();
+        IOTHistoryBucket bucket;
+        int64_t units;
+
+        if (query.tier == HISTORY_TIER::RAW)
+        {
+            if (!(more = history->next(query.at, bucket.time, units) && bucket.time <= query.to))
+                break;
+            if (bucket.time < query.from)
+                continue;
+
+            IOTHistory::toChars(value, sizeof(value), units, places);
+            json.array().number(nullptr, (unsigned long)bucket.time).literal(nullptr, value).end();
+            continue;
+        }
+
+        if (!(more = history->next(query.tier, query.at, bucket) && bucket.time <= query.to))
+            break;
+        if (bucket.time < query.from)
+            continue;
+
+        json.array().number(nullptr, (unsigned long)bucket.time);
+        for (int32_t part : {bucket.min, bucket.max, bucket.avg})
+        {
+            IOTHistory::toChars(value, sizeof(value), part, places);
+            json.literal(nullptr, value);
+        }
+        json.end();
+    }
+
+    if (more)
+        return true;
+
+    json.end().end();
+    return false;
+}
+
+/******************************************************************************/
@@ -0,0 +1,78 @@
+/*
+** EasyIOT - (HTTP) Property History Handler
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_HISTORY_H
+#define _IOT_HTTP_HISTORY_H
+
+#include "../IOTHistory.h"
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_HISTORY_ROOM
+#define HTTP_HISTORY_ROOM 96 // room wanted before writing the next sample
+#endif
+
+#define HTTP_HISTORY_PATH 64 // longest property path
+
+/*
+** Property History Handler Class
+**
+** Serves a property's history as JSON below its URI, the path naming the
+** property as IOTFunction::Resolve() takes it:
+**
+**   GET <uri>/<tag>/<label|index>[?res=raw|1m|15m][&from=<time>][&to=<time>]
+**
+** Raw samples are [time, value], buckets [time, min, max, avg], with the
+** values written exactly to the places the history keeps.  Times are
+** seconds since the epoch, a range is inclusive.
+**
+** The samples are written by a sender, as many at a time as the response
+** buffer has room for, reading the history through webSync() from a
+** cursor, so a query of any length needs no buffer of its own.
+*/
+class HTTPHistory : public HTTPHandler
+{
+  public:
+    typedef std::function<IOTHistory *(const char *path)> lookup_t;
+
+    HTTPHistory(const char *uri, lookup_t lookup) : _uri(uri), _lookup(lookup) {}
+
+    bool httpRoute(HTTPRouter &router) override;
+    bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override;
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    const char *httpName(void) override { return _uri.c_str(); }
+
+  private:
+    typedef struct
+    {
+        HTTPJson json;
+        IOTHistory *history;
+        IOTHistory::Cursor at;
+        HISTORY_TIER tier;
+        uint32_t from;
+        uint32_t to;
+        bool opened;
+        char path[HTTP_HISTORY_PATH + 1];
+    } Query;
+
+    bool _tier(const String &res, HISTORY_TIER &tier);
+    bool _send(HTTPStream &out, Query &query);
+
+    String _uri;
+    lookup_t _lookup;
+};
+
+#endif // _IOT_HTTP_HISTORY_H
+
+/******************************************************************************/
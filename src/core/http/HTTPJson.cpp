@@ -0,0 +1,473 @@
+/*
+** EasyIOT - (HTTP) JSON Writer
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+static_assert(HTTP_JSON_DEPTH < 32, "HTTP_JSON_DEPTH levels must fit the bit masks");
+
+static constexpr char _hexDigits[] = "0123456789abcdef";
+
+void HTTPJson::reset(void)
+{
+    _arrays = 0;
+    _filled = 0;
+    _depth = 0;
+    _lost = 0;
+    _quoted = false;
+}
+
+/*
+** Containers
+*/
+HTTPJson &HTTPJson::_open(const char *key, char bracket, bool array)
+{
+    if (_depth == HTTP_JSON_DEPTH)
+    {
+        _lost++;
+        return *this;
+    }
+
+    _key(key, bracket);
+    _depth++;
+    _filled &= ~(1UL << _depth);
+    if (array)
+        _arrays |= 1UL << _depth;
+    else
+        _arrays &= ~(1UL << _depth);
+    return *this;
+}
+
+HTTPJson &HTTPJson::end(void)
+{
+    if (_quoted)
+        unquote();
+
+    if (_lost)
+        _lost--;
+    else if (_depth)
+    {
+        _out->write((uint8_t)((_arrays & (1UL << _depth)) ? ']' : '}'));
+        _depth--;
+    }
+    return *this;
+}
+
+/*
+** Values
+*/
+HTTPJson &HTTPJson::string(const char *key, const char *value)
+{
+    if (!value)
+        return null(key);
+
+    quote(key);
+    _escape((const uint8_t *)value, strlen(value));
+    return unquote();
+}
+
+HTTPJson &HTTPJson::number(const char *key, long value)
+{
+    _key(key);
+    _digits((value < 0) ? 0 - (unsigned long)value : value, value < 0);
+    return *this;
+}
+
+HTTPJson &HTTPJson::number(const char *key, unsigned long value)
+{
+    _key(key);
+    _digits(value, false);
+    return *this;
+}
+
+HTTPJson &HTTPJson::boolean(const char *key, bool value)
+{
+    _key(key);
+    _out->write((value) ? "true" : "false");
+    return *this;
+}
+
+HTTPJson &HTTPJson::null(const char *key)
+{
+    _key(key);
+    _out->write("null");
+    return *this;
+}
+
+HTTPJson &HTTPJson::literal(const char *key, const char *text)
+{
+    _key(key);
+    _out->write(text);
+    return *this;
+}
+
+HTTPJson &HTTPJson::quote(const char *key)
+{
+    if (_quoted)
+        unquote();
+
+    _key(key, '"');
+    _quoted = true;
+    return *this;
+}
+
+HTTPJson &HTTPJson::unquote(void)
+{
+    if (_quoted)
+    {
+        _out->write((uint8_t)'"');
+        _quoted = false;
+    }
+    return *this;
+}
+
+/*
+** Separate the value from the last, naming it if in an object, and open
+** it.  Each is one write, the keys in use are short and plain.
+*/
+void HTTPJson::_key(const char *key, char open)
+{
+    uint32_t bit = 1UL << _depth;
+    char text[HTTP_JSON_KEYLEN + 6];
+    size_t len = 0;
+
+    if (_filled & bit)
+        text[len++] = ',';
+    _filled |= bit;
+
+    if (key && !(_arrays & bit))
+    {
+        text[len++] = '"';
+        while (*key && len < HTTP_JSON_KEYLEN + 1 && (uint8_t)*key >= 0x20 && *key != '"' && *key != '\\')
+            text[len++] = *key++;
+
+        // A long key, or one to escape, goes out the slow way
+        if (*key)
+        {
+            _out->write((const uint8_t *)text, len);
+            _escape((const uint8_t *)key, strlen(key));
+            len = 0;
+        }
+        text[len++] = '"';
+        text[len++] = ':';
+    }
+
+    if (open)
+        text[len++] = open;
+    if (len)
+        _out->write((const uint8_t *)text, len);
+}
+
+void HTTPJson::_digits(unsigned long value, bool negative)
+{
+    char text[24];
+    char *at = &text[sizeof(text)];
+
+    do
+    {
+        *--at = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    if (negative)
+        *--at = '-';
+    _out->write((const uint8_t *)at, &text[sizeof(text)] - at);
+}
+
+/*
+** Printed text, escaped while a string is open
+*/
+size_t HTTPJson::write(const uint8_t *buf, size_t size)
+{
+    if (!_out)
+        return 0;
+    if (!_quoted)
+        return _out->write(buf, size);
+    return _escape(buf, size);
+}
+
+size_t HTTPJson::_escape(const uint8_t *buf, size_t size)
+{
+    size_t done = 0;
+
+    while (done < size)
+    {
+        // Pass runs that need no escape on whole
+        size_t run = done;
+
+        while (run < size && buf[run] >= 0x20 && buf[run] != '"' && buf[run] != '\\')
+            run++;
+
+        if (run > done)
+        {
+            if (_out->write(&buf[done], run - done) != run - done)
+                break;
+            done = run;
+            continue;
+        }
+
+        char text[6] = {'\\', 0};
+        size_t len = 2;
+
+        switch (buf[done])
+        {
+        case '"':
+        case '\\':
+            text[1] = buf[done];
+            break;
+        case '\b':
+            text[1] = 'b';
+            break;
+        case '\f':
+            text[1] = 'f';
+            break;
+        case '\n':
+            text[1] = 'n';
+            break;
+        case '\r':
+            text[1] = 'r';
+            break;
+        case '\t':
+            text[1] = 't';
+            break;
+        default:
+            memcpy(&text[1], "u00", 3);
+            text[4] = _hexDigits[buf[done] >> 4];
+            text[5] = _hexDigits[buf[done] & 0x0F];
+            len = 6;
+            break;
+        }
+
+        if (_out->write((const uint8_t *)text, len) != len)
+            break;
+        done++;
+    }
+    return done;
+}
+
+/*
+** Reading, enough to take a value from a request body
+*/
+static const char *_space(const char *at)
+{
+    while (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n')
+        at++;
+    return at;
+}
+
+static int _hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// Escaped code points go out as UTF-8, a surrogate or NUL as '?'
+static size_t _utf8(uint32_t code, char *text)
+{
+    if (!code || (code >= 0xD800 && code <= 0xDFFF))
+    {
+        text[0] = '?';
+        return 1;
+    }
+    if (code < 0x80)
+    {
+        text[0] = (char)code;
+        return 1;
+    }
+    if (code < 0x800)
+    {
+        text[0] = 0xC0 | (code >> 6);
+        text[1] = 0x80 | (code & 0x3F);
+        return 2;
+    }
+
+    text[0] = 0xE0 | (code >> 12);
+    text[1] = 0x80 | ((code >> 6) & 0x3F);
+    text[2] = 0x80 | (code & 0x3F);
+    return 3;
+}
+
+// Decode the string opening at a quote into value, cut to fit, returning
+// what follows its closing quote or NULL if it has none
+static const char *_string(const char *at, char *value, size_t max)
+{
+    size_t len = 0;
+
+    for (at++; *at != '"'; at++)
+    {
+        char c = *at;
+        uint32_t code = 0;
+        bool escaped = false;
+
+        if (!c || (uint8_t)c < 0x20)
+            return nullptr;
+
+        if (c == '\\')
+        {
+            switch (*++at)
+            {
+            case 'b':
+                c = '\b';
+                break;
+            case 'f':
+                c = '\f';
+                break;
+            case 'n':
+                c = '\n';
+                break;
+            case 'r':
+                c = '\r';
+                break;
+            case 't':
+                c = '\t';
+                break;
+            case '"':
+            case '\\':
+            case '/':
+                c = *at;
+                break;
+            case 'u':
+                for (int d = 1; d <= 4; d++)
+                {
+                    int v = _hexValue(at[d]);
+
+                    if (v < 0)
+                        return nullptr;
+                    code = (code << 4) | v;
+                }
+                at += 4;
+                escaped = true;
+                break;
+            default:
+                return nullptr;
+            }
+        }
+
+        char text[3] = {c};
+        size_t n = (escaped) ? _utf8(code, text) : 1;
+
+        if (value && len + n < max)
+        {
+            memcpy(&value[len], text, n);
+            len += n;
+        }
+    }
+
+    if (value && max)
+        value[len] = '\0';
+    return at + 1;
+}
+
+// Step over a value of any kind, NULL if it is broken
+static const char *_skip(const char *at)
+{
+    int depth = 0;
+
+    do
+    {
+        at = _space(at);
+        if (*at == '"')
+        {
+            if (!(at = _string(at, nullptr, 0)))
+                return nullptr;
+            continue;
+        }
+        if (*at == '{' || *at == '[')
+            depth++;
+        else if (*at == '}' || *at == ']')
+            depth--;
+        else if (!*at)
+            return nullptr;
+        else if (!depth)
+        {
+            while (*at && !strchr(",}] \t\r\n", *at))
+                at++;
+            return at;
+        }
+        at++;
+    } while (depth > 0);
+    return at;
+}
+
+/*
+** A string is decoded, a number or literal copied as written, true and
+** false becoming "1" and "0" as the properties take them.  Null, objects
+** and arrays are not scalars.
+*/
+bool HTTPJson::scalar(const char *json, char *value, size_t max)
+{
+    const char *at = _space(json);
+
+    if (!max)
+        return false;
+    if (*at == '"')
+        return _string(at, value, max) != nullptr;
+    if (*at == '{' || *at == '[' || !*at)
+        return false;
+
+    const char *end = _skip(at);
+    size_t len = end - at;
+
+    if ((len == 4 && strncmp(at, "null", 4) == 0))
+        return false;
+    if (len == 4 && strncmp(at, "true", 4) == 0)
+        at = "1", len = 1;
+    else if (len == 5 && strncmp(at, "false", 5) == 0)
+        at = "0", len = 1;
+
+    if (len >= max)
+        len = max - 1;
+    memcpy(value, at, len);
+    value[len] = '\0';
+    return true;
+}
+
+/*
+** Find a member of the outermost object by name and take its value
+*/
+bool HTTPJson::member(const char *json, const char *key, char *value, size_t max)
+{
+    const char *at = _space(json);
+
+    if (*at++ != '{')
+        return false;
+
+    for (;;)
+    {
+        char name[HTTP_JSON_KEYLEN + 1];
+
+        at = _space(at);
+        if (*at != '"' || !(at = _string(at, name, sizeof(name))))
+            return false;
+
+        at = _space(at);
+        if (*at++ != ':')
+            return false;
+
+        if (strcmp(name, key) == 0)
+            return scalar(at, value, max);
+
+        if (!(at = _skip(at)))
+            return false;
+
+        at = _space(at);
+        if (*at++ != ',')
+            return false;
+    }
+}
+
+/******************************************************************************/
@@ -0,0 +1,89 @@
+/*
+** EasyIOT - (HTTP) JSON Writer
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_JSON_H
+#define _IOT_HTTP_JSON_H
+
+/*
+** Equates and Defintions
+*/
+#define HTTP_JSON_DEPTH 16  // objects and arrays one writer can have open, deeper ones are not written
+#define HTTP_JSON_KEYLEN 32 // longest member name matched by member()
+
+/*
+** JSON Writer Class
+**
+** Writes JSON straight to a Print, normally the HTTPStream of a response,
+** so a document of any size is built without holding it anywhere.  The
+** writer only remembers which objects and arrays are open and whether each
+** has a value yet, to place the commas; that state is small enough to be
+** kept between the calls of a sender and attached to each new stream.
+**
+** Between quote() and unquote() everything printed to the writer itself is
+** escaped into one string value, so a property can print its value in
+** place.  Outside a string, printing writes raw JSON, a number for one.
+**
+** member() goes the other way, taking one scalar from a small object such
+** as a request body, without a parse tree.
+*/
+class HTTPJson : public Print
+{
+  public:
+    HTTPJson() : _out(nullptr) { reset(); }
+    HTTPJson(Print &out) : _out(&out) { reset(); }
+
+    void attach(Print &out) { _out = &out; }
+    void reset(void);
+    uint8_t depth(void) const { return _depth; }
+
+    // A key is given for a member of an object, left NULL in an array
+    HTTPJson &object(const char *key = nullptr) { return _open(key, '{', false); }
+    HTTPJson &array(const char *key = nullptr) { return _open(key, '[', true); }
+    HTTPJson &end(void);
+
+    HTTPJson &string(const char *key, const char *value);
+    HTTPJson &number(const char *key, long value);
+    HTTPJson &number(const char *key, unsigned long value);
+    HTTPJson &number(const char *key, int value) { return number(key, (long)value); }
+    HTTPJson &number(const char *key, unsigned int value) { return number(key, (unsigned long)value); }
+    HTTPJson &boolean(const char *key, bool value);
+    HTTPJson &null(const char *key);
+    HTTPJson &literal(const char *key, const char *text); // as it is, a number formatted by the caller
+
+    HTTPJson &quote(const char *key = nullptr);
+    HTTPJson &unquote(void);
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+
+    static bool member(const char *json, const char *key, char *value, size_t max);
+    static bool scalar(const char *json, char *value, size_t max);
+
+  private:
+    HTTPJson &_open(const char *key, char bracket, bool array);
+    void _key(const char *key, char open = 0);
+    void _digits(unsigned long value, bool negative);
+    size_t _escape(const uint8_t *buf, size_t size);
+
+    Print *_out;
+    uint32_t _arrays; // a bit per level, set where it is an array
+    uint32_t _filled; // a bit per level, set once it holds a value
+    uint8_t _depth;
+    uint8_t _lost; // opened past HTTP_JSON_DEPTH, and not written
+    bool _quoted;
+};
+
+#endif // _IOT_HTTP_JSON_H
+
+/******************************************************************************/
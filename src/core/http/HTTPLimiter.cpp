@@ -0,0 +1,88 @@
+/*
+** EasyIOT - (HTTP) Admission Control
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+void HTTPLimiter::configure(uint16_t rate, uint16_t burst)
+{
+    _rate = rate;
+    _burst = (burst) ? burst : 1;
+    clear();
+}
+
+/*
+** True if the address has a token, without taking it
+*/
+bool HTTPLimiter::ready(uint32_t address, unsigned long now)
+{
+    if (!_rate)
+        return true;
+    return _find(address, now)->tokens >= 1000;
+}
+
+bool HTTPLimiter::take(uint32_t address, unsigned long now)
+{
+    if (!_rate)
+        return true;
+
+    Bucket *bucket = _find(address, now);
+
+    if (bucket->tokens < 1000)
+        return false;
+    bucket->tokens -= 1000;
+    return true;
+}
+
+/*
+** The address's bucket, topped up for the time since it was last used
+*/
+HTTPLimiter::Bucket *HTTPLimiter::_find(uint32_t address, unsigned long now)
+{
+    uint32_t full = (uint32_t)_burst * 1000;
+    Bucket *oldest = &_buckets[0];
+
+    for (int b = 0; b < HTTP_RATE_CLIENTS; b++)
+    {
+        Bucket *bucket = &_buckets[b];
+
+        // Slots fill in order, the first free one ends the search
+        if (!bucket->address)
+        {
+            oldest = bucket;
+            break;
+        }
+
+        if (bucket->address == address)
+        {
+            uint32_t elapsed = now - bucket->last;
+
+            // Anything over the time to fill is as good as full
+            if (elapsed >= full / _rate)
+                bucket->tokens = full;
+            else if ((bucket->tokens += elapsed * _rate) > full)
+                bucket->tokens = full;
+            bucket->last = now;
+            return bucket;
+        }
+
+        if ((long)(bucket->last - oldest->last) < 0)
+            oldest = bucket;
+    }
+
+    oldest->address = address;
+    oldest->tokens = full;
+    oldest->last = now;
+    return oldest;
+}
+
+/******************************************************************************/
@@ -0,0 +1,81 @@
+/*
+** EasyIOT - (HTTP) Admission Control
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_LIMITER_H
+#define _IOT_HTTP_LIMITER_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_RATE_CLIENTS
+#define HTTP_RATE_CLIENTS 8 // remote addresses given their own bucket, the least recent is reused
+#endif
+
+#ifndef HTTP_RATE_LIMIT
+#define HTTP_RATE_LIMIT 0 // requests per second refilled into each bucket, 0 disables
+#endif
+
+#ifndef HTTP_RATE_BURST
+#define HTTP_RATE_BURST 40 // requests a bucket holds, what an idle client may send at once
+#endif
+
+/*
+** Admission Control Class
+**
+** A token bucket per remote address, held in a small fixed table so a flood
+** of addresses costs no memory.  Buckets fill at the rate given and each
+** request takes a token; an address not in the table starts full, so
+** reusing the slot of the one seen longest ago is as good as forgetting it.
+** Tokens are kept in thousandths so a refill is one multiply.
+*/
+class HTTPLimiter
+{
+  public:
+    HTTPLimiter() : _rate(HTTP_RATE_LIMIT), _burst(HTTP_RATE_BURST), _limited(0), _busy(0), _reclaimed(0) { clear(); }
+
+    void clear(void) { memset(_buckets, 0, sizeof(_buckets)); }
+    void configure(uint16_t rate, uint16_t burst);
+    bool enabled(void) const { return _rate != 0; }
+
+    bool ready(uint32_t address, unsigned long now);
+    bool take(uint32_t address, unsigned long now);
+
+    void countLimited(void) { _limited++; }
+    void countBusy(void) { _busy++; }
+    void countReclaimed(void) { _reclaimed++; }
+
+    uint32_t limited(void) const { return _limited; }     // refused with 429, out of tokens
+    uint32_t busy(void) const { return _busy; }           // refused with 503, no connection free
+    uint32_t reclaimed(void) const { return _reclaimed; } // idle persistent connections closed for a new one
+
+  private:
+    typedef struct
+    {
+        uint32_t address;
+        uint32_t tokens; // thousandths of a request
+        unsigned long last;
+    } Bucket;
+
+    Bucket *_find(uint32_t address, unsigned long now);
+
+    Bucket _buckets[HTTP_RATE_CLIENTS];
+    uint16_t _rate;
+    uint16_t _burst;
+    uint32_t _limited;
+    uint32_t _busy;
+    uint32_t _reclaimed;
+};
+
+#endif // _IOT_HTTP_LIMITER_H
+
+/******************************************************************************/
@@ -0,0 +1,246 @@
+/*
+** EasyIOT - (HTTP) Request Metrics
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+static constexpr const char *_statusClasses[] = {"none", "1xx", "2xx", "3xx", "4xx", "5xx"};
+
+/*
+** Count a request against its route and status class
+*/
+void HTTPMetrics::record(HTTPHandler *route, int code, uint32_t firstByte, uint32_t handler, uint32_t bytes)
+{
+    uint8_t status = (code >= 100 && code < 600) ? code / 100 : 0;
+    Series *series = nullptr;
+
+    for (uint8_t s = 0; s < _used && !series; s++)
+    {
+        if (_series[s].route == route && _series[s].status == status)
+            series = &_series[s];
+    }
+
+    if (!series)
+    {
+        if (_used == HTTP_METRIC_SERIES)
+        {
+            _dropped++;
+            return;
+        }
+
+        series = &_series[_used++];
+        memset(series, 0, sizeof(Series));
+        series->route = route;
+        series->status = status;
+    }
+
+    _add(series->firstByte, firstByte, HTTP_METRIC_TIME_SHIFT);
+    _add(series->handler, handler, HTTP_METRIC_TIME_SHIFT);
+    _add(series->bytes, bytes, HTTP_METRIC_SIZE_SHIFT);
+}
+
+/*
+** Bucket zero holds values up to 1 << shift, each power of two above it is
+** split into 1 << HTTP_METRIC_STEPS buckets and the last catches the rest.
+** One less than the value is placed, so a value equal to a bound is counted
+** in the bucket it closes, as the "le" label says.
+*/
+void HTTPMetrics::_add(Histogram &histogram, uint32_t value, uint8_t shift)
+{
+    uint32_t below = (value) ? value - 1 : 0;
+    uint32_t bucket = 0;
+
+    if (below >> shift)
+    {
+        uint8_t msb = 31 - __builtin_clz(below);
+        uint32_t step = (below >> (msb - HTTP_METRIC_STEPS)) & ((1 << HTTP_METRIC_STEPS) - 1);
+
+        bucket = 1 + ((msb - shift) << HTTP_METRIC_STEPS) + step;
+        if (bucket > HTTP_METRIC_BUCKETS - 1)
+            bucket = HTTP_METRIC_BUCKETS - 1;
+    }
+
+    histogram.count[bucket]++;
+    histogram.sum += value;
+}
+
+uint32_t HTTPMetrics::_bound(uint8_t bucket, uint8_t shift)
+{
+    if (!bucket)
+        return 1UL << shift;
+
+    uint8_t octave = (bucket - 1) >> HTTP_METRIC_STEPS;
+    uint32_t step = (bucket - 1) & ((1 << HTTP_METRIC_STEPS) - 1);
+
+    return (((1UL << HTTP_METRIC_STEPS) + step + 1) << (shift + octave)) >> HTTP_METRIC_STEPS;
+}
+
+/*
+** Prometheus Text Exposition, written a line at a time as the socket drains
+*/
+static constexpr struct
+{
+    const char *name;
+    const char *help;
+    uint8_t shift;
+    bool time;
+} _families[] = {
+    {"http_request_first_byte_seconds", "Time from the request arriving to the first byte of the response", HTTP_METRIC_TIME_SHIFT, true},
+    {"http_request_handler_seconds", "Time spent in the request handler", HTTP_METRIC_TIME_SHIFT, true},
+    {"http_response_size_bytes", "Bytes sent in the response, headers included", HTTP_METRIC_SIZE_SHIFT, false},
+};
+
+static constexpr uint8_t _familyCount = sizeof(_families) / sizeof(_families[0]);
+
+bool HTTPMetrics::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    (void)requestMethod;
+    (void)requestUri;
+
+    // Series added while sending appear in the next scrape, not half of this one
+    Cursor at = {0, 0, 0, _used, false};
+
+    server.sendHeader("Cache-Control", "no-cache");
+    server.sendStream(200, "text/plain; version=0.0.4", [this, at, &server](HTTPStream &out) mutable {
+        return _send(out, at, server.webLimiter());
+    });
+    return true;
+}
+
+bool HTTPMetrics::_send(HTTPStream &out, Cursor &at, const HTTPLimiter &limiter)
+{
+    while (out.room() >= HTTP_METRIC_LINE)
+    {
+        // The counters follow the histograms, one family each
+        if (at.family == _familyCount)
+        {
+            out.print("# HELP http_metrics_dropped_total Requests not measured, every series was taken\n"
+                      "# TYPE http_metrics_dropped_total counter\n");
+            out.printf("http_metrics_dropped_total %u\n", (unsigned)_dropped);
+            at.family++;
+            continue;
+        }
+
+        if (at.family == _familyCount + 1)
+        {
+            out.print("# HELP http_refused_total Connections and requests refused by admission control\n"
+                      "# TYPE http_refused_total counter\n");
+            out.printf("http_refused_total{reason=\"rate\"} %u\nhttp_refused_total{reason=\"busy\"} %u\n",
+                       (unsigned)limiter.limited(), (unsigned)limiter.busy());
+            at.family++;
+            continue;
+        }
+
+        if (at.family == _familyCount + 2)
+        {
+            out.print("# HELP http_reclaimed_total Idle persistent connections closed to admit another\n"
+                      "# TYPE http_reclaimed_total counter\n");
+            out.printf("http_reclaimed_total %u\n", (unsigned)limiter.reclaimed());
+            return false;
+        }
+
+        if (!at.headed)
+        {
+            out.printf("# HELP %s %s\n# TYPE %s histogram\n",
+                       _families[at.family].name, _families[at.family].help, _families[at.family].name);
+            at.headed = true;
+        }
+        else if (at.series == at.used)
+        {
+            at.family++;
+            at.series = 0;
+            at.headed = false;
+        }
+        else
+        {
+            _line(out, at);
+            if (++at.line == HTTP_METRIC_BUCKETS + 2)
+            {
+                at.line = 0;
+                at.series++;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+** One bucket of a series, then its sum and count
+*/
+void HTTPMetrics::_line(Print &out, const Cursor &at)
+{
+    const char *name = _families[at.family].name;
+    uint8_t shift = _families[at.family].shift;
+    bool time = _families[at.family].time;
+    const Series &series = _series[at.series];
+    const Histogram &histogram = (at.family == 0) ? series.firstByte : (at.family == 1) ? series.handler : series.bytes;
+    uint8_t b = (at.line < HTTP_METRIC_BUCKETS) ? at.line : HTTP_METRIC_BUCKETS - 1;
+    uint32_t total = 0;
+
+    for (uint8_t c = 0; c <= b; c++)
+        total += histogram.count[c];
+
+    if (at.line == HTTP_METRIC_BUCKETS)
+    {
+        out.printf("%s_sum{", name);
+        _labels(out, series);
+        if (time)
+            out.printf("} %llu.%06u\n", (unsigned long long)(histogram.sum / 1000000), (unsigned)(histogram.sum % 1000000));
+        else
+            out.printf("} %llu\n", (unsigned long long)histogram.sum);
+        return;
+    }
+
+    if (at.line > HTTP_METRIC_BUCKETS)
+        out.printf("%s_count{", name);
+    else
+        out.printf("%s_bucket{", name);
+    _labels(out, series);
+
+    if (at.line > HTTP_METRIC_BUCKETS)
+        out.print("}");
+    else if (b == HTTP_METRIC_BUCKETS - 1)
+        out.print(",le=\"+Inf\"}");
+    else if (time)
+    {
+        uint32_t bound = _bound(b, shift);
+        out.printf(",le=\"%u.%06u\"}", (unsigned)(bound / 1000000), (unsigned)(bound % 1000000));
+    }
+    else
+        out.printf(",le=\"%u\"}", (unsigned)_bound(b, shift));
+    out.printf(" %u\n", (unsigned)total);
+}
+
+/*
+** Route names are URIs, escape what the label syntax reserves anyway
+*/
+void HTTPMetrics::_labels(Print &out, const Series &series)
+{
+    const char *route = (!series.route) ? "none" : series.route->httpName();
+
+    if (!route)
+        route = "other";
+
+    out.print("route=\"");
+    for (; *route; route++)
+    {
+        if (*route == '"' || *route == '\\')
+            out.write('\\');
+        if (*route == '\n')
+            out.print("\\n");
+        else
+            out.write(*route);
+    }
+    out.printf("\",code=\"%s\"", _statusClasses[series.status]);
+}
+
+/******************************************************************************/
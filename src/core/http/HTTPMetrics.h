@@ -0,0 +1,104 @@
+/*
+** EasyIOT - (HTTP) Request Metrics
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_METRICS_H
+#define _IOT_HTTP_METRICS_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_METRIC_SERIES
+#define HTTP_METRIC_SERIES 12 // route and status class pairs measured, any more are only counted
+#endif
+
+#define HTTP_METRIC_STEPS 1      // log2 of the linear steps within each power of two
+#define HTTP_METRIC_OCTAVES 15   // powers of two spanned by the buckets
+#define HTTP_METRIC_TIME_SHIFT 7 // first time bucket ends at 128us, the last at 4.2s
+#define HTTP_METRIC_SIZE_SHIFT 6 // first size bucket ends at 64 bytes, the last at 2MB
+
+#define HTTP_METRIC_BUCKETS ((HTTP_METRIC_OCTAVES << HTTP_METRIC_STEPS) + 2)
+#define HTTP_METRIC_LINE 256 // room wanted before writing the next exposition line
+
+/*
+** Request Metrics Handler Class
+**
+** Keeps a histogram of the time to first byte, the time spent in the
+** handler and the bytes sent for each route and status class, serving them
+** at its URI in the Prometheus text format.  Buckets are log-linear, each
+** power of two split into equal steps, so the relative error is bounded
+** from the fastest request to the slowest.  Every series is held in a fixed
+** table, recording a request finds its slot and bumps three counters.  The
+** exposition is written a line at a time as the socket drains, however
+** many series there are.
+*/
+class HTTPMetrics : public HTTPHandler
+{
+  public:
+    HTTPMetrics(const char *uri) : _uri(uri), _used(0), _dropped(0) {}
+
+    bool httpRoute(HTTPRouter &router) override
+    {
+        router.route(_uri.c_str(), HTTP_GET, this);
+        return true;
+    }
+
+    bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override
+    {
+        return requestMethod == HTTP_GET && requestUri == _uri;
+    }
+
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    const char *httpName(void) override { return _uri.c_str(); }
+
+    void record(HTTPHandler *route, int code, uint32_t firstByte, uint32_t handler, uint32_t bytes);
+
+  private:
+    typedef struct
+    {
+        uint32_t count[HTTP_METRIC_BUCKETS];
+        uint64_t sum;
+    } Histogram;
+
+    typedef struct
+    {
+        HTTPHandler *route;
+        uint8_t status; // code / 100, zero if nothing was sent
+        Histogram firstByte;
+        Histogram handler;
+        Histogram bytes;
+    } Series;
+
+    typedef struct
+    {
+        uint8_t family;
+        uint8_t series;
+        uint8_t line; // bucket, then the sum and the count
+        uint8_t used; // series when the scrape began
+        bool headed;
+    } Cursor;
+
+    static void _add(Histogram &histogram, uint32_t value, uint8_t shift);
+    static uint32_t _bound(uint8_t bucket, uint8_t shift);
+    bool _send(HTTPStream &out, Cursor &at, const HTTPLimiter &limiter);
+    void _line(Print &out, const Cursor &at);
+    void _labels(Print &out, const Series &series);
+
+    String _uri;
+    Series _series[HTTP_METRIC_SERIES];
+    uint8_t _used;
+    uint32_t _dropped;
+};
+
+#endif // _IOT_HTTP_METRICS_H
+
+/******************************************************************************/
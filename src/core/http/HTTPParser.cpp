@@ -0,0 +1,357 @@
+/*
+** EasyIOT - (HTTP) Incremental Request Parser
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "HTTPParser.h"
+
+/*
+** Drop everything, including any pipelined bytes
+*/
+void HTTPParser::clear(void)
+{
+    _state = PS_METHOD;
+    _len = 0;
+    reset();
+}
+
+/*
+** Drop the current request, keeping any bytes that followed it
+*/
+void HTTPParser::reset(void)
+{
+    if (_state == PS_DONE && _body < _len)
+    {
+        memmove(_buf, &_buf[_body], _len - _body);
+        _len -= _body;
+    }
+    else
+        _len = 0;
+
+    _buf[_len] = '\0';
+    _top = HTTP_ARENA_SIZE + 1;
+    _pos = 0;
+    _mark = 0;
+    _body = 0;
+    _kept = 0;
+    _state = PS_METHOD;
+    _method = _uri = _query = _version = {0, 0};
+    _headerCount = 0;
+    _overflowed = false;
+}
+
+/*
+** Read whatever the client has, without blocking
+*/
+size_t HTTPParser::fill(WiFiClient &client)
+{
+    size_t space = _top - _len - 1; // always room for the terminator
+    size_t avail = client.available();
+
+    if (avail > space)
+        avail = space;
+    if (avail == 0)
+        return 0;
+
+    int got = client.read((uint8_t *)&_buf[_len], avail);
+    if (got <= 0)
+        return 0;
+
+    _len += got;
+    _buf[_len] = '\0';
+    return got;
+}
+
+/*
+** Continue scanning from where the last call stopped
+*/
+HTTPParseStatus HTTPParser::parse(void)
+{
+    while (_pos < _len && _state < PS_DONE)
+    {
+        char c = _buf[_pos];
+
+        switch (_state)
+        {
+        case PS_METHOD:
+            // Tolerate blank lines ahead of the request line
+            if (_pos == _mark && (c == '\r' || c == '\n'))
+            {
+                _mark = _pos + 1;
+                break;
+            }
+            if (c == ' ')
+            {
+                if (_pos == _mark)
+                    return _fail();
+                _method = {_mark, (uint16_t)(_pos - _mark)};
+                _buf[_pos] = '\0';
+                _mark = _pos + 1;
+                _state = PS_URI;
+            }
+            else if (c == '\r' || c == '\n')
+                return _fail();
+            break;
+
+        case PS_URI:
+            if (c == ' ' || c == '?')
+            {
+                if (_pos == _mark)
+                    return _fail();
+                _uri = {_mark, (uint16_t)(_pos - _mark)};
+                _buf[_pos] = '\0';
+                _mark = _pos + 1;
+                _state = (c == '?') ? PS_QUERY : PS_VERSION;
+            }
+            else if (c == '\r' || c == '\n')
+                return _fail();
+            break;
+
+        case PS_QUERY:
+            if (c == ' ')
+            {
+                _query = {_mark, (uint16_t)(_pos - _mark)};
+                _buf[_pos] = '\0';
+                _mark = _pos + 1;
+                _state = PS_VERSION;
+            }
+            else if (c == '\r' || c == '\n')
+                return _fail();
+            break;
+
+        case PS_VERSION:
+            // Handle bad apps who only send LF!
+            if (c == '\r' || c == '\n')
+            {
+                _version = {_mark, (uint16_t)(_pos - _mark)};
+                _buf[_pos] = '\0';
+                _state = (c == '\r') ? PS_VERSION_LF : PS_HEADER;
+            }
+            break;
+
+        case PS_VERSION_LF:
+        case PS_VALUE_LF:
+            if (c != '\n')
+                return _fail();
+            _state = PS_HEADER;
+            break;
+
+        case PS_HEADER:
+            if (c == '\r')
+                _state = PS_HEADERS_LF;
+            else if (c == '\n')
+                _state = PS_DONE;
+            else
+            {
+                _mark = _pos;
+                _state = PS_HEADER_NAME;
+            }
+            break;
+
+        case PS_HEADER_NAME:
+            if (c == ':')
+            {
+                if (_headerCount < HTTP_MAX_HEADERS)
+                    _headers[_headerCount].name = {_mark, (uint16_t)(_pos - _mark)};
+                else
+                    _overflowed = true;
+                _buf[_pos] = '\0';
+                _state = PS_VALUE_START;
+            }
+            else if (c == '\r' || c == '\n')
+                return _fail();
+            break;
+
+        case PS_VALUE_START:
+            if (c == ' ' || c == '\t')
+                break;
+            _mark = _pos;
+            _state = PS_VALUE;
+            // fall through
+
+        case PS_VALUE:
+            if (c == '\r' || c == '\n')
+            {
+                uint16_t end = _pos;
+
+                while (end > _mark && (_buf[end - 1] == ' ' || _buf[end - 1] == '\t'))
+                    end--;
+                _buf[end] = '\0';
+
+                if (_headerCount < HTTP_MAX_HEADERS)
+                    _headers[_headerCount++].value = {_mark, (uint16_t)(end - _mark)};
+                _state = (c == '\r') ? PS_VALUE_LF : PS_HEADER;
+            }
+            break;
+
+        case PS_HEADERS_LF:
+            if (c != '\n')
+                return _fail();
+            _state = PS_DONE;
+            break;
+        }
+        _pos++;
+    }
+
+    if (_state == PS_DONE)
+    {
+        if (_body < _pos)
+            _body = _kept = _pos;
+        return HP_COMPLETE;
+    }
+
+    if (_state == PS_ERROR || _pos >= HTTP_REQUEST_BUFLEN || _len + 1 >= _top)
+        return _fail();
+
+    return HP_PARTIAL;
+}
+
+HTTPParseStatus HTTPParser::_fail(void)
+{
+    _state = PS_ERROR;
+    return HP_ERROR;
+}
+
+/*
+** Read until the body is held in place, the caller checks it will fit
+*/
+HTTPParseStatus HTTPParser::fillBody(WiFiClient &client, size_t length)
+{
+    if (_state != PS_DONE || _body + length >= _top)
+        return HP_ERROR;
+
+    while (_len < _body + length && fill(client))
+        ;
+
+    return (_len >= _body + length) ? HP_COMPLETE : HP_PARTIAL;
+}
+
+/*
+** Hand out the body as a C string, any bytes after it move up one
+*/
+char *HTTPParser::takeBody(size_t length)
+{
+    char *body = &_buf[_body];
+    size_t end = _body + length;
+
+    if (bodyAvailable() < length)
+        return nullptr;
+
+    if (end < _len)
+    {
+        if (_len + 1 >= _top)
+            return nullptr;
+        memmove(&_buf[end + 1], &_buf[end], _len - end);
+        _buf[++_len] = '\0';
+        _body = end + 1;
+    }
+    else
+        _body = end;
+
+    _buf[end] = '\0';
+    return body;
+}
+
+/*
+** Copy a string into the top of the arena, it lasts until the next reset
+*/
+char *HTTPParser::store(const char *data, size_t len)
+{
+    if (_top < _len + len + 2)
+        return nullptr;
+
+    _top -= len + 1;
+    memcpy(&_buf[_top], data, len);
+    _buf[_top + len] = '\0';
+    return &_buf[_top];
+}
+
+/*
+** Slice Comparisons
+*/
+bool HTTPParser::equals(const HTTPSlice &s, const char *text) const
+{
+    return strncmp(str(s), text, s.len) == 0 && text[s.len] == '\0';
+}
+
+bool HTTPParser::equalsIgnoreCase(const HTTPSlice &s, const char *text) const
+{
+    return strncasecmp(str(s), text, s.len) == 0 && text[s.len] == '\0';
+}
+
+/*
+** Request Body, the bytes which arrived along with the headers
+*/
+size_t HTTPParser::bodyRead(uint8_t *dst, size_t len)
+{
+    size_t avail = bodyAvailable();
+
+    if (len > avail)
+        len = avail;
+    if (len)
+    {
+        memcpy(dst, &_buf[_body], len);
+        _body += len;
+    }
+    return len;
+}
+
+/*
+** Keep part of what is being taken, moved down behind whatever was kept
+** before, as a C string.  The part must lie in the body not yet compacted,
+** after any other kept since, so it only moves down.
+*/
+char *HTTPParser::bodyKeep(const char *data, size_t len)
+{
+    char *kept = &_buf[_kept];
+
+    memmove(kept, data, len);
+    kept[len] = '\0';
+    _kept += len + 1;
+    return kept;
+}
+
+/*
+** Move what is left of the body down behind what it has kept, making room
+** to fill
+*/
+void HTTPParser::bodyCompact(void)
+{
+    if (_state != PS_DONE || _body == _kept)
+        return;
+
+    memmove(&_buf[_kept], &_buf[_body], _len - _body);
+    _len -= _body - _kept;
+    _body = _kept;
+    _buf[_len] = '\0';
+}
+
+/*
+** Read a block of whatever is held or has arrived, without waiting
+*/
+size_t HTTPBodyStream::readBlock(uint8_t *dst, size_t len)
+{
+    size_t got = _parser.bodyRead(dst, len);
+    size_t avail = _client.available();
+
+    if (got < len && avail)
+    {
+        int r = _client.read(&dst[got], (avail < len - got) ? avail : len - got);
+
+        if (r > 0)
+            got += r;
+    }
+
+    _consumed += got;
+    return got;
+}
+
+/******************************************************************************/
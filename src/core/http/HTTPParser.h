@@ -0,0 +1,194 @@
+/*
+** EasyIOT - (HTTP) Incremental Request Parser
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_PARSER_H
+#define _IOT_HTTP_PARSER_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_REQUEST_BUFLEN
+#define HTTP_REQUEST_BUFLEN 1460
+#endif
+
+#ifndef HTTP_MAX_HEADERS
+#define HTTP_MAX_HEADERS 24
+#endif
+
+#ifndef HTTP_MAX_BODY_SIZE
+#define HTTP_MAX_BODY_SIZE 2048 // largest body held in memory, more is refused with 413
+#endif
+
+#define HTTP_ARENA_SIZE (HTTP_REQUEST_BUFLEN + HTTP_MAX_BODY_SIZE + 1)
+
+enum HTTPParseStatus
+{
+    HP_PARTIAL,
+    HP_COMPLETE,
+    HP_ERROR
+};
+
+/*
+** View (offset/length) into the receive buffer
+*/
+typedef struct
+{
+    uint16_t off;
+    uint16_t len;
+} HTTPSlice;
+
+typedef struct
+{
+    HTTPSlice name;
+    HTTPSlice value;
+} HTTPHeaderSlice;
+
+/*
+** Request Parser Class
+**
+** Bytes are read into one fixed buffer and scanned by a resumable state
+** machine, so a request may arrive over any number of service calls.  Tokens
+** are terminated in place, which lets every slice be used as a C string.
+**
+** The same buffer is the connection's request arena.  Headers may use the
+** first HTTP_REQUEST_BUFLEN bytes, the body is read in place behind them and
+** anything else the request needs is stored down from the top.  It is all
+** released at once as the next request starts.  A body taken in pieces may
+** keep some of them, moved down behind the headers, while the rest of it is
+** read on in the space left.
+*/
+class HTTPParser
+{
+  public:
+    HTTPParser() { clear(); }
+
+    void clear(void);
+    void reset(void);
+    size_t fill(WiFiClient &client);
+    HTTPParseStatus parse(void);
+    HTTPParseStatus fillBody(WiFiClient &client, size_t length);
+    char *takeBody(size_t length);
+    char *store(const char *data, size_t len);
+
+    const char *str(const HTTPSlice &s) const { return (s.len) ? &_buf[s.off] : ""; }
+    bool equals(const HTTPSlice &s, const char *text) const;
+    bool equalsIgnoreCase(const HTTPSlice &s, const char *text) const;
+
+    const HTTPSlice &method(void) const { return _method; }
+    const HTTPSlice &uri(void) const { return _uri; }
+    const HTTPSlice &query(void) const { return _query; }
+    const HTTPSlice &version(void) const { return _version; }
+
+    uint8_t headers(void) const { return _headerCount; }
+    bool overflowed(void) const { return _overflowed; } // more than HTTP_MAX_HEADERS, the rest not kept
+    const HTTPHeaderSlice &header(uint8_t i) const { return _headers[i]; }
+
+    size_t buffered(void) const { return _len; }
+    bool full(void) const { return _len + 1 >= _top; }
+    size_t bodyAvailable(void) const { return (_state == PS_DONE) ? _len - _body : 0; }
+    size_t bodyRead(uint8_t *dst, size_t len);
+    int bodyPeek(void) const { return bodyAvailable() ? (uint8_t)_buf[_body] : -1; }
+    char *bodyData(void) { return &_buf[_body]; }
+    void bodySkip(size_t len) { _body += (len < bodyAvailable()) ? len : bodyAvailable(); }
+    char *bodyKeep(const char *data, size_t len);
+    void bodyCompact(void);
+
+  private:
+    enum
+    {
+        PS_METHOD,
+        PS_URI,
+        PS_QUERY,
+        PS_VERSION,
+        PS_VERSION_LF,
+        PS_HEADER,
+        PS_HEADER_NAME,
+        PS_VALUE_START,
+        PS_VALUE,
+        PS_VALUE_LF,
+        PS_HEADERS_LF,
+        PS_DONE,
+        PS_ERROR
+    };
+
+    HTTPParseStatus _fail(void);
+
+    char _buf[HTTP_ARENA_SIZE + 1];
+    uint16_t _top;
+    uint16_t _len;
+    uint16_t _pos;
+    uint16_t _mark;
+    uint16_t _body;
+    uint16_t _kept; // end of what the body has kept in place, behind the headers
+    uint8_t _state;
+
+    HTTPSlice _method;
+    HTTPSlice _uri;
+    HTTPSlice _query;
+    HTTPSlice _version;
+    HTTPHeaderSlice _headers[HTTP_MAX_HEADERS];
+    uint8_t _headerCount;
+    bool _overflowed;
+};
+
+/*
+** Body Reader, drains bytes the parser already holds before the client
+*/
+class HTTPBodyStream : public Stream
+{
+  public:
+    HTTPBodyStream(HTTPParser &parser, WiFiClient &client) : _parser(parser), _client(client), _consumed(0) {}
+
+    size_t consumed(void) const { return _consumed; }
+    size_t readBlock(uint8_t *dst, size_t len);
+
+    int available(void) { return _parser.bodyAvailable() + _client.available(); }
+    uint8_t connected(void) { return (_parser.bodyAvailable() > 0) || _client.connected(); }
+
+    int read(void)
+    {
+        uint8_t b;
+        int c = (_parser.bodyRead(&b, 1)) ? b : _client.read();
+
+        if (c >= 0)
+            _consumed++;
+        return c;
+    }
+
+    int peek(void)
+    {
+        if (_parser.bodyAvailable())
+            return _parser.bodyPeek();
+        return _client.peek();
+    }
+
+    size_t write(uint8_t b)
+    {
+        (void)b;
+        return 0;
+    }
+
+    void flush(void) {}
+
+  private:
+    HTTPParser &_parser;
+    WiFiClient &_client;
+    size_t _consumed;
+};
+
+#endif // _IOT_HTTP_PARSER_H
+
+/******************************************************************************/
@@ -0,0 +1,333 @@
+/*
+** EasyIOT - (HTTP) Response Builder
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+#include <lwip/sockets.h>
+#include <errno.h>
+
+static_assert(HTTP_RESPONSE_BUFLEN <= 0xFFFF, "HTTP_RESPONSE_BUFLEN must fit the four digit chunk size");
+
+/*
+** Status and Method Tables
+*/
+static constexpr struct
+{
+    uint16_t code;
+    const char *text;
+} _statusTexts[] = {
+    {100, "Continue"},
+    {101, "Switching Protocols"},
+    {200, "OK"},
+    {201, "Created"},
+    {202, "Accepted"},
+    {203, "Non-Authoritative Information"},
+    {204, "No Content"},
+    {205, "Reset Content"},
+    {206, "Partial Content"},
+    {300, "Multiple Choices"},
+    {301, "Moved Permanently"},
+    {302, "Found"},
+    {303, "See Other"},
+    {304, "Not Modified"},
+    {305, "Use Proxy"},
+    {307, "Temporary Redirect"},
+    {400, "Bad Request"},
+    {401, "Unauthorized"},
+    {402, "Payment Required"},
+    {403, "Forbidden"},
+    {404, "Not Found"},
+    {405, "Method Not Allowed"},
+    {406, "Not Acceptable"},
+    {407, "Proxy Authentication Required"},
+    {408, "Request Time-out"},
+    {409, "Conflict"},
+    {410, "Gone"},
+    {411, "Length Required"},
+    {412, "Precondition Failed"},
+    {413, "Request Entity Too Large"},
+    {414, "Request-URI Too Large"},
+    {415, "Unsupported Media Type"},
+    {416, "Requested range not satisfiable"},
+    {417, "Expectation Failed"},
+    {431, "Request Header Fields Too Large"},
+    {500, "Internal Server Error"},
+    {501, "Not Implemented"},
+    {502, "Bad Gateway"},
+    {503, "Service Unavailable"},
+    {504, "Gateway Time-out"},
+    {505, "HTTP Version not supported"}};
+
+static constexpr const char *_methodNames[] = {
+    "ANY",
+    "GET",
+    "POST",
+    "PUT",
+    "PATCH",
+    "DELETE",
+    "OPTIONS"};
+
+const char *HTTPResponse::statusText(int code)
+{
+    for (size_t s = 0; s < sizeof(_statusTexts) / sizeof(_statusTexts[0]); s++)
+    {
+        if (_statusTexts[s].code == code)
+            return _statusTexts[s].text;
+    }
+    return "";
+}
+
+const char *HTTPResponse::methodName(int method)
+{
+    if (method < 0 || method >= (int)(sizeof(_methodNames) / sizeof(_methodNames[0])))
+        return "unknown";
+    return _methodNames[method];
+}
+
+/*
+** Start a new response, leaving room for the status line
+*/
+void HTTPResponse::begin(void)
+{
+    _start = _len = HTTP_STATUS_RESERVE;
+    _chunkOpen = false;
+    _headers = true;
+}
+
+bool HTTPResponse::header(const char *name, const char *value, bool first)
+{
+    size_t nameLen = strlen(name);
+    size_t valueLen = strlen(value);
+    size_t lineLen = nameLen + valueLen + 4;
+
+    // Keep room for the blank line which ends the headers
+    if (!_headers || _len + lineLen + 2 > HTTP_RESPONSE_BUFLEN)
+        return false;
+
+    char *line = &_buf[_len];
+
+    if (first)
+    {
+        line = &_buf[HTTP_STATUS_RESERVE];
+        memmove(line + lineLen, line, _len - HTTP_STATUS_RESERVE);
+    }
+
+    memcpy(line, name, nameLen);
+    memcpy(line + nameLen, ": ", 2);
+    memcpy(line + nameLen + 2, value, valueLen);
+    memcpy(line + lineLen - 2, "\r\n", 2);
+    _len += lineLen;
+    return true;
+}
+
+/*
+** Write the status line ahead of the headers and close them
+*/
+void HTTPResponse::status(uint8_t version, int code)
+{
+    char line[HTTP_STATUS_RESERVE + 1];
+    int lineLen = snprintf(line, sizeof(line), "HTTP/1.%u %d %s\r\n", version, code, statusText(code));
+
+    if (lineLen < 0 || lineLen > HTTP_STATUS_RESERVE)
+        lineLen = HTTP_STATUS_RESERVE;
+
+    _code = code;
+    _start = HTTP_STATUS_RESERVE - lineLen;
+    memcpy(&_buf[_start], line, lineLen);
+    memcpy(&_buf[_len], "\r\n", 2);
+    _len += 2;
+    _headers = false;
+}
+
+/*
+** Append body bytes, sending a full buffer as it fills
+*/
+size_t HTTPResponse::write(WiFiClient &client, const char *data, size_t len)
+{
+    size_t done = 0;
+
+    if (_headers)
+        return 0;
+
+    while (done < len)
+    {
+        // Nothing held and more than a segment to go, skip the copy.  A
+        // write of room() or less always fits, so never waits here.
+        if (!pending() && len - done > HTTP_RESPONSE_BUFLEN)
+        {
+            size_t sent = _write(client, &data[done], len - done);
+
+            done += sent;
+            break;
+        }
+
+        if (_len == HTTP_RESPONSE_BUFLEN && !flush(client))
+            break;
+
+        size_t copy = HTTP_RESPONSE_BUFLEN - _len;
+
+        if (copy > len - done)
+            copy = len - done;
+
+        memcpy(&_buf[_len], &data[done], copy);
+        _len += copy;
+        done += copy;
+    }
+    return done;
+}
+
+/*
+** Append body bytes framed as chunks, a full buffer closes the chunk
+*/
+size_t HTTPResponse::writeChunked(WiFiClient &client, const char *data, size_t len)
+{
+    size_t done = 0;
+
+    if (_headers)
+        return 0;
+
+    while (done < len)
+    {
+        // Room for the size field, one byte and the trailing CRLF
+        if (!_chunkOpen && _len + HTTP_CHUNK_RESERVE + 3 > HTTP_RESPONSE_BUFLEN && !flush(client))
+            break;
+
+        if (!_chunkOpen)
+        {
+            _chunk = _len;
+            _len += HTTP_CHUNK_RESERVE;
+            _chunkOpen = true;
+        }
+
+        size_t copy = HTTP_RESPONSE_BUFLEN - 2 - _len;
+
+        if (copy > len - done)
+            copy = len - done;
+
+        memcpy(&_buf[_len], &data[done], copy);
+        _len += copy;
+        done += copy;
+
+        if (_len == HTTP_RESPONSE_BUFLEN - 2 && !flush(client))
+            break;
+    }
+    return done;
+}
+
+void HTTPResponse::_closeChunk(void)
+{
+    if (!_chunkOpen)
+        return;
+
+    size_t size = _len - _chunk - HTTP_CHUNK_RESERVE;
+
+    _chunkOpen = false;
+    if (!size)
+    {
+        _len = _chunk;
+        return;
+    }
+
+    char field[HTTP_CHUNK_RESERVE + 1];
+
+    // Never more than four digits, as the buffer is no bigger
+    snprintf(field, sizeof(field), "%04x\r\n", (unsigned)size & 0xFFFF);
+    memcpy(&_buf[_chunk], field, HTTP_CHUNK_RESERVE);
+    memcpy(&_buf[_len], "\r\n", 2);
+    _len += 2;
+}
+
+/*
+** End a chunked body, the zero length chunk goes out with the last data
+*/
+bool HTTPResponse::lastChunk(WiFiClient &client)
+{
+    static const char last[] = "0\r\n\r\n";
+
+    _closeChunk();
+    if (_len + sizeof(last) - 1 > HTTP_RESPONSE_BUFLEN && !flush(client))
+        return false;
+
+    memcpy(&_buf[_len], last, sizeof(last) - 1);
+    _len += sizeof(last) - 1;
+    return true;
+}
+
+bool HTTPResponse::flush(WiFiClient &client)
+{
+    if (_headers)
+        return false;
+
+    _closeChunk();
+
+    size_t len = pending();
+
+    if (len && _write(client, &_buf[_start], len) != len)
+    {
+        _start = _len = 0;
+        _failed = true;
+        return false;
+    }
+
+    _start = _len = 0;
+    return true;
+}
+
+/*
+** Send what the socket will take without waiting, the rest stays held
+*/
+size_t HTTPResponse::drain(WiFiClient &client)
+{
+    if (_headers || _failed)
+        return 0;
+
+    _closeChunk();
+
+    size_t len = pending();
+
+    if (!len)
+        return 0;
+
+    if (!_sent)
+        _firstSent = micros();
+
+    int sent = send(client.fd(), &_buf[_start], len, MSG_DONTWAIT);
+
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            _failed = true;
+        return 0;
+    }
+
+    _sent += sent;
+    _start += sent;
+
+    // Move what is left to the front, so all the room is behind it
+    memmove(_buf, &_buf[_start], _len - _start);
+    _len -= _start;
+    _start = 0;
+    return sent;
+}
+
+size_t HTTPResponse::_write(WiFiClient &client, const char *data, size_t len)
+{
+    if (!_sent)
+        _firstSent = micros();
+
+    size_t sent = client.write((const uint8_t *)data, len);
+
+    _sent += sent;
+    return sent;
+}
+
+/******************************************************************************/
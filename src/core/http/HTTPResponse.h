@@ -0,0 +1,94 @@
+/*
+** EasyIOT - (HTTP) Response Builder
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_RESPONSE_H
+#define _IOT_HTTP_RESPONSE_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_RESPONSE_BUFLEN
+#define HTTP_RESPONSE_BUFLEN HTTP_DOWNLOAD_UNIT_SIZE
+#endif
+
+#define HTTP_STATUS_RESERVE 48 // longest status line, "HTTP/1.1 407 Proxy Authentication Required\r\n"
+#define HTTP_CHUNK_RESERVE 6   // fixed width chunk size, "05b4\r\n"
+
+/*
+** Response Builder Class
+**
+** The status line, headers and body are assembled in one segment sized
+** buffer and written when it fills or the response is complete, so a small
+** reply leaves in a single TCP segment.  Headers may be added before the
+** status code is known; room is reserved ahead of them and the status line
+** is written right aligned into it once send() is called.
+**
+** Chunked bodies are framed in the same buffer.  Each chunk is opened with
+** a fixed width size field, zero padded as the grammar allows, which is
+** filled in as the chunk is closed on a flush.
+**
+** Writing into a full buffer flushes it, waiting on the socket.  The server
+** instead calls drain() as it services the connection, which sends only
+** what the socket will take and keeps the rest for the next pass.
+*/
+class HTTPResponse
+{
+  public:
+    HTTPResponse() : _failed(false), _code(0), _sent(0), _firstSent(0) { begin(); }
+
+    void begin(void);
+    bool header(const char *name, const char *value, bool first = false);
+    void status(uint8_t version, int code);
+    size_t write(WiFiClient &client, const char *data, size_t len);
+    size_t write(WiFiClient &client, const char *text) { return write(client, text, strlen(text)); }
+    size_t writeChunked(WiFiClient &client, const char *data, size_t len);
+    bool lastChunk(WiFiClient &client);
+    bool flush(WiFiClient &client);
+    size_t drain(WiFiClient &client);
+
+    size_t pending(void) const { return (_headers) ? 0 : _len - _start; }
+    size_t room(void) const { return (_headers) ? 0 : HTTP_RESPONSE_BUFLEN - _len; }
+    bool chunkOpen(void) const { return _chunkOpen; }
+    bool failed(void) const { return _failed; }
+
+    // What went out since measure(), for the server's metrics
+    void measure(void) { _code = 0; _sent = 0; _failed = false; }
+    size_t sent(void) const { return _sent; }
+    unsigned long firstSent(void) const { return _firstSent; }
+    int code(void) const { return _code; }
+
+    static const char *statusText(int code);
+    static const char *methodName(int method);
+
+  private:
+    void _closeChunk(void);
+    size_t _write(WiFiClient &client, const char *data, size_t len);
+
+    char _buf[HTTP_RESPONSE_BUFLEN];
+    uint16_t _start;
+    uint16_t _len;
+    uint16_t _chunk;
+    bool _chunkOpen;
+    bool _headers;
+    bool _failed;
+    int _code;
+    size_t _sent;
+    unsigned long _firstSent; // micros() as the first byte was written
+};
+
+#endif // _IOT_HTTP_RESPONSE_H
+
+/******************************************************************************/
@@ -0,0 +1,178 @@
+/*
+** EasyIOT - (HTTP) Route Index
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+/*
+** Drop every route, the handlers themselves belong to the server
+*/
+void HTTPRouter::clear(void)
+{
+    _freeNode(_root);
+    _freeRoutes(_fallback);
+    _root = nullptr;
+    _fallback = _lastFallback = nullptr;
+    _routes = 0;
+}
+
+void HTTPRouter::_freeNode(Node *node)
+{
+    while (node)
+    {
+        Node *next = node->sibling;
+
+        _freeNode(node->child);
+        _freeRoutes(node->routes);
+        delete node;
+        node = next;
+    }
+}
+
+void HTTPRouter::_freeRoutes(Route *route)
+{
+    while (route)
+    {
+        Route *next = route->next;
+        delete route;
+        route = next;
+    }
+}
+
+/*
+** Let the handler describe its routes, or keep it for a linear search
+*/
+void HTTPRouter::add(HTTPHandler *handler)
+{
+    if (handler->httpRoute(*this))
+        return;
+
+    Route *route = new Route{handler, _routes++, 0xFF, false, nullptr};
+
+    if (_lastFallback)
+        _lastFallback->next = route;
+    else
+        _fallback = route;
+    _lastFallback = route;
+}
+
+/*
+** Insert a URI, splitting any node whose label only partly matches
+*/
+void HTTPRouter::route(const char *uri, HTTPMethod method, HTTPHandler *handler, bool prefix)
+{
+    if (!_root)
+        _root = new Node{String(), nullptr, nullptr, nullptr};
+
+    Node *node = _root;
+
+    while (*uri)
+    {
+        Node **link = &node->child;
+
+        while (*link && (*link)->label[0] != *uri)
+            link = &(*link)->sibling;
+
+        if (!*link)
+        {
+            *link = new Node{String(uri), nullptr, nullptr, nullptr};
+            node = *link;
+            break;
+        }
+
+        Node *child = *link;
+        const char *label = child->label.c_str();
+        size_t common = 0;
+
+        while (label[common] && label[common] == uri[common])
+            common++;
+
+        if (label[common])
+        {
+            Node *split = new Node{child->label.substring(0, common), child, child->sibling, nullptr};
+
+            child->label = child->label.substring(common);
+            child->sibling = nullptr;
+            *link = split;
+            child = split;
+        }
+
+        node = child;
+        uri += common;
+    }
+
+    // Keep registration order, the first handler added wins a tie
+    Route **list = &node->routes;
+
+    while (*list)
+        list = &(*list)->next;
+    *list = new Route{handler, _routes++, _methodBits(method), prefix, nullptr};
+}
+
+HTTPRouter::Route *HTTPRouter::_match(Route *list, uint8_t method, bool prefix)
+{
+    for (; list; list = list->next)
+    {
+        if (list->prefix == prefix && (list->methods & method))
+            return list;
+    }
+    return nullptr;
+}
+
+/*
+** Walk the tree once, remembering the deepest prefix route passed
+*/
+HTTPHandler *HTTPRouter::find(HTTPMethod method, const String &uri)
+{
+    const char *path = uri.c_str();
+    uint8_t bits = _methodBits(method);
+    Route *found = nullptr;
+    Node *node = _root;
+
+    while (node)
+    {
+        if (node->routes)
+        {
+            Route *route;
+
+            if (!*path && (route = _match(node->routes, bits, false)))
+                return route->handler;
+            if ((route = _match(node->routes, bits, true)))
+                found = route;
+        }
+
+        if (!*path)
+            break;
+
+        Node *child = node->child;
+
+        while (child && child->label[0] != *path)
+            child = child->sibling;
+
+        if (!child || strncmp(path, child->label.c_str(), child->label.length()) != 0)
+            break;
+
+        path += child->label.length();
+        node = child;
+    }
+
+    for (Route *route = _fallback; route; route = route->next)
+    {
+        if (found && route->order > found->order)
+            break;
+        if (route->handler->httpCanHandle(method, uri))
+            return route->handler;
+    }
+    return (found) ? found->handler : nullptr;
+}
+
+/******************************************************************************/
@@ -0,0 +1,71 @@
+/*
+** EasyIOT - (HTTP) Route Index
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_ROUTER_H
+#define _IOT_HTTP_ROUTER_H
+
+#include "HTTPHandler.h"
+
+/*
+** Route Index Class
+**
+** Handlers register the URIs they serve into a radix tree, so a lookup costs
+** one pass over the request path however many handlers are installed.  Exact
+** routes win over prefix routes, and the longest matching prefix wins over
+** a shorter one.  Handlers that can't describe their URIs up front are kept
+** in a fallback list and asked through httpCanHandle; one registered before
+** the matching prefix route is still asked first, as the old list did.
+*/
+class HTTPRouter
+{
+  public:
+    HTTPRouter() : _root(nullptr), _fallback(nullptr), _lastFallback(nullptr), _routes(0) {}
+    ~HTTPRouter() { clear(); }
+
+    void clear(void);
+    void add(HTTPHandler *handler);
+    void route(const char *uri, HTTPMethod method, HTTPHandler *handler, bool prefix = false);
+    HTTPHandler *find(HTTPMethod method, const String &uri);
+
+  private:
+    typedef struct Route
+    {
+        HTTPHandler *handler;
+        uint16_t order;
+        uint8_t methods;
+        bool prefix;
+        struct Route *next;
+    } Route;
+
+    typedef struct Node
+    {
+        String label;
+        struct Node *child;
+        struct Node *sibling;
+        Route *routes;
+    } Node;
+
+    static uint8_t _methodBits(HTTPMethod method) { return (method == HTTP_ANY) ? 0xFF : (1 << method); }
+    static Route *_match(Route *list, uint8_t method, bool prefix);
+    static void _freeNode(Node *node);
+    static void _freeRoutes(Route *route);
+
+    Node *_root;
+    Route *_fallback;
+    Route *_lastFallback;
+    uint16_t _routes;
+};
+
+#endif // _IOT_HTTP_ROUTER_H
+
+/******************************************************************************/
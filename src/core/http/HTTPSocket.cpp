@@ -0,0 +1,440 @@
+/*
+** EasyIOT - (HTTP) WebSocket Property Access
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#include "../IOTHttp.h"
+
+#include <libb64/cencode.h>
+#include <mbedtls/sha1.h>
+#include <lwip/sockets.h>
+#include <errno.h>
+
+#define HTTP_SOCKET_FRAME (4 + HTTP_SOCKET_BUFLEN) // largest frame sent, an answer or a pong
+
+static_assert(HTTP_SOCKET_OUTLEN >= HTTP_SOCKET_FRAME, "HTTP_SOCKET_OUTLEN must hold the largest frame");
+
+const char *UPGRADE_HEADER = "Upgrade";
+const char *SEC_WEBSOCKET_KEY_HEADER = "Sec-WebSocket-Key";
+const char *SEC_WEBSOCKET_VERSION_HEADER = "Sec-WebSocket-Version";
+
+static const char _socketGUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+/*
+** Opening Handshake
+*/
+bool HTTPSocket::httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri)
+{
+    (void)requestMethod;
+    (void)requestUri;
+
+    // Properties are open to whoever holds a socket, so ask before upgrading
+    if (server.webProtected() && !server.webAuthorized())
+    {
+        server.webAuthenticate();
+        return true;
+    }
+
+    const char *upgrade = server.headerValue(server.headerId(UPGRADE_HEADER));
+    const char *version = server.headerValue(server.headerId(SEC_WEBSOCKET_VERSION_HEADER));
+    const char *key = server.headerValue(server.headerId(SEC_WEBSOCKET_KEY_HEADER));
+
+    if (strcasecmp(upgrade, "websocket") != 0 || strcmp(version, "13") != 0 || strlen(key) != 24)
+    {
+        server.sendHeader("Sec-WebSocket-Version", "13");
+        server.send(400, MIME_TYPE_TEXT, "WebSocket upgrade expected");
+        return true;
+    }
+
+    Client *client = nullptr;
+
+    for (int c = 0; c < HTTP_SOCKET_CLIENTS && !client; c++)
+    {
+        if (!_clients[c].client)
+            client = &_clients[c];
+    }
+
+    if (!client)
+    {
+        server.send(503, MIME_TYPE_TEXT, "Too many sockets");
+        return true;
+    }
+
+    char input[24 + sizeof(_socketGUID)];
+    unsigned char digest[20];
+    char accept[base64_encode_expected_len(20) + 1];
+
+    snprintf(input, sizeof(input), "%s%s", key, _socketGUID);
+    mbedtls_sha1_ret((const unsigned char *)input, strlen(input), digest);
+    accept[base64_encode_chars((const char *)digest, sizeof(digest), accept)] = '\0';
+
+    server.sendHeader("Upgrade", "websocket");
+    server.sendHeader("Connection", "Upgrade");
+    server.sendHeader("Sec-WebSocket-Accept", accept);
+    client->client = server.sendDetached(101);
+    client->client.setNoDelay(true);
+    client->len = 0;
+    client->outLen = 0;
+    for (int w = 0; w < HTTP_SOCKET_WATCH; w++)
+        client->watch[w].tag[0] = '\0';
+    return true;
+}
+
+/*
+** Send what each client is owed, then read what it has sent and act on
+** every whole frame there is room to answer
+*/
+void HTTPSocket::service(void)
+{
+    for (int c = 0; c < HTTP_SOCKET_CLIENTS; c++)
+    {
+        Client &client = _clients[c];
+
+        if (!client.client)
+            continue;
+
+        if (!client.client.connected())
+        {
+            client.client = WiFiClient();
+            continue;
+        }
+
+        if (!_flush(client))
+            continue;
+
+        int avail = client.client.available();
+
+        if (avail > 0)
+        {
+            size_t room = HTTP_SOCKET_BUFLEN - client.len;
+            int got = client.client.read(&client.buf[client.len], ((size_t)avail < room) ? avail : room);
+
+            if (got > 0)
+                client.len += got;
+        }
+
+        while (client.client && HTTP_SOCKET_OUTLEN - client.outLen >= HTTP_SOCKET_FRAME && _frame(client))
+            ;
+
+        // Changes missed for want of room, as they stand now
+        for (int w = 0; w < HTTP_SOCKET_WATCH && client.client; w++)
+        {
+            Watch &watch = client.watch[w];
+            String result;
+
+            if (!watch.tag[0] || !watch.stale || HTTP_SOCKET_OUTLEN - client.outLen < HTTP_SOCKET_FRAME)
+                continue;
+
+            watch.stale = false;
+            if (_fn(watch.tag, watch.index, nullptr, result))
+                _reply(client, 'v', watch.tag, watch.index, result.c_str());
+        }
+    }
+}
+
+void HTTPSocket::close(void)
+{
+    for (int c = 0; c < HTTP_SOCKET_CLIENTS; c++)
+    {
+        if (_clients[c].client)
+            _close(_clients[c], 1001);
+    }
+}
+
+/*
+** Send a watched property's new value to each client watching it
+*/
+void HTTPSocket::notify(const char *tag, uint8_t index, const char *value)
+{
+    for (int c = 0; c < HTTP_SOCKET_CLIENTS; c++)
+    {
+        Watch *watch;
+
+        if (_clients[c].client && (watch = _watching(_clients[c], tag, index)) &&
+            (watch->stale || !_reply(_clients[c], 'v', tag, index, value)))
+            watch->stale = true;
+    }
+}
+
+/*
+** Unmask a payload, a word at a time once the data is aligned
+*/
+void HTTPSocket::mask(uint8_t *data, size_t len, const uint8_t key[4])
+{
+    size_t i = 0;
+
+    while (i < len && ((uintptr_t)&data[i] & 3))
+    {
+        data[i] ^= key[i & 3];
+        i++;
+    }
+
+    // Rotate the key to line up with the aligned words
+    uint8_t rotated[4] = {key[i & 3], key[(i + 1) & 3], key[(i + 2) & 3], key[(i + 3) & 3]};
+    uint32_t word;
+
+    memcpy(&word, rotated, sizeof(word));
+    for (; i + 4 <= len; i += 4)
+        *(uint32_t *)&data[i] ^= word;
+
+    for (; i < len; i++)
+        data[i] ^= key[i & 3];
+}
+
+/*
+** Take one frame from the front of the buffer, false when there isn't a
+** whole one yet or the client has been closed
+*/
+bool HTTPSocket::_frame(Client &client)
+{
+    uint8_t *buf = client.buf;
+    size_t head = 2;
+
+    if (client.len < head)
+        return false;
+
+    bool fin = buf[0] & 0x80;
+    uint8_t opcode = buf[0] & 0x0F;
+    size_t len = buf[1] & 0x7F;
+
+    if (len == 126)
+    {
+        head = 4;
+        if (client.len < head)
+            return false;
+        len = (buf[2] << 8) | buf[3];
+    }
+    else if (len == 127)
+    {
+        _close(client, 1009);
+        return false;
+    }
+
+    // Clients must mask, a frame that can't fit will never arrive whole
+    if (!(buf[1] & 0x80))
+    {
+        _close(client, 1002);
+        return false;
+    }
+    head += 4;
+    if (head + len > HTTP_SOCKET_BUFLEN)
+    {
+        _close(client, 1009);
+        return false;
+    }
+    if (client.len < head + len)
+        return false;
+
+    uint8_t *payload = &buf[head];
+
+    mask(payload, len, &buf[head - 4]);
+
+    if (!fin || opcode == WS_OP_CONTINUE)
+    {
+        _close(client, 1003);
+        return false;
+    }
+
+    switch (opcode)
+    {
+    case WS_OP_TEXT:
+    case WS_OP_BINARY:
+    {
+        // Terminate in place, the byte after belongs to the next frame
+        uint8_t next = payload[len];
+
+        payload[len] = '\0';
+        _message(client, (char *)payload);
+        payload[len] = next;
+        break;
+    }
+    case WS_OP_PING:
+        _send(client, WS_OP_PONG, payload, len);
+        break;
+    case WS_OP_PONG:
+        break;
+    case WS_OP_CLOSE:
+        _send(client, WS_OP_CLOSE, payload, (len < 2) ? len : 2);
+        client.client = WiFiClient();
+        return false;
+    default:
+        _close(client, 1003);
+        return false;
+    }
+
+    client.len -= head + len;
+    memmove(buf, &buf[head + len], client.len);
+    return (bool)client.client;
+}
+
+/*
+** Property Protocol
+*/
+void HTTPSocket::_message(Client &client, char *text)
+{
+    char type = text[0];
+    char *tag = &text[2];
+    char *space;
+    char *end;
+
+    if (!type || text[1] != ' ' || !(space = strchr(tag, ' ')))
+    {
+        _reply(client, 'e', "-", 0, "syntax");
+        return;
+    }
+
+    *space = '\0';
+    unsigned long index = strtoul(space + 1, &end, 10);
+    const char *value = (*end == ' ') ? end + 1 : nullptr;
+    String result;
+
+    if (end == space + 1 || index > 0xFF || (*end && !value))
+    {
+        _reply(client, 'e', tag, 0, "syntax");
+        return;
+    }
+
+    switch (type)
+    {
+    case 'g':
+    case 's':
+        if (type == 's' && !value)
+            _reply(client, 'e', tag, index, "syntax");
+        else if (!_fn(tag, index, (type == 's') ? value : nullptr, result))
+            _reply(client, 'e', tag, index, (result.length()) ? result.c_str() : "unknown");
+        else
+            _reply(client, 'v', tag, index, result.c_str());
+        break;
+
+    case 'w':
+    {
+        Watch *watch = _watching(client, tag, index);
+
+        if (!_fn(tag, index, nullptr, result))
+        {
+            _reply(client, 'e', tag, index, "unknown");
+            break;
+        }
+
+        for (int w = 0; w < HTTP_SOCKET_WATCH && !watch; w++)
+        {
+            if (!client.watch[w].tag[0])
+                watch = &client.watch[w];
+        }
+
+        if (!watch || strlen(tag) >= HTTP_SOCKET_TAG)
+        {
+            _reply(client, 'e', tag, index, "full");
+            break;
+        }
+
+        strcpy(watch->tag, tag);
+        watch->index = index;
+        watch->stale = false;
+        _reply(client, 'v', tag, index, result.c_str());
+        break;
+    }
+
+    case 'u':
+    {
+        Watch *watch = _watching(client, tag, index);
+
+        if (watch)
+            watch->tag[0] = '\0';
+        break;
+    }
+
+    default:
+        _reply(client, 'e', tag, index, "syntax");
+        break;
+    }
+}
+
+HTTPSocket::Watch *HTTPSocket::_watching(Client &client, const char *tag, uint8_t index)
+{
+    for (int w = 0; w < HTTP_SOCKET_WATCH; w++)
+    {
+        if (client.watch[w].tag[0] && client.watch[w].index == index && strcmp(client.watch[w].tag, tag) == 0)
+            return &client.watch[w];
+    }
+    return nullptr;
+}
+
+bool HTTPSocket::_reply(Client &client, char type, const char *tag, uint8_t index, const char *text)
+{
+    char message[HTTP_SOCKET_BUFLEN];
+    int len = snprintf(message, sizeof(message), "%c %s %u %s", type, tag, index, text);
+
+    if (len >= (int)sizeof(message))
+        len = sizeof(message) - 1;
+    return _send(client, WS_OP_TEXT, (const uint8_t *)message, len);
+}
+
+/*
+** Frame Writers, server frames go unmasked and whole.  A frame is queued
+** only if all of it fits, false if not or the client has gone.
+*/
+bool HTTPSocket::_send(Client &client, uint8_t opcode, const uint8_t *data, size_t len)
+{
+    size_t head = (len < 126) ? 2 : 4;
+
+    if (!client.client || len > HTTP_SOCKET_BUFLEN || client.outLen + head + len > HTTP_SOCKET_OUTLEN)
+        return false;
+
+    uint8_t *frame = &client.out[client.outLen];
+
+    frame[0] = 0x80 | opcode;
+    if (len < 126)
+        frame[1] = len;
+    else
+    {
+        frame[1] = 126;
+        frame[2] = len >> 8;
+        frame[3] = len & 0xFF;
+    }
+    memcpy(&frame[head], data, len);
+    client.outLen += head + len;
+
+    // Most answers leave at once, in one segment
+    _flush(client);
+    return true;
+}
+
+// Write what the socket takes without waiting, true once all is gone
+bool HTTPSocket::_flush(Client &client)
+{
+    if (!client.outLen)
+        return true;
+
+    int sent = ::send(client.client.fd(), client.out, client.outLen, MSG_DONTWAIT);
+
+    if (sent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            client.client = WiFiClient();
+        return false;
+    }
+
+    client.outLen -= sent;
+    memmove(client.out, &client.out[sent], client.outLen);
+    return !client.outLen;
+}
+
+void HTTPSocket::_close(Client &client, uint16_t code)
+{
+    uint8_t reason[2] = {(uint8_t)(code >> 8), (uint8_t)(code & 0xFF)};
+
+    // Whatever the socket takes at once, a client being closed is not waited on
+    _send(client, WS_OP_CLOSE, reason, sizeof(reason));
+    client.client = WiFiClient();
+}
+
+/******************************************************************************/
@@ -0,0 +1,134 @@
+/*
+** EasyIOT - (HTTP) WebSocket Property Access
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_SOCKET_H
+#define _IOT_HTTP_SOCKET_H
+
+/*
+** Equates and Defintions
+*/
+#ifndef HTTP_SOCKET_CLIENTS
+#define HTTP_SOCKET_CLIENTS 4 // sockets held open at once
+#endif
+
+#ifndef HTTP_SOCKET_BUFLEN
+#define HTTP_SOCKET_BUFLEN 256 // largest frame taken from a client, header included
+#endif
+
+#ifndef HTTP_SOCKET_OUTLEN
+#define HTTP_SOCKET_OUTLEN 512 // frames held for a client while its socket drains
+#endif
+
+#ifndef HTTP_SOCKET_WATCH
+#define HTTP_SOCKET_WATCH 8 // properties one client can watch
+#endif
+
+#define HTTP_SOCKET_TAG 16 // longest function tag a watch can hold
+
+#define WS_OP_CONTINUE 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+/*
+** WebSocket Handler Class
+**
+** Upgrades a GET at its URI to an RFC 6455 WebSocket and speaks a small
+** line protocol over text frames, naming each property by its function
+** tag and index:
+**
+**   g <tag> <index>          read, answered with a "v" message
+**   s <tag> <index> <value>  write, answered with the value now held
+**   w <tag> <index>          watch, the value now and again on each change
+**   u <tag> <index>          stop watching
+**
+**   v <tag> <index> <value>  a value, asked for or watched
+**   e <tag> <index> <reason> the request could not be done
+**
+** Properties are reached through the callback given, which is passed a NULL
+** value to read.  A callback that fails may leave the reason in its result,
+** otherwise the property is taken as unknown.  Frames arrive whole in a small buffer per client, so
+** fragmented and oversized messages are refused with a close.
+**
+** Once the server has credentials from webLogin() the upgrade asks for them,
+** as the socket itself carries none.
+**
+** Frames sent are queued whole with the client and written as its socket
+** takes them, without waiting.  A client is read only while there is room
+** for its answer, and a watched change that finds no room marks the watch,
+** whose latest value is sent once there is.
+*/
+class HTTPSocket : public HTTPHandler
+{
+  public:
+    typedef std::function<bool(const char *tag, uint8_t index, const char *value, String &result)> property_t;
+
+    HTTPSocket(const char *uri, property_t fn) : _uri(uri), _fn(fn) {}
+    ~HTTPSocket() { close(); }
+
+    bool httpRoute(HTTPRouter &router) override
+    {
+        router.route(_uri.c_str(), HTTP_GET, this);
+        return true;
+    }
+
+    bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override
+    {
+        return requestMethod == HTTP_GET && requestUri == _uri;
+    }
+
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
+    const char *httpName(void) override { return _uri.c_str(); }
+
+    void notify(const char *tag, uint8_t index, const char *value);
+    void service(void);
+    void close(void);
+
+    static void mask(uint8_t *data, size_t len, const uint8_t key[4]);
+
+  private:
+    typedef struct
+    {
+        char tag[HTTP_SOCKET_TAG];
+        uint8_t index;
+        bool stale; // changed while there was no room to say so
+    } Watch;
+
+    typedef struct
+    {
+        WiFiClient client;
+        uint8_t buf[HTTP_SOCKET_BUFLEN + 1];
+        size_t len;
+        uint8_t out[HTTP_SOCKET_OUTLEN];
+        size_t outLen;
+        Watch watch[HTTP_SOCKET_WATCH];
+    } Client;
+
+    bool _frame(Client &client);
+    void _message(Client &client, char *text);
+    bool _reply(Client &client, char type, const char *tag, uint8_t index, const char *text);
+    bool _send(Client &client, uint8_t opcode, const uint8_t *data, size_t len);
+    bool _flush(Client &client);
+    void _close(Client &client, uint16_t code);
+    Watch *_watching(Client &client, const char *tag, uint8_t index);
+
+    String _uri;
+    property_t _fn;
+    Client _clients[HTTP_SOCKET_CLIENTS];
+};
+
+#endif // _IOT_HTTP_SOCKET_H
+
+/******************************************************************************/
@@ -0,0 +1,81 @@
+/*
+** EasyIOT - (HTTP) Streamed Response Writer
+**
+** This program is provided free for you to use in any way that you wish,
+** subject to the laws and regulations where you are using it.  Due diligence
+** is strongly suggested before using this code.  Please give credit where due.
+**
+** The Author makes no warranty of any kind, express or implied, with regard
+** to this program or the documentation contained in this document.  The
+** Author shall not be liable in any event for incidental or consequential
+** damages in connection with, or arising out of, the furnishing, performance
+** or use of these programs.
+*/
+#ifndef _IOT_HTTP_STREAM_H
+#define _IOT_HTTP_STREAM_H
+
+/*
+** Response Writer Class
+**
+** Obtained from IOTHTTP::sendStream() once the headers are prepared, a
+** handler prints the body piece by piece.  Bytes collect in the connection's
+** response buffer and leave as chunks as it fills, so the body never has to
+** be held in a String.  HTTP/1.0 clients get the raw body and a close.
+**
+** Printing more than room() waits for the socket to take it.  A handler
+** passing a sender to sendStream() is called again as the socket drains,
+** writing no more than room() each time, and never waits.
+*/
+class HTTPStream : public Print
+{
+  public:
+    HTTPStream(HTTPConnection &conn) : _conn(conn) {}
+
+    size_t write(uint8_t b) override { return write(&b, 1); }
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        if (!_conn.chunked)
+            return _conn.response.write(_conn.client, (const char *)buf, size);
+        return _conn.response.writeChunked(_conn.client, (const char *)buf, size);
+    }
+    using Print::write;
+
+    // Bytes that can be written without waiting, less any chunk framing
+    // and the last chunk, which must still fit once the sender is done
+    size_t room(void) const
+    {
+        size_t room = _conn.response.room();
+        size_t framing = (!_conn.chunked) ? 0 : (_conn.response.chunkOpen()) ? 2 + 5 : HTTP_CHUNK_RESERVE + 2 + 5;
+
+        return (room > framing) ? room - framing : 0;
+    }
+
+    // The most room() can be, once everything written has gone
+    size_t capacity(void) const
+    {
+        return HTTP_RESPONSE_BUFLEN - ((_conn.chunked) ? HTTP_CHUNK_RESERVE + 2 + 5 : 0);
+    }
+
+    void flush(void) { _conn.response.flush(_conn.client); }
+
+    // Close the connection once what was written has gone, the only way to
+    // end a body that falls short of the length promised
+    void close(void) { _conn.keepAlive = false; }
+
+    bool end(void)
+    {
+        if (!_conn.chunked)
+            return true;
+
+        _conn.chunked = false;
+        return _conn.response.lastChunk(_conn.client);
+    }
+
+  private:
+    HTTPConnection &_conn;
+};
+
+#endif // _IOT_HTTP_STREAM_H
+
+/******************************************************************************/
@@ -21,11 +21,17 @@
 class PAGEHandler : public HTTPHandler
 {
   public:
-    PAGEHandler(IOTHTTP::http_callback_t fn, IOTHTTP::http_callback_t ufn, const String &uri, HTTPMethod method)
-        : _fn(fn), _ufn(ufn), _uri(uri), _method(method)
+    PAGEHandler(IOTHTTP::http_callback_t fn, IOTHTTP::http_callback_t ufn, const String &uri, HTTPMethod method, bool stream = false)
+        : _fn(fn), _ufn(ufn), _method(method), _uri(uri), _stream(stream)
     {
     }
 
+    bool httpRoute(HTTPRouter &router) override
+    {
+        router.route(_uri.c_str(), _method, this);
+        return true;
+    }
+
     bool httpCanHandle(HTTPMethod requestMethod, String requestUri) override
     {
         if (_method != HTTP_ANY && _method != requestMethod)
@@ -45,12 +51,16 @@ class PAGEHandler : public HTTPHandler
         return true;
     }
 
-    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override
+    bool httpCanStream(const String &requestUri) override
     {
-        (void)server;
-        if (!httpCanHandle(requestMethod, requestUri))
-            return false;
+        return _stream && _ufn && requestUri == _uri;
+    }
 
+    bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override
+    {
+        // Only reached once the router has matched the method and URI
+        (void)requestMethod;
+        (void)requestUri;
         _fn(server);
         return true;
     }
@@ -59,15 +69,18 @@ class PAGEHandler : public HTTPHandler
     {
         (void)server;
         (void)upload;
-        if (httpCanUpload(requestUri))
+        if (httpCanUpload(requestUri) || httpCanStream(requestUri))
             _ufn(server);
     }
 
+    const char *httpName(void) override { return _uri.c_str(); }
+
   protected:
     IOTHTTP::http_callback_t _fn;
     IOTHTTP::http_callback_t _ufn;
     HTTPMethod _method;
     String _uri;
+    bool _stream;
 };
 
 #endif // _IOT_PAGE_HANDLER_H
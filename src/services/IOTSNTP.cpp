@@ -139,16 +139,16 @@ bool IOTSNTP::_propUpdate(IOTProperty *prop)
     return true;
 }
 
-String IOTSNTP::getData(void)
+size_t IOTSNTP::toChars(char *buf, size_t max)
 {
     time(&_timeTick);
     localtime_r(&_timeTick, &_timeInfo);
     strftime(_timeStr, sizeof(_timeStr), "%c %Z", &_timeInfo);
 
-    return String(_timeStr);
+    return IOTCodec::toChars(buf, max, _timeStr, strlen(_timeStr));
 }
 
-bool IOTSNTP::_dataSet(String &newVal)
+bool IOTSNTP::_setChars(const char *text, size_t len)
 {
     return true;
 }
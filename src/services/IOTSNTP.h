@@ -24,7 +24,7 @@ class IOTSNTP : public IOTFunction, public IOTProperty
     IOTSNTP(const char *defTZ = "UCT");
     time_t timeTick(void) const { return _timeTick; }
     struct tm *tickInfo(void) { return &_timeInfo; }
-    String getData(void);
+    size_t toChars(char *buf, size_t max);
     
   protected:
     void iotStartup(void);
@@ -33,7 +33,7 @@ class IOTSNTP : public IOTFunction, public IOTProperty
     bool _propUpdate(IOTProperty *prop);
 
     void * _dataPtr() { return (void *)&_timeStr[0]; }
-    bool _dataSet(String& newVal);
+    bool _setChars(const char *text, size_t len);
 
   private:
     time_t _timeTick;
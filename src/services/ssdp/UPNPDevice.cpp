@@ -296,6 +296,20 @@ bool UPNPDevice::upnpCanHandle(String &st)
     return false;
 }
 
+/*
+** Index the URIs httpCanHandle() answers, as the schema URL stands when added
+*/
+bool UPNPDevice::httpRoute(HTTPRouter &router)
+{
+    String schema = upnpSchemaURL();
+
+    router.route(defPresentationURL, HTTP_ANY, this);
+    if (schema.length())
+        router.route(schema.c_str(), HTTP_GET, this);
+    router.route("/upnp/", HTTP_ANY, this, true);
+    return true;
+}
+
 bool UPNPDevice::httpCanHandle(HTTPMethod method, String uri)
 {
     if (uri == defPresentationURL)
@@ -84,6 +84,7 @@ class UPNPDevice : public IOTFunction, public IOTPropertyString, protected HTTPH
         virtual bool _propUpdate(IOTProperty *prop);        
 
         virtual bool upnpCanHandle(String& st);
+        virtual bool httpRoute(HTTPRouter &router) override;
         virtual bool httpCanHandle(HTTPMethod method, String uri) override;
         virtual bool httpHandle(IOTHTTP &server, HTTPMethod requestMethod, String requestUri) override;
 